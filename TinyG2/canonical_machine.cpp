@@ -96,6 +96,7 @@
 #include "plan_arc.h"
 #include "planner.h"
 #include "stepper.h"
+#include "kinematics.h"
 #include "encoder.h"
 #include "spindle.h"
 #include "report.h"
@@ -395,9 +396,12 @@ float cm_get_work_position(GCodeState_t *gcode_state, uint8_t axis)
 
 void cm_finalize_move() {
 	copy_vector(cm.gmx.position, cm.gm.target);		// update model position
+	cm.spline_reflect_valid = false;				// only a G5 can continue a G5
 
 	// if in inverse time mode reset feed rate so next block requires an explicit feed rate setting
-	if ((cm.gm.feed_rate_mode == INVERSE_TIME_MODE) && (cm.gm.motion_mode == MOTION_MODE_STRAIGHT_FEED)) {
+	if ((cm.gm.feed_rate_mode == INVERSE_TIME_MODE) &&
+		((cm.gm.motion_mode == MOTION_MODE_STRAIGHT_FEED) ||
+		 (cm.gm.motion_mode == MOTION_MODE_CUBIC_SPLINE) || (cm.gm.motion_mode == MOTION_MODE_QUADRATIC_SPLINE))) {
 		cm.gm.feed_rate = 0;
 	}
 }
@@ -504,6 +508,9 @@ void cm_set_model_target(const float target[], const float flag[])
  *	and max to the same value (e.g. 0,0) to disable soft limits for an axis. Also will not test 
  *	a min or a max if the value is more than +/- 1000000 (plus or minus 1 million ). 
  *	This allows a single end to be tested w/the other disabled, should that requirement ever arise.
+ *
+ *	A target the kinematics can't reach (beyond a delta's arms) is always an error, whether
+ *	soft limits are enabled or not.
  */
 
 static stat_t _finalize_soft_limits(stat_t status)
@@ -530,6 +537,9 @@ stat_t cm_test_soft_limits(float target[])
 			}
 		}
 	}
+	if (ik_reachable(target) == false) {
+		return (_finalize_soft_limits(STAT_SOFT_LIMIT_EXCEEDED));
+	}
 	return (STAT_OK);
 }
 
@@ -567,6 +577,7 @@ void canonical_machine_init()
 	cm_set_path_control(cm.path_control);
 	cm_set_distance_mode(cm.distance_mode);
 	cm_set_arc_distance_mode(INCREMENTAL_MODE);  // always the default
+	cm_set_retract_mode(RETRACT_TO_INITIAL_LEVEL);
 	cm_set_feed_rate_mode(UNITS_PER_MINUTE_MODE);// always the default
 
 	cm.gmx.block_delete_switch = true;
@@ -675,6 +686,7 @@ stat_t cm_hard_alarm(stat_t status)
  *	cm_select_plane()			- G17,G18,G19 select axis plane
  *	cm_set_units_mode()			- G20, G21
  *	cm_set_distance_mode()		- G90, G91
+ *	cm_set_retract_mode()		- G98, G99
  *	cm_set_coord_offsets()		- G10 (delayed persistence)
  *
  *	These functions assume input validation occurred upstream.
@@ -704,6 +716,12 @@ stat_t cm_set_arc_distance_mode(const uint8_t mode)
 	return (STAT_OK);
 }
 
+stat_t cm_set_retract_mode(uint8_t mode)
+{
+	cm.gmx.retract_mode = mode;		// 0 = initial level (G98), 1 = R plane (G99)
+	return (STAT_OK);
+}
+
 /*
  * cm_set_coord_offsets() - G10 L2/L20 Pn (affects MODEL only)
  *
@@ -805,10 +823,11 @@ void cm_set_position(uint8_t axis, float position)
  *	cm_set_absolute_origin() takes a vector of origins (presumably 0's, but not necessarily)
  *	and applies them to all axes where the corresponding position in the flag vector is true (1).
  *
- *	This is a 2 step process. The model and planner contexts are set immediately, the runtime
- *	command is queued and synchronized with the planner queue. This includes the runtime position
- *	and the step recording done by the encoders. At that point any axis that is set is also marked
- *	as homed.
+ *	This is a 2 step process. The model context is set immediately. The planner position is set
+ *	once the blocks still in the parse-ahead queue have been planned from the old one, and the
+ *	runtime command is queued and synchronized with the planner queue. This includes the runtime
+ *	position and the step recording done by the encoders. At that point any axis that is set is
+ *	also marked as homed.
  */
 
 stat_t cm_set_absolute_origin(float origin[], float flag[])
@@ -821,9 +840,9 @@ stat_t cm_set_absolute_origin(float origin[], float flag[])
 			value[axis] = _to_millimeters(origin[axis]);
 			cm.gmx.position[axis] = value[axis];		// set model position
 			cm.gm.target[axis] = value[axis];			// reset model target
-			mp_set_planner_position(axis, value[axis]);	// set mm position
 		}
 	}
+	mp_queue_planner_position(value, flag);				// set mm position behind any parsed-ahead blocks
 	mp_queue_command(_exec_absolute_origin, value, flag);
 	return (STAT_OK);
 }
@@ -896,6 +915,12 @@ stat_t cm_resume_origin_offsets()
  *****************************/
 /*
  * cm_straight_traverse() - G0 linear rapid
+ *
+ *	With $tmo=1 rapids in a machining cycle are dogleg moves on a Cartesian machine: each
+ *	axis runs its own time-optimal profile instead of being held to a straight line, so no
+ *	axis is slowed down for the slowest one (see mp_traverse()). Every axis moves one way
+ *	only, so checking the endpoint keeps the whole move inside the soft limits. Homing,
+ *	probing and other cycles, and non-Cartesian machines, always use coordinated rapids.
  */
 
 stat_t cm_straight_traverse(float target[], float flags[])
@@ -904,8 +929,10 @@ stat_t cm_straight_traverse(float target[], float flags[])
 	cm_set_model_target(target, flags);
 	ritorno (cm_test_soft_limits(cm.gm.target)); 	// test soft limits; exit if thrown
 	cm_set_work_offsets(&cm.gm);					// capture the fully resolved offsets to the state
+	uint8_t dogleg = ((cm.traverse_mode == TRAVERSE_DOGLEG) && (kin.type == KINEMATICS_CARTESIAN) &&
+					 ((cm.cycle_state == CYCLE_OFF) || (cm.cycle_state == CYCLE_MACHINING)));
 	cm_cycle_start();								// required for homing & other cycles
-	stat_t status = mp_aline(&cm.gm);				// send the move to the planner
+	stat_t status = (dogleg == true) ? mp_traverse(&cm.gm) : mp_aline(&cm.gm);	// send the move to the planner
 	cm_finalize_move();
 	if(status == STAT_MINIMUM_LENGTH_MOVE && mp_get_run_buffer() == NULL && cm.hold_state != FEEDHOLD_HOLD)
 		cm_cycle_end();
@@ -932,8 +959,7 @@ stat_t cm_goto_g28_position(float target[], float flags[])
 {
 	cm_set_absolute_override(MODEL, true);
 	cm_straight_traverse(target, flags);				// move through intermediate point, or skip
-	while (mp_get_planner_buffers_available() == 0);	// make sure you have an available buffer
-	float f[] = {1,1,1,1,1,1};
+	float f[] = {1,1,1,1,1,1};							// parse-ahead takes the move if the planner is full
 	return(cm_straight_traverse(cm.gmx.g28_position, f));// execute actual stored move
 }
 
@@ -947,8 +973,7 @@ stat_t cm_goto_g30_position(float target[], float flags[])
 {
 	cm_set_absolute_override(MODEL, true);
 	cm_straight_traverse(target, flags);				// move through intermediate point, or skip
-	while (mp_get_planner_buffers_available() == 0);	// make sure you have an available buffer
-	float f[] = {1,1,1,1,1,1};
+	float f[] = {1,1,1,1,1,1};							// parse-ahead takes the move if the planner is full
 	return(cm_straight_traverse(cm.gmx.g30_position, f));// execute actual stored move
 }
 
@@ -1036,6 +1061,196 @@ stat_t cm_straight_feed(float target[], float flags[])
 		return (status);
 }
 
+/*
+ * cm_spline_feed() - G5 cubic and G5.1 quadratic spline feeds
+ *
+ *	G5 X_ Y_ I_ J_ P_ Q_	cubic Bezier from the current position to X,Y. I,J is the
+ *							offset from the start to the first control point, and P,Q
+ *							the offset from the end to the second control point.
+ *	G5.1 X_ Y_ I_ J_		quadratic Bezier. I,J is the offset from the start to the
+ *							single control point.
+ *
+ *	Splines run in the XY plane (G17) only. Offsets are always incremental, and are in the
+ *	current units. A G5 that directly follows another G5 may omit I and J; its first control
+ *	point mirrors the last control point of the previous curve, so the two join tangent.
+ *	The quadratic is raised to the equivalent cubic so the planner and runtime only deal
+ *	with one kind of curve.
+ *
+ *	The whole curve is planned as a single block (see mp_spline()). The curve lies within
+ *	its control points, so testing them against the soft limits covers the whole path.
+ */
+stat_t cm_spline_feed(const float target[], const float target_f[],
+                      const float offset[], const float offset_f[],
+                      const float P_word, const bool P_word_f,
+                      const float Q_word, const bool Q_word_f,
+                      const uint8_t motion_mode)
+{
+	// trap zero feed rate condition
+	if ((cm.gm.feed_rate_mode != INVERSE_TIME_MODE) && (fp_ZERO(cm.gm.feed_rate))) {
+		return (STAT_GCODE_FEEDRATE_NOT_SPECIFIED);
+	}
+	if (cm.gm.select_plane != CANON_PLANE_XY) {
+		return (STAT_GCODE_ACTIVE_PLANE_IS_INVALID);
+	}
+	for (uint8_t axis=AXIS_Z; axis<AXES; axis++) {
+		if (fp_TRUE(target_f[axis])) { return (STAT_GCODE_AXIS_CANNOT_BE_PRESENT);}
+	}
+	bool offset_i = fp_TRUE(offset_f[OFS_I]);
+	bool offset_j = fp_TRUE(offset_f[OFS_J]);
+	bool reflect = ((offset_i == false) && (offset_j == false) &&
+					(motion_mode == MOTION_MODE_CUBIC_SPLINE) && (cm.spline_reflect_valid == true));
+	if (((offset_i == false) || (offset_j == false)) && (reflect == false)) {
+		return (STAT_ARC_OFFSETS_MISSING_FOR_SELECTED_PLANE);
+	}
+	if (motion_mode == MOTION_MODE_CUBIC_SPLINE) {
+		if (P_word_f == false) { return (STAT_P_WORD_IS_MISSING);}
+		if (Q_word_f == false) { return (STAT_Q_WORD_IS_MISSING);}
+	}
+	float start[2] = { cm.gmx.position[AXIS_X], cm.gmx.position[AXIS_Y] };
+
+	cm.gm.motion_mode = motion_mode;
+	cm_set_model_target(target, target_f);
+	float *end = &cm.gm.target[AXIS_X];				// X and Y of the target
+
+	for (uint8_t i=0; i<2; i++) {
+		if (motion_mode == MOTION_MODE_CUBIC_SPLINE) {
+			cm.gm.spline[0][i] = (reflect == true) ? cm.spline_reflect[i] : start[i] + _to_millimeters(offset[i]);
+			cm.gm.spline[1][i] = end[i] + _to_millimeters((i == 0) ? P_word : Q_word);
+		} else {										// the cubic with the same shape as the quadratic
+			float control = start[i] + _to_millimeters(offset[i]);
+			cm.gm.spline[0][i] = start[i] + (control - start[i]) * 2/3;
+			cm.gm.spline[1][i] = end[i] + (control - end[i]) * 2/3;
+		}
+	}
+	float point[AXES];
+	copy_vector(point, cm.gm.target);
+	for (uint8_t i=0; i<2; i++) {
+		point[AXIS_X] = cm.gm.spline[i][AXIS_X];
+		point[AXIS_Y] = cm.gm.spline[i][AXIS_Y];
+		ritorno (cm_test_soft_limits(point));		// test the control points; exit if thrown
+	}
+	ritorno (cm_test_soft_limits(cm.gm.target));
+	cm_set_work_offsets(&cm.gm);					// capture the fully resolved offsets to the state
+	cm_cycle_start();								// required for homing & other cycles
+	stat_t status = mp_spline(&cm.gm);				// send the curve to the planner
+	cm_finalize_move();
+
+	// the next G5 can continue from here with the mirror image of the last control point,
+	// but only if the curve was accepted - a rejected G5 leaves nothing to continue from
+	if ((status == STAT_OK) || (status == STAT_MINIMUM_LENGTH_MOVE)) {
+		for (uint8_t i=0; i<2; i++) {
+			cm.spline_reflect[i] = 2 * end[i] - cm.gm.spline[1][i];
+		}
+		cm.spline_reflect_valid = true;
+	}
+
+	if(status == STAT_MINIMUM_LENGTH_MOVE && mp_get_run_buffer() == NULL && cm.hold_state != FEEDHOLD_HOLD)
+		cm_cycle_end();
+	if(status == STAT_MINIMUM_LENGTH_MOVE)
+		return (STAT_OK);
+	else
+		return (status);
+}
+
+/*
+ * cm_raster_line() - queue a raster engraving line
+ *
+ *	{"ras":{"x":10,"y":20,"i":1,"j":0,"p":0.1,"f":3000,"d":"<base64 pixels>"}}
+ *
+ *	A raster line is one feed move along the scan direction (i,j) covering one pixel pitch
+ *	(p) per pixel, at the scan feed rate (f). Each byte of the base64 data (d) is a pixel
+ *	power: 0 turns the spindle PWM off, and 1 - 255 scale the duty cycle set by S and M3/M4
+ *	from its low phase up to full. The runtime switches the PWM at each pixel boundary as
+ *	the move runs and gives the PWM back to S when the raster moves end. With the spindle
+ *	off or paused the line moves without touching the PWM. The response echoes the number
+ *	of pixels in place of the data.
+ *
+ *	The start point (x,y) is in work coordinates. If it is given, a blank raster move with
+ *	the PWM off runs there first at the scan feed rate, so a start point ahead of the first
+ *	pixel gives the line room to get up to speed. Without a start point the line continues
+ *	from the current position, so a long row can be sent as several commands that run as
+ *	one continuous move. Direction, pitch and feed rate are sticky. Lengths are in the
+ *	current units, and the line always runs in absolute mode.
+ *
+ *	The feed rate is limited so a segment never crosses more than RASTER_SEGMENT_PIXELS_MAX
+ *	pixels. Dynamic power ({p1dpm:1}) scales the pixels with velocity like any other move.
+ *
+ *	The whole command has to fit a USB_LINE_BUFFER_SIZE line. With all the keys given and
+ *	realistic values the rest of the command takes about 90 chars, which leaves room for
+ *	RASTER_PIXELS_MAX (120) pixels - 160 base64 chars. Longer data is rejected.
+ */
+
+static stat_t _queue_raster_move(float target[], uint8_t raster, float feed_rate)
+{
+	stat_t status;
+	if ((status = cm_test_soft_limits(target)) != STAT_OK) {
+		mp_free_raster_line(raster);
+		return (status);
+	}
+	float feed_rate_save = cm.gm.feed_rate;			// the raster doesn't change the modal state
+	uint8_t feed_rate_mode_save = cm.gm.feed_rate_mode;
+	uint8_t motion_mode_save = cm.gm.motion_mode;
+
+	cm.gm.feed_rate = feed_rate;
+	cm.gm.feed_rate_mode = UNITS_PER_MINUTE_MODE;
+	cm.gm.motion_mode = MOTION_MODE_STRAIGHT_FEED;
+	cm.gm.raster = raster;
+	copy_vector(cm.gm.target, target);
+	cm_set_work_offsets(&cm.gm);
+	cm_cycle_start();
+	status = mp_aline(&cm.gm);						// frees the raster line if it drops the move
+	cm_finalize_move();
+
+	cm.gm.raster = 0;
+	cm.gm.feed_rate = feed_rate_save;
+	cm.gm.feed_rate_mode = feed_rate_mode_save;
+	cm.gm.motion_mode = motion_mode_save;
+	if ((status == STAT_MINIMUM_LENGTH_MOVE) && (mp_get_run_buffer() == NULL) && (cm.hold_state != FEEDHOLD_HOLD)) {
+		cm_cycle_end();
+	}
+	return ((status == STAT_MINIMUM_LENGTH_MOVE) ? STAT_OK : status);
+}
+
+stat_t cm_raster_line()
+{
+	cmRasterLine_t *r = &cm.raster;
+
+	ritorno(r->data_status);
+	if (r->pixel_count == 0) { return (STAT_INPUT_VALUE_RANGE_ERROR);}
+	if (fp_ZERO(r->feed_rate)) { return (STAT_GCODE_FEEDRATE_NOT_SPECIFIED);}
+	float magnitude = sqrt(square(r->direction[0]) + square(r->direction[1]));
+	if (fp_ZERO(magnitude) || (r->pitch < EPSILON)) { return (STAT_INPUT_VALUE_RANGE_ERROR);}
+
+	float pitch = _to_millimeters(r->pitch);
+	float length = pitch * r->pixel_count;
+	float feed_rate = min(_to_millimeters(r->feed_rate), (RASTER_SEGMENT_PIXELS_MAX - 2) * pitch / NOM_SEGMENT_TIME);
+	if ((length / feed_rate) < MIN_BLOCK_TIME) { return (STAT_MINIMUM_TIME_MOVE);}
+
+	float target[AXES];
+	copy_vector(target, cm.gmx.position);
+
+	if ((r->start_flag[0] == true) || (r->start_flag[1] == true)) {
+		for (uint8_t i=0; i<2; i++) {
+			if (r->start_flag[i] == true) {
+				target[AXIS_X+i] = cm_get_active_coord_offset(AXIS_X+i) + _to_millimeters(r->start[i]);
+			}
+		}
+		float blank_length = get_axis_vector_length(target, cm.gmx.position);
+		if (fp_NOT_ZERO(blank_length)) {			// slow a short blank move so the planner keeps it
+			float blank_feed_rate = min(feed_rate, blank_length / (2 * MIN_BLOCK_TIME));
+			ritorno(_queue_raster_move(target, RASTER_BLANK, blank_feed_rate));
+		}
+	}
+	target[AXIS_X] += r->direction[0] / magnitude * length;
+	target[AXIS_Y] += r->direction[1] / magnitude * length;
+
+	uint8_t raster;
+	if ((raster = mp_queue_raster_line(r->pixel, r->pixel_count, pitch)) == 0) {
+		return (STAT_BUFFER_FULL);					// never supposed to happen - checked upstream in the controller
+	}
+	return (_queue_raster_move(target, raster, feed_rate));
+}
+
 /*****************************
  * Spindle Functions (4.3.7) *
  *****************************/
@@ -1090,7 +1305,7 @@ static void _exec_change_tool(float *value, float *flag)
 stat_t cm_mist_coolant_control(uint8_t mist_coolant)
 {
 	float value[AXES] = { (float)mist_coolant,0,0,0,0,0 };
-	mp_queue_command(_exec_mist_coolant_control, value, value);
+	mp_queue_attached_command(_exec_mist_coolant_control, value, value);	// doesn't stop the machine
 	return (STAT_OK);
 }
 static void _exec_mist_coolant_control(float *value, float *flag)
@@ -1113,7 +1328,7 @@ static void _exec_mist_coolant_control(float *value, float *flag)
 stat_t cm_flood_coolant_control(uint8_t flood_coolant)
 {
 	float value[AXES] = { (float)flood_coolant,0,0,0,0,0 };
-	mp_queue_command(_exec_flood_coolant_control, value, value);
+	mp_queue_attached_command(_exec_flood_coolant_control, value, value);
 	return (STAT_OK);
 }
 static void _exec_flood_coolant_control(float *value, float *flag)
@@ -1354,6 +1569,7 @@ stat_t cm_queue_flush()
   xio_flush_device(DEV_IS_DATA);
 #endif
 	mp_flush_planner();						// flush planner queue
+	cm_clear_drilling_words();
 	if(cm.hold_state == FEEDHOLD_HOLD);     // end feedhold, if we're in one
 		cm_end_hold();
 	cm.end_hold_requested = false;					// cancel any pending cycle start request
@@ -1474,6 +1690,7 @@ void cm_optional_program_stop()
 
 void cm_program_end()
 {
+	cm_clear_drilling_words();							// now, not at exec - the parser runs ahead
 	float value[AXES] = { (float)MACHINE_PROGRAM_END, 0,0,0,0,0 };
 	mp_queue_command(_exec_program_finalize, value, value);
 }
@@ -1494,6 +1711,7 @@ stat_t cm_start_estop(void)
 	_exec_program_finalize(value, value);	// finalize now, not later
 	cm.feedhold_requested = cm.queue_flush_requested = cm.end_hold_requested = false;
 	switch_reset();
+	st_release_motors(0xFF);				// an aborted gantry homing may have left motors stopped
 	planner_init();
 
 	return STAT_OK;
@@ -1610,7 +1828,22 @@ static const char msg_g01[] PROGMEM = "G1  - linear feed";
 static const char msg_g02[] PROGMEM = "G2  - clockwise arc feed";
 static const char msg_g03[] PROGMEM = "G3  - counter clockwise arc feed";
 static const char msg_g80[] PROGMEM = "G80 - cancel motion mode (none active)";
-static const char *const msg_momo[] PROGMEM = { msg_g00, msg_g01, msg_g02, msg_g03, msg_g80 };
+static const char msg_g382[] PROGMEM = "G38.2 - straight probe";
+static const char msg_g81[] PROGMEM = "G81 - drilling";
+static const char msg_g82[] PROGMEM = "G82 - drilling with dwell";
+static const char msg_g83[] PROGMEM = "G83 - peck drilling";
+static const char msg_g84[] PROGMEM = "G84 - right hand tapping";
+static const char msg_g85[] PROGMEM = "G85 - boring, no dwell, feed out";
+static const char msg_g86[] PROGMEM = "G86 - boring, spindle stop, rapid out";
+static const char msg_g87[] PROGMEM = "G87 - back boring";
+static const char msg_g88[] PROGMEM = "G88 - boring, spindle stop, manual out";
+static const char msg_g89[] PROGMEM = "G89 - boring, dwell, feed out";
+static const char msg_g05[] PROGMEM = "G5  - cubic spline feed";
+static const char msg_g051[] PROGMEM = "G5.1 - quadratic spline feed";
+static const char msg_g73[] PROGMEM = "G73 - peck drilling, chip breaking";
+static const char *const msg_momo[] PROGMEM = { msg_g00, msg_g01, msg_g02, msg_g03, msg_g80, msg_g382,
+												msg_g81, msg_g82, msg_g83, msg_g84, msg_g85, msg_g86, msg_g87,
+												msg_g88, msg_g89, msg_g05, msg_g051, msg_g73 };
 
 static const char msg_g17[] PROGMEM = "G17 - XY plane";
 static const char msg_g18[] PROGMEM = "G18 - XZ plane";
@@ -1851,6 +2084,7 @@ stat_t cm_set_am(nvObj_t *nv)		// axis mode
 		if (nv->value > AXIS_MODE_MAX_ROTARY) { return (STAT_INPUT_VALUE_UNSUPPORTED);}
 	}
 	set_ui8(nv);
+	ik_map_motors();						// inhibited axes are taken out of the motor map
 	return(STAT_OK);
 }
 
@@ -1897,6 +2131,95 @@ stat_t cm_set_xjh(nvObj_t *nv)
 	return(STAT_OK);
 }
 
+/*
+ * cm_set_jt() - set junction time - must be positive
+ */
+
+stat_t cm_set_jt(nvObj_t *nv)
+{
+	if (nv->value <= 0) { return (STAT_INPUT_VALUE_RANGE_ERROR);}
+	set_flt(nv);
+	return(STAT_OK);
+}
+
+/**** Input shaper functions
+ * cm_set_axis_shaper() - compute the shaper impulses for an axis from its settings
+ * cm_set_sh()			- set shaper type - called from dispatch table
+ * cm_set_sf()			- set shaper frequency - called from dispatch table
+ * cm_set_sd()			- set shaper damping - called from dispatch table
+ *
+ *	The runtime convolves each segment target with the shaper impulses (see _shape_target()
+ *	in plan_exec.cpp) so the axis doesn't excite its ringing frequency, which lets the jerk
+ *	be raised. For a ringing frequency f and damping z the damped period is
+ *	Td = 1 / (f * sqrt(1-z^2)) and K = exp(-z*pi / sqrt(1-z^2)). The shapers are:
+ *
+ *		ZV	 amplitudes 1, K over 1+K					at 0, Td/2
+ *		ZVD	 amplitudes 1, 2K, K^2 over (1+K)^2			at 0, Td/2, Td
+ *		EI	 amplitudes (1+V)/4, (1-V)K/2, (1+V)K^2/4	at 0, Td/2, Td, normalized
+ *
+ *	where V is the residual vibration EI tolerates. Each shaper delays the axis by about
+ *	half its length and makes every stop take that much longer. Change shapers with the
+ *	machine stopped.
+ */
+
+void cm_set_axis_shaper(uint8_t axis)
+{
+	cfgAxis_t *a = &cm.a[axis];
+
+	a->shaper_impulses = 0;
+	if ((a->shaper_type == SHAPER_OFF) || (a->shaper_frequency < SHAPER_FREQUENCY_MIN)) { return;}
+
+	float root = sqrt(1 - square(a->shaper_damping));
+	float period = 1 / (a->shaper_frequency * root) / 60;		// damped period in minutes
+	float k = exp(-a->shaper_damping * M_PI / root);
+
+	a->shaper_delay[0] = 0;
+	a->shaper_delay[1] = period / 2;
+	a->shaper_delay[2] = period;
+	if (a->shaper_type == SHAPER_ZV) {
+		a->shaper_amplitude[0] = 1;
+		a->shaper_amplitude[1] = k;
+		a->shaper_impulses = 2;
+	} else if (a->shaper_type == SHAPER_ZVD) {
+		a->shaper_amplitude[0] = 1;
+		a->shaper_amplitude[1] = 2*k;
+		a->shaper_amplitude[2] = k*k;
+		a->shaper_impulses = 3;
+	} else {
+		a->shaper_amplitude[0] = 0.25 * (1 + SHAPER_EI_VIBRATION);
+		a->shaper_amplitude[1] = 0.5 * (1 - SHAPER_EI_VIBRATION) * k;
+		a->shaper_amplitude[2] = a->shaper_amplitude[0] * k*k;
+		a->shaper_impulses = 3;
+	}
+	float sum = 0;
+	for (uint8_t i=0; i<a->shaper_impulses; i++) { sum += a->shaper_amplitude[i];}
+	for (uint8_t i=0; i<a->shaper_impulses; i++) { a->shaper_amplitude[i] /= sum;}
+}
+
+stat_t cm_set_sh(nvObj_t *nv)
+{
+	if (nv->value > SHAPER_EI) { return (STAT_INPUT_VALUE_UNSUPPORTED);}
+	set_ui8(nv);
+	cm_set_axis_shaper(_get_axis(nv->index));
+	return(STAT_OK);
+}
+
+stat_t cm_set_sf(nvObj_t *nv)
+{
+	if (nv->value < SHAPER_FREQUENCY_MIN) { return (STAT_INPUT_VALUE_RANGE_ERROR);}
+	set_flt(nv);
+	cm_set_axis_shaper(_get_axis(nv->index));
+	return(STAT_OK);
+}
+
+stat_t cm_set_sd(nvObj_t *nv)
+{
+	if ((nv->value < 0) || (nv->value > SHAPER_DAMPING_MAX)) { return (STAT_INPUT_VALUE_RANGE_ERROR);}
+	set_flt(nv);
+	cm_set_axis_shaper(_get_axis(nv->index));
+	return(STAT_OK);
+}
+
 /*
  * Commands
  *
@@ -1983,6 +2306,53 @@ stat_t cm_run_joga(nvObj_t *nv)
 	return (STAT_OK);
 }
 
+stat_t cm_set_jog_velocity(nvObj_t *nv)
+{
+	set_flt(nv);
+	return (cm_jog_velocity_update());
+}
+
+/*
+ * cm_run_raster()		 - set the raster line parameters in the group, then queue the line
+ * cm_set_raster_start() - set a start point coordinate and flag it as given
+ * cm_set_raster_data()	 - decode the base64 pixels; echoes the pixel count instead of the data
+ */
+
+stat_t cm_run_raster(nvObj_t *nv)
+{
+	cm.raster.start_flag[0] = false;
+	cm.raster.start_flag[1] = false;
+	cm.raster.pixel_count = 0;
+	cm.raster.data_status = STAT_OK;
+	set_grp(nv);
+	return (cm_raster_line());
+}
+
+stat_t cm_set_raster_start(nvObj_t *nv)
+{
+	set_flt(nv);
+	cm.raster.start_flag[((float *)GET_TABLE_WORD(target) == &cm.raster.start[0]) ? 0 : 1] = true;
+	return (STAT_OK);
+}
+
+stat_t cm_set_raster_data(nvObj_t *nv)
+{
+	int16_t count = -1;
+	cm.raster.data_status = STAT_INPUT_VALUE_UNSUPPORTED;
+	if (nv->valuetype == TYPE_STRING) {
+		if (strlen((char *)*nv->stringp) > ((RASTER_PIXELS_MAX + 2) / 3) * 4) {
+			cm.raster.data_status = STAT_INPUT_EXCEEDS_MAX_LENGTH;
+		} else if ((count = base64_decode(*nv->stringp, cm.raster.pixel, RASTER_PIXELS_MAX)) >= 0) {
+			cm.raster.data_status = STAT_OK;
+		}
+	}
+	if (count < 0) { count = 0;}
+	cm.raster.pixel_count = (uint8_t)count;
+	nv->valuetype = TYPE_INTEGER;
+	nv->value = count;
+	return (cm.raster.data_status);
+}
+
 /***********************************************************************************
  * TEXT MODE SUPPORT
  * Functions to print variables from the cfgArray table
@@ -2057,16 +2427,26 @@ void cm_print_gdi(nvObj_t *nv) { text_print_int(nv, fmt_gdi);}
 /* system state print functions */
 
 const char fmt_ja[] PROGMEM = "[ja]  junction acceleration%8.0f%s\n";
+const char fmt_jmo[] PROGMEM = "[jmo] junction model%16d [0=deviation,1=jerk]\n";
+const char fmt_jt[] PROGMEM = "[jt]  junction time%19.1f ms\n";
 const char fmt_ct[] PROGMEM = "[ct]  chordal tolerance%17.4f%s\n";
 const char fmt_sl[] PROGMEM = "[sl]  soft limit enable%12d\n";
+const char fmt_tmo[] PROGMEM = "[tmo] traverse mode%17d [0=coordinated,1=dogleg]\n";
+const char fmt_pkc[] PROGMEM = "[pkc] peck clearance%19.3f%s\n";
+const char fmt_pkr[] PROGMEM = "[pkr] peck retract%21.3f%s\n";
 const char fmt_ml[] PROGMEM = "[ml]  min line segment%17.3f%s\n";
 const char fmt_ma[] PROGMEM = "[ma]  min arc segment%18.3f%s\n";
 const char fmt_ms[] PROGMEM = "[ms]  min segment time%13.0f uSec\n";
 const char fmt_pdt[] PROGMEM = "[pdt] pause dwell time%13.0f uSec\n";
 
 void cm_print_ja(nvObj_t *nv) { text_print_flt_units(nv, fmt_ja, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_jmo(nvObj_t *nv) { text_print_ui8(nv, fmt_jmo);}
+void cm_print_jt(nvObj_t *nv) { text_print_flt(nv, fmt_jt);}
 void cm_print_ct(nvObj_t *nv) { text_print_flt_units(nv, fmt_ct, GET_UNITS(ACTIVE_MODEL));}
 void cm_print_sl(nvObj_t *nv) { text_print_ui8(nv, fmt_sl);}
+void cm_print_tmo(nvObj_t *nv) { text_print_ui8(nv, fmt_tmo);}
+void cm_print_pkc(nvObj_t *nv) { text_print_flt_units(nv, fmt_pkc, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_pkr(nvObj_t *nv) { text_print_flt_units(nv, fmt_pkr, GET_UNITS(ACTIVE_MODEL));}
 void cm_print_ml(nvObj_t *nv) { text_print_flt_units(nv, fmt_ml, GET_UNITS(ACTIVE_MODEL));}
 void cm_print_ma(nvObj_t *nv) { text_print_flt_units(nv, fmt_ma, GET_UNITS(ACTIVE_MODEL));}
 void cm_print_ms(nvObj_t *nv) { text_print_flt(nv, fmt_ms);}
@@ -2093,6 +2473,12 @@ void cm_print_pdt(nvObj_t *nv) { text_print_flt(nv, fmt_pdt);}
  *	cm_print_lv()
  *	cm_print_lb()
  *	cm_print_zb()
+ *	cm_print_hg()
+ *	cm_print_sh()
+ *	cm_print_sf()
+ *	cm_print_sd()
+ *	cm_print_bl()
+ *	cm_print_br()
  *
  *	cm_print_pos() - print position with unit displays for MM or Inches
  * 	cm_print_mpo() - print position with fixed unit display - always in Degrees or MM
@@ -2113,6 +2499,12 @@ const char fmt_Xsv[] PROGMEM = "[%s%s] %s search velocity%12.0f%s/min\n";
 const char fmt_Xlv[] PROGMEM = "[%s%s] %s latch velocity%13.0f%s/min\n";
 const char fmt_Xlb[] PROGMEM = "[%s%s] %s latch backoff%18.3f%s\n";
 const char fmt_Xzb[] PROGMEM = "[%s%s] %s zero backoff%19.3f%s\n";
+const char fmt_Xhg[] PROGMEM = "[%s%s] %s homing group%15d [same group homes together]\n";
+const char fmt_Xsh[] PROGMEM = "[%s%s] %s input shaper%15d [0=off,1=ZV,2=ZVD,3=EI]\n";
+const char fmt_Xsf[] PROGMEM = "[%s%s] %s shaper frequency%13.1f Hz\n";
+const char fmt_Xsd[] PROGMEM = "[%s%s] %s shaper damping%17.3f\n";
+const char fmt_Xbl[] PROGMEM = "[%s%s] %s backlash%23.4f%s\n";
+const char fmt_Xbr[] PROGMEM = "[%s%s] %s backlash rate%14.0f%s/min\n";
 const char fmt_cofs[] PROGMEM = "[%s%s] %s %s offset%20.3f%s\n";
 const char fmt_cpos[] PROGMEM = "[%s%s] %s %s position%18.3f%s\n";
 
@@ -2132,6 +2524,11 @@ static void _print_axis_flt(nvObj_t *nv, const char *format)
 	fprintf_P(stderr, format, nv->group, nv->token, nv->group, nv->value, units);
 }
 
+static void _print_axis_flt_nounits(nvObj_t *nv, const char *format)
+{
+	fprintf_P(stderr, format, nv->group, nv->token, nv->group, nv->value);
+}
+
 static void _print_axis_coord_flt(nvObj_t *nv, const char *format)
 {
 	char *units;
@@ -2178,6 +2575,12 @@ void cm_print_sv(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xsv);}
 void cm_print_lv(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xlv);}
 void cm_print_lb(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xlb);}
 void cm_print_zb(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xzb);}
+void cm_print_hg(nvObj_t *nv) { _print_axis_ui8(nv, fmt_Xhg);}
+void cm_print_sh(nvObj_t *nv) { _print_axis_ui8(nv, fmt_Xsh);}
+void cm_print_sf(nvObj_t *nv) { _print_axis_flt_nounits(nv, fmt_Xsf);}
+void cm_print_sd(nvObj_t *nv) { _print_axis_flt_nounits(nv, fmt_Xsd);}
+void cm_print_bl(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xbl);}
+void cm_print_br(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xbr);}
 
 void cm_print_cofs(nvObj_t *nv) { _print_axis_coord_flt(nv, fmt_cofs);}
 void cm_print_cpos(nvObj_t *nv) { _print_axis_coord_flt(nv, fmt_cpos);}
@@ -43,6 +43,9 @@
 #define _to_millimeters(a) ((cm.gm.units_mode == INCHES) ? (a * MM_PER_INCH) : a)
 
 #define JOGGING_START_VELOCITY ((float)10.0)
+#define JOG_VELOCITY_TIMEOUT_MS 250			// a velocity jog stops if not updated within this time
+#define RASTER_PIXELS_MAX 120				// most pixels in one raster line command - see cm_raster_line()
+#define RASTER_BLANK 0xFF					// gm.raster value for a raster move with the PWM off
 #define DISABLE_SOFT_LIMIT (999999)
 
 /*****************************************************************************
@@ -102,6 +105,8 @@ typedef struct GCodeState {				// Gcode model state - used by model, planning an
 	uint8_t mist_coolant;				// TRUE = mist on (M7), FALSE = off (M9)
 	uint8_t flood_coolant;				// TRUE = flood on (M8), FALSE = off (M9)
 	uint8_t spindle_mode;				// 0=OFF (M5), 1=CW (M3), 2=CCW (M4)
+	uint8_t raster;						// raster move: pixel line number + 1, or RASTER_BLANK (0 = not raster)
+	float spline[2][2];					// G5/G5.1 cubic control points in machine XY (spline moves only)
 
 } GCodeState_t;
 
@@ -120,6 +125,7 @@ typedef struct GCodeStateExtended {		// Gcode dynamic state extensions - used by
 	uint8_t	feed_rate_override_enable;	// TRUE = overrides enabled (M48), F=(M49)
 	uint8_t	traverse_override_enable;	// TRUE = traverse override enabled
 	uint8_t l_word;						// L word - used by G10s
+	uint8_t retract_mode;				// G98, G99 canned cycle retract
 
 	uint8_t origin_offset_enable;		// G92 offsets enabled/disabled.  0=disabled, 1=enabled
 	uint8_t block_delete_switch;		// set true to enable block deletes (true is default)
@@ -161,6 +167,7 @@ typedef struct GCodeInput {				// Gcode model inputs - meaning depends on contex
 	uint8_t path_control;				// G61... EXACT_PATH, EXACT_STOP, CONTINUOUS
 	uint8_t distance_mode;				// G91   0=use absolute coords(G90), 1=incremental movement
 	uint8_t arc_distance_mode;			// G90.1=use absolute IJK offsets, G91.1=incremental IJK
+	uint8_t retract_mode;				// G98, G99 canned cycle retract
 
 	uint8_t tool;						// Tool after T and M6 (tool_select and tool_change)
 	uint8_t tool_select;				// T value - T sets this value
@@ -176,6 +183,7 @@ typedef struct GCodeInput {				// Gcode model inputs - meaning depends on contex
 	float parameter;					// P - parameter used for dwell time in seconds, G10 coord select...
 	float arc_radius;					// R - radius value in arc radius mode
 	float arc_offset[3];  				// IJK - used by arc commands
+	float q_word;						// Q - second control point Y offset for G5, peck increment for G73, G83
 
 // unimplemented gcode parameters
 //	float cutter_radius;				// D - cutter radius compensation (0 is off)
@@ -187,6 +195,11 @@ typedef struct GCodeInput {				// Gcode model inputs - meaning depends on contex
  * CANONICAL MACHINE STRUCTURES
  */
 
+#define SHAPER_IMPULSES_MAX 3			// ZVD and EI shapers have 3 impulses
+#define SHAPER_FREQUENCY_MIN 10.0		// Hz - longer shapers won't fit the runtime history
+#define SHAPER_DAMPING_MAX 0.5
+#define SHAPER_EI_VIBRATION 0.05		// residual vibration the EI shaper tolerates
+
 typedef struct cmAxis {
 	uint8_t axis_mode;					// see tgAxisMode in gcode.h
 	float feedrate_max;					// max velocity in mm/min or deg/min
@@ -202,8 +215,30 @@ typedef struct cmAxis {
 	float latch_velocity;				// homing latch velocity
 	float latch_backoff;				// backoff from switches prior to homing latch movement
 	float zero_backoff;					// backoff from switches for machine zero
+	uint8_t homing_group;				// axes with the same group are homed together, lowest group first
+
+	uint8_t shaper_type;				// input shaper - see cmShaperType
+	float shaper_frequency;				// ringing frequency the shaper cancels, in Hz
+	float shaper_damping;				// damping ratio of the ringing
+	uint8_t shaper_impulses;			// derived: number of impulses, 0 if the shaper is off
+	float shaper_amplitude[SHAPER_IMPULSES_MAX];// derived: impulse amplitudes, summing to 1
+	float shaper_delay[SHAPER_IMPULSES_MAX];	// derived: impulse delays in minutes
+
+	float backlash;						// lost motion on a direction reversal, 0 for none
+	float backlash_rate;				// velocity the lost motion is taken up at
 } cfgAxis_t;
 
+typedef struct cmRasterLine {			// raster line command parameters - see cm_raster_line()
+	float start[2];						// X and Y start point in work coordinates
+	uint8_t start_flag[2];				// TRUE if the start point was given in this command
+	float direction[2];					// I and J scan direction (need not be normalized)
+	float pitch;						// pixel pitch
+	float feed_rate;					// scan feed rate
+	stat_t data_status;					// result of decoding the pixel data
+	uint8_t pixel_count;				// pixels decoded from the data
+	uint8_t pixel[RASTER_PIXELS_MAX];	// pixel power - 0 is off, 255 is full power
+} cmRasterLine_t;
+
 typedef struct cmSingleton {			// struct to manage cm globals and cycles
 	magic_t magic_start;				// magic number to test memory integrity
 
@@ -211,8 +246,13 @@ typedef struct cmSingleton {			// struct to manage cm globals and cycles
 
 	// system group settings
 	float junction_acceleration;		// centripetal acceleration max for cornering
+	uint8_t junction_model;				// corner speed model - see cmJunctionModel
+	float junction_time;				// corner time window for the jerk model, in ms
 	float chordal_tolerance;			// arc chordal accuracy setting in mm
 	uint8_t soft_limit_enable;
+	uint8_t traverse_mode;				// G0 rapid mode - see cmTraverseMode
+	float peck_clearance;				// G83 re-entry height above the last peck in mm
+	float peck_retract;					// G73 back off distance between pecks in mm
 
 	// hidden system settings
 	float min_segment_len;				// line drawing resolution in mm
@@ -252,6 +292,10 @@ typedef struct cmSingleton {			// struct to manage cm globals and cycles
 	uint8_t queue_flush_requested;		// queue flush character has been received
 	uint8_t end_hold_requested;		// cycle start character has been received (flag to end feedhold)
 	float jogging_dest;					// jogging direction as a relative move from current position
+	float jog_velocity[AXES];			// velocity jog vector in machine coordinates (mm/min)
+	cmRasterLine_t raster;				// raster line command being received
+	float spline_reflect[2];			// first control point for a G5 that omits I and J
+	uint8_t spline_reflect_valid;		// TRUE if the last move was a G5 (see cm_spline_feed())
 	struct GCodeState *am;				// active Gcode model is maintained by state management
     
 	uint8_t waiting_for_gcode_resume;   // are we waiting on an M2 or M30 after a queue flush?
@@ -410,7 +454,10 @@ enum cmNextAction {						// these are in order to optimized CASE statement
 	NEXT_ACTION_SUSPEND_ORIGIN_OFFSETS,	// G92.2
 	NEXT_ACTION_RESUME_ORIGIN_OFFSETS,	// G92.3
 	NEXT_ACTION_DWELL,					// G4
-	NEXT_ACTION_STRAIGHT_PROBE			// G38.2
+	NEXT_ACTION_STRAIGHT_PROBE,			// G38.2
+	NEXT_ACTION_PROBE_GRID,				// G29 probe a grid and enable Z compensation
+	NEXT_ACTION_DISABLE_GRID,			// G29.1 disable grid Z compensation
+	NEXT_ACTION_ENABLE_GRID				// G29.2 enable grid Z compensation
 };
 
 enum cmMotionMode {						// G Modal Group 1
@@ -428,7 +475,11 @@ enum cmMotionMode {						// G Modal Group 1
 	MOTION_MODE_CANNED_CYCLE_86,		// G86 - boring, spindle stop, rapid out
 	MOTION_MODE_CANNED_CYCLE_87,		// G87 - back boring
 	MOTION_MODE_CANNED_CYCLE_88,		// G88 - boring, spindle stop, manual out
-	MOTION_MODE_CANNED_CYCLE_89			// G89 - boring, dwell, feed out
+	MOTION_MODE_CANNED_CYCLE_89,		// G89 - boring, dwell, feed out
+	// new modes go on the end - these values are reported to hosts as momo
+	MOTION_MODE_CUBIC_SPLINE,			// G5 - cubic spline feed
+	MOTION_MODE_QUADRATIC_SPLINE,		// G5.1 - quadratic spline feed
+	MOTION_MODE_CANNED_CYCLE_73			// G73 - chip breaking peck drilling
 };
 
 enum cmModalGroup {						// Used for detecting gcode errors. See NIST section 3.4
@@ -487,6 +538,11 @@ enum cmDistanceMode {
 	INCREMENTAL_MODE				// G91
 };
 
+enum cmRetractMode {				// canned cycle retract height
+	RETRACT_TO_INITIAL_LEVEL = 0,	// G98 - Z at the start of the block, or R if higher
+	RETRACT_TO_R_PLANE				// G99
+};
+
 enum cmFeedRateMode {
 	INVERSE_TIME_MODE = 0,			// G93
 	UNITS_PER_MINUTE_MODE,			// G94
@@ -533,6 +589,23 @@ enum cmAxisMode {					// axis modes (ordered: see _cm_get_feed_time())
 #define AXIS_MODE_MAX_LINEAR AXIS_INHIBITED
 #define AXIS_MODE_MAX_ROTARY AXIS_RADIUS
 
+enum cmJunctionModel {				// corner speed models - see _get_junction_vmax()
+	JUNCTION_MODEL_DEVIATION = 0,	// junction deviation and junction acceleration
+	JUNCTION_MODEL_JERK				// axis jerk limits over the junction time
+};
+
+enum cmTraverseMode {				// G0 rapid modes - see cm_straight_traverse()
+	TRAVERSE_COORDINATED = 0,		// straight line, limited by the slowest axis over the whole move
+	TRAVERSE_DOGLEG					// each axis runs its own time-optimal profile
+};
+
+enum cmShaperType {					// input shapers - see cm_set_axis_shaper()
+	SHAPER_OFF = 0,
+	SHAPER_ZV,						// zero vibration - 2 impulses, shortest delay
+	SHAPER_ZVD,						// zero vibration and derivative - 3 impulses, tolerates frequency error
+	SHAPER_EI						// extra insensitive - 3 impulses, tolerates more frequency error
+};
+
 /*****************************************************************************
  * FUNCTION PROTOTYPES
  * Serves as a table of contents for the rather large canonical machine source file.
@@ -604,6 +677,7 @@ stat_t cm_select_plane(uint8_t plane);							// G17, G18, G19
 stat_t cm_set_units_mode(uint8_t mode);							// G20, G21
 stat_t cm_set_distance_mode(uint8_t mode);						// G90, G91
 stat_t cm_set_arc_distance_mode(const uint8_t mode);            // G90.1, G91.1
+stat_t cm_set_retract_mode(uint8_t mode);						// G98, G99
 stat_t cm_set_coord_offsets(const uint8_t coord_system, const uint8_t L_word, const float offset[], const float flag[]); // G10 L2
 
 void cm_set_position(uint8_t axis, float position);				// set absolute position - single axis
@@ -636,6 +710,11 @@ stat_t cm_arc_feed(const float target[], const float target_f[],             //
                    const float P_word, const bool P_word_f,                 // parameter
                    const bool modal_g1_f,                                   // modal group flag for motion group
                    const uint8_t motion_mode);                              // defined motion mode
+stat_t cm_spline_feed(const float target[], const float target_f[],          // G5/G5.1 - target endpoint
+                      const float offset[], const float offset_f[],          // IJ control point offsets
+                      const float P_word, const bool P_word_f,              // P and Q end control point offsets
+                      const float Q_word, const bool Q_word_f,
+                      const uint8_t motion_mode);                           // defined motion mode
 
 stat_t cm_dwell(float seconds);									// G4, P parameter
 
@@ -688,13 +767,32 @@ stat_t cm_homing_cycle_callback(void);							// G28.2/.4 main loop callback
 
 // Probe cycles
 stat_t cm_straight_probe(float target[], float flags[]);		// G38.2
-stat_t cm_probing_cycle_callback(void);							// G38.2 main loop callback
+stat_t cm_probing_cycle_callback(void);							// G38.2, G29 main loop callback
+stat_t cm_probe_grid(float target[], float flags[], float counts[], float count_flags[]);	// G29
+stat_t cm_probe_grid_compensation(uint8_t enable);				// G29.1, G29.2
+void cm_set_grid_compensation(uint8_t enable);					// requires motion to be stopped
+float cm_get_grid_offset(const float position[]);				// Z compensation at position (runtime)
+
+// Drilling cycles
+stat_t cm_drilling_cycle_start(const float target[], const float flags[],	// G73, G81, G82, G83
+							   const float R, const bool R_f,
+							   const float P, const bool P_f,
+							   const float Q, const bool Q_f,
+							   const uint8_t L, const bool L_f,
+							   const uint8_t motion_mode);
+stat_t cm_drilling_cycle_callback(void);						// drilling cycle main loop callback
+void cm_abort_drilling_cycle(void);
+void cm_clear_drilling_words(void);								// G80, G0-G3, program end
 
 // Jogging cycle
 stat_t cm_jogging_cycle_callback(void);							// jogging cycle main loop
 stat_t cm_jogging_cycle_start(uint8_t axis);					// {"jogx":-100.3}
+stat_t cm_jog_velocity_update(void);							// {"jvx":500}
 float cm_get_jogging_dest(void);
 
+// Raster engraving
+stat_t cm_raster_line(void);									// {"ras":{...}}
+
 /*--- E-Stop ---*/
 stat_t cm_start_estop(void);
 stat_t cm_end_estop(void);
@@ -736,11 +834,20 @@ stat_t cm_run_jogx(nvObj_t *nv);		// start jogging cycle for x
 stat_t cm_run_jogy(nvObj_t *nv);		// start jogging cycle for y
 stat_t cm_run_jogz(nvObj_t *nv);		// start jogging cycle for z
 stat_t cm_run_joga(nvObj_t *nv);		// start jogging cycle for a
+stat_t cm_set_jog_velocity(nvObj_t *nv);// set a velocity jog axis and start or steer the jog
+stat_t cm_run_raster(nvObj_t *nv);		// set raster line parameters and queue the line
+stat_t cm_set_raster_start(nvObj_t *nv);// set a raster line start coordinate
+stat_t cm_set_raster_data(nvObj_t *nv);	// decode raster line pixel data
 
 stat_t cm_get_am(nvObj_t *nv);			// get axis mode
 stat_t cm_set_am(nvObj_t *nv);			// set axis mode
 stat_t cm_set_xjm(nvObj_t *nv);			// set jerk max with 1,000,000 correction
 stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
+stat_t cm_set_jt(nvObj_t *nv);			// set junction time
+void cm_set_axis_shaper(uint8_t axis);
+stat_t cm_set_sh(nvObj_t *nv);			// set input shaper type
+stat_t cm_set_sf(nvObj_t *nv);			// set input shaper frequency
+stat_t cm_set_sd(nvObj_t *nv);			// set input shaper damping
 
 /*--- text_mode support functions ---*/
 
@@ -781,8 +888,13 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	void cm_print_ofs(nvObj_t *nv);		// print runtime work offset always in MM uints
 
 	void cm_print_ja(nvObj_t *nv);		// global CM settings
+	void cm_print_jmo(nvObj_t *nv);
+	void cm_print_jt(nvObj_t *nv);
 	void cm_print_ct(nvObj_t *nv);
 	void cm_print_sl(nvObj_t *nv);
+	void cm_print_tmo(nvObj_t *nv);
+	void cm_print_pkc(nvObj_t *nv);
+	void cm_print_pkr(nvObj_t *nv);
 	void cm_print_ml(nvObj_t *nv);
 	void cm_print_ma(nvObj_t *nv);
 	void cm_print_ms(nvObj_t *nv);
@@ -803,6 +915,12 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	void cm_print_lv(nvObj_t *nv);
 	void cm_print_lb(nvObj_t *nv);
 	void cm_print_zb(nvObj_t *nv);
+	void cm_print_hg(nvObj_t *nv);
+	void cm_print_sh(nvObj_t *nv);
+	void cm_print_sf(nvObj_t *nv);
+	void cm_print_sd(nvObj_t *nv);
+	void cm_print_bl(nvObj_t *nv);
+	void cm_print_br(nvObj_t *nv);
 	void cm_print_cofs(nvObj_t *nv);
 	void cm_print_cpos(nvObj_t *nv);
 
@@ -845,8 +963,13 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	#define cm_print_ofs tx_print_stub		// print runtime work offset always in MM uints
 
 	#define cm_print_ja tx_print_stub		// global CM settings
+	#define cm_print_jmo tx_print_stub
+	#define cm_print_jt tx_print_stub
 	#define cm_print_ct tx_print_stub
 	#define cm_print_sl tx_print_stub
+	#define cm_print_tmo tx_print_stub
+	#define cm_print_pkc tx_print_stub
+	#define cm_print_pkr tx_print_stub
 	#define cm_print_ml tx_print_stub
 	#define cm_print_ma tx_print_stub
 	#define cm_print_ms tx_print_stub
@@ -867,6 +990,12 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	#define cm_print_lv tx_print_stub
 	#define cm_print_lb tx_print_stub
 	#define cm_print_zb tx_print_stub
+	#define cm_print_hg tx_print_stub
+	#define cm_print_sh tx_print_stub
+	#define cm_print_sf tx_print_stub
+	#define cm_print_sd tx_print_stub
+	#define cm_print_bl tx_print_stub
+	#define cm_print_br tx_print_stub
 	#define cm_print_cofs tx_print_stub
 	#define cm_print_cpos tx_print_stub
 
@@ -42,6 +42,7 @@
 #include "xio.h"
 
 static void _set_defa(nvObj_t *nv, bool print);
+static void _load_value(nvObj_t *nv);
 
 /***********************************************************************************
  **** STRUCTURE ALLOCATIONS ********************************************************
@@ -112,20 +113,38 @@ void config_init()
 	cm_set_units_mode(MILLIMETERS);				// must do inits in millimeter mode
 	nv->index = 0;								// this will read the first record in NVM
 
-	read_persistent_value(nv);
+	read_persistent_value(nv);					// also mounts and validates the persistence file
+#ifdef __ARM
+	uint32_t start = SysTickTimer_getValue();
+#endif
 //	if (nv->value != cs.fw_build) {				// case (1) NVM is not setup or not in revision
 	if (fp_NE(nv->value, TINYG_FIRMWARE_BUILD)) {
 		_set_defa(nv, false);
+#ifdef __ARM
+		nvm.boot_defaults_ms = SysTickTimer_getValue() - start;
+#endif
 	} else {									// case (2) NVM is setup and in revision
 //		rpt_print_loading_configs_message();
-		for (nv->index=0; nv_index_is_single(nv->index); nv->index++) {
-			if (GET_TABLE_BYTE(flags) & F_INITIALIZE) {
-				strncpy_P(nv->token, cfgArray[nv->index].token, TOKEN_LEN);	// read the token from the array
-				read_persistent_value(nv);
-				nv_set(nv);
-			}
+		if (read_persistent_values(nv, _load_value) != STAT_OK) {
+			_set_defa(nv, false);				// card went away mid-load; don't run half configured
 		}
 		sr_init_status_report();
+#ifdef __ARM
+		nvm.boot_load_ms = SysTickTimer_getValue() - start;
+#endif
+	}
+}
+
+/*
+ * _load_value() - apply one value from the bulk persistence read in config_init()
+ */
+
+static void _load_value(nvObj_t *nv)
+{
+	if (!nv_index_is_single(nv->index)) return;
+	if (GET_TABLE_BYTE(flags) & F_INITIALIZE) {
+		strncpy_P(nv->token, cfgArray[nv->index].token, TOKEN_LEN);	// read the token from the array
+		nv_set(nv);
 	}
 }
 
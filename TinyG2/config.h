@@ -238,12 +238,14 @@ enum valueType {						// value typing for config and JSON
 #define F_PERSIST 		0x02			// persist this item when set is run
 #define F_NOSTRIP		0x04			// do not strip the group prefix from the token
 #define F_CONVERT		0x08			// set if unit conversion is required
+#define F_STRING		0x10			// set takes a string value (e.g. a file name)
 
 #define _f0				0x00
 #define _fi				(F_INITIALIZE)
 #define _fp				(F_PERSIST)
 #define _fn				(F_NOSTRIP)
 #define _fc				(F_CONVERT)
+#define _fs				(F_STRING)
 #define _fip			(F_INITIALIZE | F_PERSIST)
 #define _fipc			(F_INITIALIZE | F_PERSIST | F_CONVERT)
 #define _fipn			(F_INITIALIZE | F_PERSIST | F_NOSTRIP)
@@ -35,6 +35,7 @@
 #include "settings.h"
 #include "planner.h"
 #include "stepper.h"
+#include "kinematics.h"
 #include "switch.h"
 #include "pwm.h"
 #include "report.h"
@@ -173,6 +174,18 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "jog","jogy",_f0, 0, tx_print_nul, get_nul, cm_run_jogy, (float *)&cm.jogging_dest, 0},
 	{ "jog","jogz",_f0, 0, tx_print_nul, get_nul, cm_run_jogz, (float *)&cm.jogging_dest, 0},
 	{ "jog","joga",_f0, 0, tx_print_nul, get_nul, cm_run_joga, (float *)&cm.jogging_dest, 0},
+	{ "jog","jvx",_f0, 3, tx_print_nul, get_flt, cm_set_jog_velocity, (float *)&cm.jog_velocity[AXIS_X], 0},
+	{ "jog","jvy",_f0, 3, tx_print_nul, get_flt, cm_set_jog_velocity, (float *)&cm.jog_velocity[AXIS_Y], 0},
+	{ "jog","jvz",_f0, 3, tx_print_nul, get_flt, cm_set_jog_velocity, (float *)&cm.jog_velocity[AXIS_Z], 0},
+	{ "jog","jva",_f0, 3, tx_print_nul, get_flt, cm_set_jog_velocity, (float *)&cm.jog_velocity[AXIS_A], 0},
+
+	{ "ras","rasx",_f0, 3, tx_print_nul, get_flt, cm_set_raster_start, (float *)&cm.raster.start[0], 0},	// raster line start
+	{ "ras","rasy",_f0, 3, tx_print_nul, get_flt, cm_set_raster_start, (float *)&cm.raster.start[1], 0},
+	{ "ras","rasi",_fi, 3, tx_print_nul, get_flt, set_flt, (float *)&cm.raster.direction[0], 1},		// scan direction
+	{ "ras","rasj",_fi, 3, tx_print_nul, get_flt, set_flt, (float *)&cm.raster.direction[1], 0},
+	{ "ras","rasp",_fi, 4, tx_print_nul, get_flt, set_flt, (float *)&cm.raster.pitch, 0.1},			// pixel pitch
+	{ "ras","rasf",_f0, 0, tx_print_nul, get_flt, set_flt, (float *)&cm.raster.feed_rate, 0},		// scan feed rate
+	{ "ras","rasd",_f0, 0, tx_print_nul, get_nul, cm_set_raster_data, (float *)&cs.null, 0},		// base64 pixel data
 //	{ "jog","jogb",_f0, 0, tx_print_nul, get_nul, cm_run_jogb, (float *)&cm.jogging_dest, 0},
 //	{ "jog","jogc",_f0, 0, tx_print_nul, get_nul, cm_run_jogc, (float *)&cm.jogging_dest, 0},
 
@@ -184,6 +197,9 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "", "er",  _f0, 0, tx_print_nul, rpt_er,  set_nul,  (float *)&cs.null, 0 },	// invoke bogus exception report for testing
 	{ "", "qf",  _f0, 0, tx_print_nul, get_nul, cm_run_qf,(float *)&cs.null, 0 },	// queue flush
 	{ "", "rx",  _f0, 0, tx_print_int, get_rx,  set_nul,  (float *)&cs.null, 0 },	// space in RX buffer
+	{ "", "runb",_f0, 0, xio_print_runb,xio_get_runb,set_nul,(float *)&cs.null, 0 },	// SD job progress - bytes read
+	{ "", "runl",_f0, 0, xio_print_runl,xio_get_runl,set_nul,(float *)&cs.null, 0 },	// SD job progress - lines read
+	{ "", "run", _fs, 0, xio_print_run,xio_get_run,xio_set_run,(float *)&cs.null, 0 },	// run G-code job file from SD card
 //	{ "", "wr",  _f0, 0, tx_print_int, get_wr,  set_nul,  (float *)&cs.null, 0 },	// slots available in RX window buffer
 	{ "", "msg", _f0, 0, tx_print_str, get_nul, set_nul,  (float *)&cs.null, 0 },	// string for generic messages
 //	{ "", "clc", _f0, 0, tx_print_nul, st_clc,  st_clc,   (float *)&cs.null, 0 },	// clear diagnostic step counters
@@ -201,7 +217,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #endif
 
 	// Motor parameters
-	{ "1","1ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_1].motor_map,	M1_MOTOR_MAP },
+	{ "1","1ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_1].motor_map,	M1_MOTOR_MAP },
 	{ "1","1sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_1].step_angle,	M1_STEP_ANGLE },
 	{ "1","1tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_1].travel_rev,	M1_TRAVEL_PER_REV },
 	{ "1","1mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_1].microsteps,	M1_MICROSTEPS },
@@ -210,9 +226,11 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #ifdef __ARM
 	{ "1","1pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_1].power_level,M1_POWER_LEVEL },
 	{ "1","1pli",_fip, 3, st_print_pli, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_1].power_level_idle,M1_POWER_LEVEL_IDLE },
+	{ "1","1hs",_fip, 0, st_print_hs, get_ui8, st_set_hs, (float *)&st_cfg.mot[MOTOR_1].homing_switch,	M1_HOMING_SWITCH },
+	{ "1","1ho",_fipc,4, st_print_ho, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_1].homing_offset,	M1_HOMING_OFFSET },
 #endif
 #if (MOTORS >= 2)
-	{ "2","2ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_2].motor_map,	M2_MOTOR_MAP },
+	{ "2","2ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_2].motor_map,	M2_MOTOR_MAP },
 	{ "2","2sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_2].step_angle,	M2_STEP_ANGLE },
 	{ "2","2tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_2].travel_rev,	M2_TRAVEL_PER_REV },
 	{ "2","2mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_2].microsteps,	M2_MICROSTEPS },
@@ -221,10 +239,12 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #ifdef __ARM
 	{ "2","2pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_2].power_level,M2_POWER_LEVEL},
 	{ "2","2pli",_fip, 3, st_print_pli, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_2].power_level_idle,M2_POWER_LEVEL_IDLE },
+	{ "2","2hs",_fip, 0, st_print_hs, get_ui8, st_set_hs, (float *)&st_cfg.mot[MOTOR_2].homing_switch,	M2_HOMING_SWITCH },
+	{ "2","2ho",_fipc,4, st_print_ho, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_2].homing_offset,	M2_HOMING_OFFSET },
 #endif
 #endif
 #if (MOTORS >= 3)
-	{ "3","3ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_3].motor_map,	M3_MOTOR_MAP },
+	{ "3","3ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_3].motor_map,	M3_MOTOR_MAP },
 	{ "3","3sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_3].step_angle,	M3_STEP_ANGLE },
 	{ "3","3tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_3].travel_rev,	M3_TRAVEL_PER_REV },
 	{ "3","3mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_3].microsteps,	M3_MICROSTEPS },
@@ -233,10 +253,12 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #ifdef __ARM
 	{ "3","3pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_3].power_level,M3_POWER_LEVEL },
 	{ "3","3pli",_fip, 3, st_print_pli, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_3].power_level_idle,M3_POWER_LEVEL_IDLE },
+	{ "3","3hs",_fip, 0, st_print_hs, get_ui8, st_set_hs, (float *)&st_cfg.mot[MOTOR_3].homing_switch,	M3_HOMING_SWITCH },
+	{ "3","3ho",_fipc,4, st_print_ho, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_3].homing_offset,	M3_HOMING_OFFSET },
 #endif
 #endif
 #if (MOTORS >= 4)
-	{ "4","4ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_4].motor_map,	M4_MOTOR_MAP },
+	{ "4","4ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_4].motor_map,	M4_MOTOR_MAP },
 	{ "4","4sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_4].step_angle,	M4_STEP_ANGLE },
 	{ "4","4tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_4].travel_rev,	M4_TRAVEL_PER_REV },
 	{ "4","4mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_4].microsteps,	M4_MICROSTEPS },
@@ -245,10 +267,12 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #ifdef __ARM
 	{ "4","4pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_4].power_level,M4_POWER_LEVEL },
 	{ "4","4pli",_fip, 3, st_print_pli, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_4].power_level_idle,M4_POWER_LEVEL_IDLE },
+	{ "4","4hs",_fip, 0, st_print_hs, get_ui8, st_set_hs, (float *)&st_cfg.mot[MOTOR_4].homing_switch,	M4_HOMING_SWITCH },
+	{ "4","4ho",_fipc,4, st_print_ho, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_4].homing_offset,	M4_HOMING_OFFSET },
 #endif
 #endif
 #if (MOTORS >= 5)
-	{ "5","5ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_5].motor_map,	M5_MOTOR_MAP },
+	{ "5","5ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_5].motor_map,	M5_MOTOR_MAP },
 	{ "5","5sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_5].step_angle,	M5_STEP_ANGLE },
 	{ "5","5tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_5].travel_rev,	M5_TRAVEL_PER_REV },
 	{ "5","5mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_5].microsteps,	M5_MICROSTEPS },
@@ -257,10 +281,12 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #ifdef __ARM
 	{ "5","5pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_5].power_level,M5_POWER_LEVEL },
 	{ "5","5pli",_fip, 3, st_print_pli, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_5].power_level_idle,M5_POWER_LEVEL_IDLE },
+	{ "5","5hs",_fip, 0, st_print_hs, get_ui8, st_set_hs, (float *)&st_cfg.mot[MOTOR_5].homing_switch,	M5_HOMING_SWITCH },
+	{ "5","5ho",_fipc,4, st_print_ho, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_5].homing_offset,	M5_HOMING_OFFSET },
 #endif
 #endif
 #if (MOTORS >= 6)
-	{ "6","6ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_6].motor_map,	M6_MOTOR_MAP },
+	{ "6","6ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_6].motor_map,	M6_MOTOR_MAP },
 	{ "6","6sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_6].step_angle,	M6_STEP_ANGLE },
 	{ "6","6tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_6].travel_rev,	M6_TRAVEL_PER_REV },
 	{ "6","6mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_6].microsteps,	M6_MICROSTEPS },
@@ -269,6 +295,8 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #ifdef __ARM
 	{ "6","6pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_6].power_level,M6_POWER_LEVEL },
 	{ "6","6pli",_fip, 3, st_print_pli, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_6].power_level_idle,M6_POWER_LEVEL_IDLE },
+	{ "6","6hs",_fip, 0, st_print_hs, get_ui8, st_set_hs, (float *)&st_cfg.mot[MOTOR_6].homing_switch,	M6_HOMING_SWITCH },
+	{ "6","6ho",_fipc,4, st_print_ho, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_6].homing_offset,	M6_HOMING_OFFSET },
 #endif
 #endif
 	// Axis parameters
@@ -288,6 +316,12 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "x","xlv",_fipc, 0, cm_print_lv, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].latch_velocity,	X_LATCH_VELOCITY },
 	{ "x","xlb",_fipc, 3, cm_print_lb, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].latch_backoff,	X_LATCH_BACKOFF },
 	{ "x","xzb",_fipc, 3, cm_print_zb, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].zero_backoff,	X_ZERO_BACKOFF },
+	{ "x","xhg",_fip,  0, cm_print_hg, get_ui8,   set_ui8,   (float *)&cm.a[AXIS_X].homing_group,	X_HOMING_GROUP },
+	{ "x","xsh",_fip,  0, cm_print_sh, get_ui8,   cm_set_sh, (float *)&cm.a[AXIS_X].shaper_type,	X_SHAPER_TYPE },
+	{ "x","xsf",_fip,  1, cm_print_sf, get_flt,   cm_set_sf, (float *)&cm.a[AXIS_X].shaper_frequency,X_SHAPER_FREQUENCY },
+	{ "x","xsd",_fip,  3, cm_print_sd, get_flt,   cm_set_sd, (float *)&cm.a[AXIS_X].shaper_damping,	X_SHAPER_DAMPING },
+	{ "x","xbl",_fipc, 4, cm_print_bl, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].backlash,		X_BACKLASH },
+	{ "x","xbr",_fipc, 0, cm_print_br, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].backlash_rate,	X_BACKLASH_RATE },
 
 	{ "y","yam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_Y].axis_mode,		Y_AXIS_MODE },
 	{ "y","yvm",_fipc, 0, cm_print_vm, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].velocity_max,	Y_VELOCITY_MAX },
@@ -305,6 +339,12 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "y","ylv",_fipc, 0, cm_print_lv, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].latch_velocity,	Y_LATCH_VELOCITY },
 	{ "y","ylb",_fipc, 3, cm_print_lb, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].latch_backoff,	Y_LATCH_BACKOFF },
 	{ "y","yzb",_fipc, 3, cm_print_zb, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].zero_backoff,	Y_ZERO_BACKOFF },
+	{ "y","yhg",_fip,  0, cm_print_hg, get_ui8,   set_ui8,   (float *)&cm.a[AXIS_Y].homing_group,	Y_HOMING_GROUP },
+	{ "y","ysh",_fip,  0, cm_print_sh, get_ui8,   cm_set_sh, (float *)&cm.a[AXIS_Y].shaper_type,	Y_SHAPER_TYPE },
+	{ "y","ysf",_fip,  1, cm_print_sf, get_flt,   cm_set_sf, (float *)&cm.a[AXIS_Y].shaper_frequency,Y_SHAPER_FREQUENCY },
+	{ "y","ysd",_fip,  3, cm_print_sd, get_flt,   cm_set_sd, (float *)&cm.a[AXIS_Y].shaper_damping,	Y_SHAPER_DAMPING },
+	{ "y","ybl",_fipc, 4, cm_print_bl, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].backlash,		Y_BACKLASH },
+	{ "y","ybr",_fipc, 0, cm_print_br, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].backlash_rate,	Y_BACKLASH_RATE },
 
 	{ "z","zam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_Z].axis_mode,		Z_AXIS_MODE },
 	{ "z","zvm",_fipc, 0, cm_print_vm, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].velocity_max,	Z_VELOCITY_MAX },
@@ -322,6 +362,12 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "z","zlv",_fipc, 0, cm_print_lv, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].latch_velocity,	Z_LATCH_VELOCITY },
 	{ "z","zlb",_fipc, 3, cm_print_lb, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].latch_backoff,	Z_LATCH_BACKOFF },
 	{ "z","zzb",_fipc, 3, cm_print_zb, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].zero_backoff,	Z_ZERO_BACKOFF },
+	{ "z","zhg",_fip,  0, cm_print_hg, get_ui8,   set_ui8,   (float *)&cm.a[AXIS_Z].homing_group,	Z_HOMING_GROUP },
+	{ "z","zsh",_fip,  0, cm_print_sh, get_ui8,   cm_set_sh, (float *)&cm.a[AXIS_Z].shaper_type,	Z_SHAPER_TYPE },
+	{ "z","zsf",_fip,  1, cm_print_sf, get_flt,   cm_set_sf, (float *)&cm.a[AXIS_Z].shaper_frequency,Z_SHAPER_FREQUENCY },
+	{ "z","zsd",_fip,  3, cm_print_sd, get_flt,   cm_set_sd, (float *)&cm.a[AXIS_Z].shaper_damping,	Z_SHAPER_DAMPING },
+	{ "z","zbl",_fipc, 4, cm_print_bl, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].backlash,		Z_BACKLASH },
+	{ "z","zbr",_fipc, 0, cm_print_br, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].backlash_rate,	Z_BACKLASH_RATE },
 
 	{ "a","aam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_A].axis_mode,		A_AXIS_MODE },
 	{ "a","avm",_fip,  0, cm_print_vm, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].velocity_max,	A_VELOCITY_MAX },
@@ -340,6 +386,12 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "a","alv",_fip,  0, cm_print_lv, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].latch_velocity,	A_LATCH_VELOCITY },
 	{ "a","alb",_fip,  3, cm_print_lb, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].latch_backoff,	A_LATCH_BACKOFF },
 	{ "a","azb",_fip,  3, cm_print_zb, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].zero_backoff,	A_ZERO_BACKOFF },
+	{ "a","ahg",_fip,  0, cm_print_hg, get_ui8,   set_ui8,   (float *)&cm.a[AXIS_A].homing_group,	A_HOMING_GROUP },
+	{ "a","ash",_fip,  0, cm_print_sh, get_ui8,   cm_set_sh, (float *)&cm.a[AXIS_A].shaper_type,	A_SHAPER_TYPE },
+	{ "a","asf",_fip,  1, cm_print_sf, get_flt,   cm_set_sf, (float *)&cm.a[AXIS_A].shaper_frequency,A_SHAPER_FREQUENCY },
+	{ "a","asd",_fip,  3, cm_print_sd, get_flt,   cm_set_sd, (float *)&cm.a[AXIS_A].shaper_damping,	A_SHAPER_DAMPING },
+	{ "a","abl",_fip,  4, cm_print_bl, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].backlash,		A_BACKLASH },
+	{ "a","abr",_fip,  0, cm_print_br, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].backlash_rate,	A_BACKLASH_RATE },
 
 	{ "b","bam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_B].axis_mode,		B_AXIS_MODE },
 	{ "b","bvm",_fip,  0, cm_print_vm, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].velocity_max,	B_VELOCITY_MAX },
@@ -358,6 +410,12 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "b","blv",_fip,  0, cm_print_lv, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].latch_velocity,	B_LATCH_VELOCITY },
 	{ "b","blb",_fip,  3, cm_print_lb, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].latch_backoff,	B_LATCH_BACKOFF },
 	{ "b","bzb",_fip,  3, cm_print_zb, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].zero_backoff,	B_ZERO_BACKOFF },
+	{ "b","bhg",_fip,  0, cm_print_hg, get_ui8,   set_ui8,   (float *)&cm.a[AXIS_B].homing_group,	B_HOMING_GROUP },
+	{ "b","bsh",_fip,  0, cm_print_sh, get_ui8,   cm_set_sh, (float *)&cm.a[AXIS_B].shaper_type,	B_SHAPER_TYPE },
+	{ "b","bsf",_fip,  1, cm_print_sf, get_flt,   cm_set_sf, (float *)&cm.a[AXIS_B].shaper_frequency,B_SHAPER_FREQUENCY },
+	{ "b","bsd",_fip,  3, cm_print_sd, get_flt,   cm_set_sd, (float *)&cm.a[AXIS_B].shaper_damping,	B_SHAPER_DAMPING },
+	{ "b","bbl",_fip,  4, cm_print_bl, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].backlash,		B_BACKLASH },
+	{ "b","bbr",_fip,  0, cm_print_br, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].backlash_rate,	B_BACKLASH_RATE },
 	{ "b","bjh",_fip,  0, cm_print_jh, get_flt,	  cm_set_xjh,(float *)&cm.a[AXIS_B].jerk_homing,	B_JERK_HOMING },
 #endif
 
@@ -378,6 +436,12 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "c","clv",_fip,  0, cm_print_lv, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].latch_velocity,	C_LATCH_VELOCITY },
 	{ "c","clb",_fip,  3, cm_print_lb, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].latch_backoff,	C_LATCH_BACKOFF },
 	{ "c","czb",_fip,  3, cm_print_zb, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].zero_backoff,	C_ZERO_BACKOFF },
+	{ "c","chg",_fip,  0, cm_print_hg, get_ui8,   set_ui8,   (float *)&cm.a[AXIS_C].homing_group,	C_HOMING_GROUP },
+	{ "c","csh",_fip,  0, cm_print_sh, get_ui8,   cm_set_sh, (float *)&cm.a[AXIS_C].shaper_type,	C_SHAPER_TYPE },
+	{ "c","csf",_fip,  1, cm_print_sf, get_flt,   cm_set_sf, (float *)&cm.a[AXIS_C].shaper_frequency,C_SHAPER_FREQUENCY },
+	{ "c","csd",_fip,  3, cm_print_sd, get_flt,   cm_set_sd, (float *)&cm.a[AXIS_C].shaper_damping,	C_SHAPER_DAMPING },
+	{ "c","cbl",_fip,  4, cm_print_bl, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].backlash,		C_BACKLASH },
+	{ "c","cbr",_fip,  0, cm_print_br, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].backlash_rate,	C_BACKLASH_RATE },
 	{ "c","cjh",_fip,  0, cm_print_jh, get_flt,	  cm_set_xjh,(float *)&cm.a[AXIS_C].jerk_homing, 	C_JERK_HOMING },
 #endif
 
@@ -392,6 +456,8 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "p1","p1wpl",_fip, 3, pwm_print_p1wpl, get_flt, set_flt,(float *)&pwm.c[PWM_1].ccw_phase_lo,	P1_CCW_PHASE_LO },
 	{ "p1","p1wph",_fip, 3, pwm_print_p1wph, get_flt, set_flt,(float *)&pwm.c[PWM_1].ccw_phase_hi,	P1_CCW_PHASE_HI },
 	{ "p1","p1pof",_fip, 3, pwm_print_p1pof, get_flt, set_flt,(float *)&pwm.c[PWM_1].phase_off,		P1_PWM_PHASE_OFF },
+	{ "p1","p1dpm",_fip, 0, pwm_print_p1dpm, get_ui8, set_01, (float *)&pwm.c[PWM_1].dynamic_power,	P1_DYNAMIC_POWER },
+	{ "p1","p1dpf",_fip, 3, pwm_print_p1dpf, get_flt, set_flt,(float *)&pwm.c[PWM_1].dynamic_power_floor, P1_DYNAMIC_POWER_FLOOR },
 
 	// Coordinate system offsets (G54-G59 and G92)
 	{ "g54","g54x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_X], G54_X_OFFSET },
@@ -477,8 +543,16 @@ const cfgItem_t cfgArray[] PROGMEM = {
 
 	// System parameters
 	{ "sys","ja", _fipnc,0, cm_print_ja,  get_flt,   set_flu,    (float *)&cm.junction_acceleration,JUNCTION_ACCELERATION },
+	{ "sys","jmo",_fipn, 0, cm_print_jmo, get_ui8,   set_01,     (float *)&cm.junction_model,		JUNCTION_MODEL },
+	{ "sys","jt", _fipn, 1, cm_print_jt,  get_flt,   cm_set_jt,  (float *)&cm.junction_time,		JUNCTION_TIME },
 	{ "sys","ct", _fipnc,4, cm_print_ct,  get_flt,   set_flu,    (float *)&cm.chordal_tolerance,	CHORDAL_TOLERANCE },
 	{ "sys","sl", _fipn, 0, cm_print_sl,  get_ui8,   set_ui8,    (float *)&cm.soft_limit_enable,	SOFT_LIMIT_ENABLE },
+	{ "sys","tmo",_fipn, 0, cm_print_tmo, get_ui8,   set_01,     (float *)&cm.traverse_mode,		TRAVERSE_MODE },
+	{ "sys","pkc",_fipnc,3, cm_print_pkc, get_flt,   set_flu,    (float *)&cm.peck_clearance,		PECK_CLEARANCE },
+	{ "sys","pkr",_fipnc,3, cm_print_pkr, get_flt,   set_flu,    (float *)&cm.peck_retract,		PECK_RETRACT },
+	{ "sys","kin",_fipn, 0, ik_print_kin, get_ui8,   ik_set_kin, (float *)&kin.type,				KINEMATICS },
+	{ "sys","kdl",_fipnc,3, ik_print_kdl, get_flt,   ik_set_delta,(float *)&kin.delta_arm_length,	DELTA_ARM_LENGTH },
+	{ "sys","kdr",_fipnc,3, ik_print_kdr, get_flt,   ik_set_delta,(float *)&kin.delta_radius,		DELTA_RADIUS },
 //	{ "sys","st", _fipn, 0, sw_print_st,  get_ui8,   sw_set_st,  (float *)&sw.type,				SWITCH_TYPE },
 	{ "sys","mt", _fipn, 2, st_print_mt,  get_flt,   st_set_mt,  (float *)&st_cfg.motor_power_timeout,MOTOR_POWER_TIMEOUT},
 	{ "",   "me", _f0,   0, tx_print_str, st_set_me, st_set_me,  (float *)&cs.null, 0 },
@@ -691,6 +765,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "","hom",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// axis homing state group
 	{ "","prb",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// probing state group
 	{ "","jog",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// axis jogging state group
+	{ "","ras",_f0, 0, tx_print_nul, get_grp, cm_run_raster,(float *)&cs.null,0 },	// raster line command
 	{ "","jid",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// job ID group
 	{ "","fxa",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// fixturing group a
 
@@ -721,7 +796,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 /***** Make sure these defines line up with any changes in the above table *****/
 
 #define NV_COUNT_UBER_GROUPS 	4 		// count of uber-groups, above
-#define STANDARD_GROUPS 		33		// count of standard groups, excluding diagnostic parameter groups
+#define STANDARD_GROUPS 		34		// count of standard groups, excluding diagnostic parameter groups
 
 #if (MOTORS >= 5)
 #define MOTOR_GROUP_5			1
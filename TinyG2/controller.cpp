@@ -183,9 +183,13 @@ static void _controller_HSM()
 	DISPATCH(rx_report_callback());             // conditionally send rx report
 
 	DISPATCH(_dispatch_control());				// read any control messages prior to executing cycles
+	DISPATCH(mp_parse_ahead_callback());		// move parsed-ahead blocks into the planner as buffers free up
+	DISPATCH(mp_start_callback());				// start motion from idle once enough blocks are planned
+	DISPATCH(mp_attached_command_callback());	// run attached commands that no move followed
 	DISPATCH(cm_arc_callback());			// arc generation runs as a cycle above lines
+	DISPATCH(cm_drilling_cycle_callback());		// canned drilling cycles (G73, G81-G83)
 	DISPATCH(cm_homing_cycle_callback());		// homing cycle operation (G28.2)
-	DISPATCH(cm_probing_cycle_callback());		// probing cycle operation (G38.2)
+	DISPATCH(cm_probing_cycle_callback());		// probing cycle operation (G38.2, G29)
 	DISPATCH(cm_jogging_cycle_callback());		// jog cycle operation
 	DISPATCH(cm_deferred_write_callback());		// persist G10 changes when not in machining cycle
     
@@ -367,7 +371,8 @@ void controller_set_secondary_source(uint8_t dev) { xio.secondary_src = dev;}
 */
 /*
  * _sync_to_tx_buffer() - return eagain if TX queue is backed up
- * _sync_to_planner() - return eagain if planner is not ready for a new command
+ * _sync_to_planner() - return eagain if neither the planner nor the parse-ahead queue can take a new command,
+ *					   or there is no raster line free for a raster command
  * _sync_to_time() - return eagain if planner is not ready for a new command
  */
 
@@ -381,9 +386,14 @@ static stat_t _sync_to_tx_buffer()
 
 static stat_t _sync_to_planner()
 {
-	if (mp_get_planner_buffers_available() < PLANNER_BUFFER_HEADROOM) { // allow up to N planner buffers for this line
+	if (mp_get_raster_lines_available() == 0) {		// a raster line command needs somewhere to put its pixels
 		return (STAT_EAGAIN);
 	}
+	if (mp_get_planner_buffers_available() < PLANNER_BUFFER_HEADROOM) { // allow up to N planner buffers for this line
+		if (mp_get_parse_ahead_available() < PARSE_AHEAD_HEADROOM) {	// ...or parse ahead if there's room
+			return (STAT_EAGAIN);
+		}
+	}
 	return (STAT_OK);
 }
 /*
@@ -0,0 +1,357 @@
+/*
+ * cycle_drilling.cpp - canned drilling cycles (G73, G81, G82, G83)
+ * This file is part of the TinyG project
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, you may use this file as part of a software library without
+ * restriction. Specifically, if other files instantiate templates or use macros or
+ * inline functions from this file, or you compile this file and link it with  other
+ * files to produce an executable, this file does not by itself cause the resulting
+ * executable to be covered by the GNU General Public License. This exception does not
+ * however invalidate any other reasons why the executable file might be covered by the
+ * GNU General Public License.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tinyg2.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "planner.h"
+#include "report.h"
+#include "util.h"
+
+/**** Drilling singleton structure ****/
+
+struct dcDrillingSingleton {		// persistent drilling cycle runtime variables
+	stat_t (*func)();				// binding for callback function state machine - NULL when idle
+	uint8_t motion_mode;			// cycle being run: G73, G81, G82 or G83
+
+	// sticky words - kept in mm until the next block supplies them or the cycle is cancelled
+	float z_word;					// hole bottom
+	float r_word;					// R plane
+	float q_word;					// peck increment (G73, G83)
+	float p_word;					// dwell at the bottom in seconds (G82)
+	uint8_t z_defined;
+	uint8_t r_defined;
+	uint8_t q_defined;
+
+	// the hole being drilled - absolute work coordinates in program units
+	float hole[2];					// XY of the hole
+	float step[2];					// XY advance between repeats (incremental mode only)
+	uint8_t repeats;				// holes left, including this one (L word)
+	float r_plane;
+	float bottom;
+	float clear_z;					// Z to retract to after each hole (G98/G99)
+	float depth;					// deepest point cut so far
+};
+static struct dcDrillingSingleton dc;
+
+/**** NOTE: global prototypes and other .h info is located in canonical_machine.h ****/
+
+static stat_t _set_dc_func(stat_t (*func)());
+static stat_t _drilling_move(uint8_t feed, uint8_t xy, float z);
+static float _drilling_setting(float mm);
+static stat_t _drilling_rise();
+static stat_t _drilling_position();
+static stat_t _drilling_approach();
+static stat_t _drilling_cut();
+static stat_t _drilling_peck_out();
+static stat_t _drilling_peck_in();
+static stat_t _drilling_chip_break();
+static stat_t _drilling_dwell();
+static stat_t _drilling_retract();
+
+/*****************************************************************************
+ * cm_drilling_cycle_start()	- G73, G81, G82, G83 canned drilling cycles
+ * cm_drilling_cycle_callback()	- main loop callback that queues the cycle's moves
+ * cm_abort_drilling_cycle()	- stop queueing moves (used by queue flush)
+ * cm_clear_drilling_words()	- forget the sticky Z, R, Q and P words
+ *
+ *	G81 X_ Y_ Z_ R_ L_		drill: feed to Z, rapid out
+ *	G82 X_ Y_ Z_ R_ P_ L_	drill with a P second dwell at the bottom
+ *	G83 X_ Y_ Z_ R_ Q_ L_	peck drill: feed Q at a time, rapid out to R between pecks
+ *	G73 X_ Y_ Z_ R_ Q_ L_	chip breaking: feed Q at a time, back off $pkr between pecks
+ *
+ *	The cycles are expanded here rather than in the parser, so a single block drills a
+ *	hole - or L holes in incremental mode - and every move goes through the normal
+ *	traverse and feed paths. That keeps soft limits, offsets and units handling, and it
+ *	lets the planner blend the rapids of a hole pattern into each other.
+ *
+ *	Each hole is:
+ *	  - rapid to the R plane first if Z is below it (once, at the start of the block)
+ *	  - rapid to the hole's X and Y
+ *	  - rapid down to the R plane
+ *	  - the cutting moves for the cycle
+ *	  - rapid up to the initial Z (G98) or the R plane (G99)
+ *
+ *	A G83 peck re-enters at $pkc above the depth already cut instead of feeding
+ *	through the empty part of the hole.
+ *
+ *	Z, R, Q and P are sticky, so a pattern can be drilled with one full block followed by
+ *	blocks with only X and Y. They are kept in mm, so a G20/G21 change doesn't rescale
+ *	them, and are cleared when the motion mode leaves the canned cycles (G80, G0-G3, G5)
+ *	and at program end or queue flush. In G91 R is measured from the Z at the start of
+ *	the block, Z from the R plane, and X and Y are the step between holes, repeated L
+ *	times. Only the XY plane is supported.
+ *
+ *	Like the other cycles only one queued move is issued per entry into the callback,
+ *	and only while the planner has headroom. The callback returns EAGAIN until the
+ *	cycle is done, which holds off the next Gcode block.
+ */
+
+stat_t cm_drilling_cycle_start(const float target[], const float flags[],
+							   const float R, const bool R_f,
+							   const float P, const bool P_f,
+							   const float Q, const bool Q_f,
+							   const uint8_t L, const bool L_f,
+							   const uint8_t motion_mode)
+{
+	if (cm.gm.select_plane != CANON_PLANE_XY) {
+		return (STAT_GCODE_ACTIVE_PLANE_IS_INVALID);
+	}
+	if (cm.gm.feed_rate_mode == INVERSE_TIME_MODE) {
+		return (STAT_GCODE_INVERSE_TIME_MODE_CANNOT_BE_USED);
+	}
+	if (fp_ZERO(cm.gm.feed_rate)) {
+		return (STAT_GCODE_FEEDRATE_NOT_SPECIFIED);
+	}
+	if (fp_TRUE(flags[AXIS_A]) || fp_TRUE(flags[AXIS_B]) || fp_TRUE(flags[AXIS_C])) {
+		return (STAT_GCODE_ROTARY_AXIS_CANNOT_BE_USED);
+	}
+	if (dc.func != NULL) {									// can't happen - the callback holds off new blocks
+		return (STAT_COMMAND_NOT_ACCEPTED);
+	}
+
+	// validate on local copies - a rejected block must leave the sticky words as they were
+	bool z_f = fp_TRUE(flags[AXIS_Z]);
+	float z_word = z_f ? target[AXIS_Z] : _drilling_setting(dc.z_word);
+	float r_word = R_f ? R : _drilling_setting(dc.r_word);
+
+	if (Q_f && (Q <= 0)) { return (STAT_Q_WORD_IS_INVALID);}
+	if (P_f && (P < 0)) { return (STAT_P_WORD_IS_NEGATIVE);}
+	if (L_f && (L < 1)) { return (STAT_L_WORD_IS_INVALID);}
+	if ((z_f == false) && (dc.z_defined == false)) { return (STAT_GCODE_AXIS_IS_MISSING);}
+	if ((R_f == false) && (dc.r_defined == false)) { return (STAT_R_WORD_IS_MISSING);}
+	if ((Q_f == false) && (dc.q_defined == false) &&
+		((motion_mode == MOTION_MODE_CANNED_CYCLE_73) || (motion_mode == MOTION_MODE_CANNED_CYCLE_83))) {
+		return (STAT_Q_WORD_IS_MISSING);
+	}
+
+	// resolve the words into absolute work coordinates
+	float z_start = cm_get_work_position(MODEL, AXIS_Z);
+	float r_plane, bottom;
+	if (cm.gm.distance_mode == ABSOLUTE_MODE) {
+		r_plane = r_word;
+		bottom = z_word;
+	} else {
+		r_plane = z_start + r_word;
+		bottom = r_plane + z_word;
+	}
+	if (bottom > r_plane) {
+		return (STAT_R_WORD_IS_INVALID);
+	}
+
+	// the block is good - commit the sticky words and set up the hole
+	if (z_f) { dc.z_word = _to_millimeters(z_word); dc.z_defined = true;}
+	if (R_f) { dc.r_word = _to_millimeters(r_word); dc.r_defined = true;}
+	if (Q_f) { dc.q_word = _to_millimeters(Q); dc.q_defined = true;}
+	if (P_f) { dc.p_word = P;}
+
+	if (cm.gm.distance_mode == ABSOLUTE_MODE) {
+		for (uint8_t i=0; i<2; i++) {
+			dc.hole[i] = fp_TRUE(flags[i]) ? target[i] : cm_get_work_position(MODEL, i);
+			dc.step[i] = 0;
+		}
+		dc.repeats = 1;										// L repeats the same hole in G90 - drill it once
+	} else {
+		for (uint8_t i=0; i<2; i++) {
+			dc.step[i] = fp_TRUE(flags[i]) ? target[i] : 0;
+			dc.hole[i] = cm_get_work_position(MODEL, i) + dc.step[i];
+		}
+		dc.repeats = L_f ? L : 1;
+	}
+	dc.r_plane = r_plane;
+	dc.bottom = bottom;
+	dc.clear_z = (cm.gmx.retract_mode == RETRACT_TO_R_PLANE) ? dc.r_plane : max(z_start, dc.r_plane);
+	dc.motion_mode = motion_mode;
+	dc.func = (z_start < dc.r_plane) ? _drilling_rise : _drilling_position;
+	return (STAT_OK);
+}
+
+stat_t cm_drilling_cycle_callback(void)
+{
+	if (dc.func == NULL) {
+		return (STAT_NOOP);
+	}
+	if (mp_get_planner_buffers_available() < PLANNER_BUFFER_HEADROOM) {
+		return (STAT_EAGAIN);
+	}
+	stat_t status = dc.func();
+	if ((status != STAT_OK) && (status != STAT_EAGAIN)) {	// a move failed - give up on the rest of the cycle
+		dc.func = NULL;
+		rpt_exception(status, NULL);
+		_drilling_move(false, false, dc.clear_z);			// but don't leave the drill in the hole
+	}
+	if (dc.func != NULL) {
+		return (STAT_EAGAIN);
+	}
+	cm.gm.motion_mode = dc.motion_mode;						// the moves left G0 or G1 in the model
+	return (STAT_OK);
+}
+
+void cm_abort_drilling_cycle(void)
+{
+	if (dc.func != NULL) {
+		dc.func = NULL;
+		cm.gm.motion_mode = dc.motion_mode;
+	}
+}
+
+void cm_clear_drilling_words(void)
+{
+	dc.z_defined = false;
+	dc.r_defined = false;
+	dc.q_defined = false;
+	dc.p_word = 0;
+}
+
+/*
+ * _set_dc_func()	- set the next state and return EAGAIN
+ * _drilling_move()	- rapid or feed to the hole XY or to a Z, in absolute work coordinates
+ * _drilling_setting() - convert a sticky word or peck setting from mm to program units
+ *
+ *	The targets are already resolved, so the move is made in absolute mode regardless of
+ *	G90/G91. The sticky words, peck clearance and retract are kept in mm and are converted
+ *	here.
+ *
+ *	A move too short for the planner (STAT_MINIMUM_TIME_MOVE) is skipped rather than
+ *	failing the cycle. The model has already taken its target, and the next move is
+ *	absolute, so it picks up the few microns that were dropped.
+ */
+
+static stat_t _set_dc_func(stat_t (*func)())
+{
+	dc.func = func;
+	return (STAT_EAGAIN);
+}
+
+static stat_t _drilling_move(uint8_t feed, uint8_t xy, float z)
+{
+	float target[AXES] = {0};
+	float flags[AXES] = {0};
+
+	if (xy == true) {
+		target[AXIS_X] = dc.hole[0];
+		target[AXIS_Y] = dc.hole[1];
+		flags[AXIS_X] = 1;
+		flags[AXIS_Y] = 1;
+	} else {
+		target[AXIS_Z] = z;
+		flags[AXIS_Z] = 1;
+	}
+	uint8_t saved_distance_mode = cm.gm.distance_mode;
+	cm.gm.distance_mode = ABSOLUTE_MODE;
+	stat_t status = (feed == true) ? cm_straight_feed(target, flags) : cm_straight_traverse(target, flags);
+	cm.gm.distance_mode = saved_distance_mode;
+	return ((status == STAT_MINIMUM_TIME_MOVE) ? STAT_OK : status);
+}
+
+static float _drilling_setting(float mm)
+{
+	return ((cm_get_units_mode(MODEL) == INCHES) ? (mm / MM_PER_INCH) : mm);
+}
+
+/*
+ * Cycle states. Each queues at most one move and selects the next state.
+ */
+
+static stat_t _drilling_rise()
+{
+	ritorno(_drilling_move(false, false, dc.r_plane));
+	return (_set_dc_func(_drilling_position));
+}
+
+static stat_t _drilling_position()
+{
+	ritorno(_drilling_move(false, true, 0));
+	return (_set_dc_func(_drilling_approach));
+}
+
+static stat_t _drilling_approach()
+{
+	ritorno(_drilling_move(false, false, dc.r_plane));
+	dc.depth = dc.r_plane;
+	return (_set_dc_func(_drilling_cut));
+}
+
+static stat_t _drilling_cut()
+{
+	float z = dc.bottom;
+	if ((dc.motion_mode == MOTION_MODE_CANNED_CYCLE_73) || (dc.motion_mode == MOTION_MODE_CANNED_CYCLE_83)) {
+		z = max(dc.depth - _drilling_setting(dc.q_word), dc.bottom);
+		if ((z - dc.bottom) < _drilling_setting(cm.gm.feed_rate * MIN_BLOCK_TIME)) {
+			z = dc.bottom;								// fold a last peck too short to plan into this one
+		}
+	}
+	ritorno(_drilling_move(true, false, z));
+	dc.depth = z;
+
+	if (fp_EQ(z, dc.bottom)) {
+		if ((dc.motion_mode == MOTION_MODE_CANNED_CYCLE_82) && (dc.p_word > 0)) {
+			return (_set_dc_func(_drilling_dwell));
+		}
+		return (_set_dc_func(_drilling_retract));
+	}
+	if (dc.motion_mode == MOTION_MODE_CANNED_CYCLE_83) {
+		return (_set_dc_func(_drilling_peck_out));
+	}
+	return (_set_dc_func(_drilling_chip_break));
+}
+
+static stat_t _drilling_peck_out()						// G83 - clear the chips
+{
+	ritorno(_drilling_move(false, false, dc.r_plane));
+	return (_set_dc_func(_drilling_peck_in));
+}
+
+static stat_t _drilling_peck_in()						// G83 - rapid back down to just above the cut
+{
+	float z = min(dc.depth + _drilling_setting(cm.peck_clearance), dc.r_plane);
+	ritorno(_drilling_move(false, false, z));
+	return (_set_dc_func(_drilling_cut));
+}
+
+static stat_t _drilling_chip_break()					// G73 - short back off to break the chip
+{
+	float z = min(dc.depth + _drilling_setting(cm.peck_retract), dc.r_plane);
+	ritorno(_drilling_move(false, false, z));
+	return (_set_dc_func(_drilling_cut));
+}
+
+static stat_t _drilling_dwell()
+{
+	cm_dwell(dc.p_word);
+	return (_set_dc_func(_drilling_retract));
+}
+
+static stat_t _drilling_retract()
+{
+	ritorno(_drilling_move(false, false, dc.clear_z));
+	if (--dc.repeats > 0) {
+		dc.hole[0] += dc.step[0];
+		dc.hole[1] += dc.step[1];
+		return (_set_dc_func(_drilling_position));
+	}
+	dc.func = NULL;										// done
+	return (STAT_OK);
+}
@@ -32,42 +32,51 @@
 #include "text_parser.h"
 #include "canonical_machine.h"
 #include "planner.h"
+#include "stepper.h"
+#include "kinematics.h"
 #include "switch.h"
 #include "report.h"
 
 /**** Homing singleton structure ****/
 
-struct hmHomingSingleton {			// persistent homing runtime variables
-	// controls for homing cycle
-	int8_t axis;					// axis currently being homed
-	uint8_t min_mode;				// mode for min switch for this axis
-	uint8_t max_mode;				// mode for max switch for this axis
-
-#ifndef __NEW_SWITCHES
-	int8_t homing_switch;			// homing switch for current axis (index into switch flag table)
-	int8_t limit_switch;			// limit switch for current axis, or -1 if none
-#else
-	int8_t homing_switch_axis;		// axis of current homing switch, or -1 if none
-	uint8_t homing_switch_position;	// min/max position of current homing switch
-	int8_t limit_switch_axis;		// axis of current limit switch, or -1 if none
-	uint8_t limit_switch_position;	// min/max position of current limit switch
+struct hmHomingAxis {				// per-axis homing variables for the axes in the current group
+	uint8_t homing_switch_position;	// min/max position of the homing switch
+	int8_t limit_switch_position;	// min/max position of the limit switch, or -1 if none
 	void (*switch_saved_on_leading)(struct swSwitch *s);
 	void (*switch_saved_on_trailing)(struct swSwitch *s);
-#endif
-
-	uint8_t homing_closed;			// 0=open, 1=closed
-	uint8_t limit_closed;			// 0=open, 1=closed
-	uint8_t set_coordinates;		// G28.4 flag. true = set coords to zero at the end of homing cycle
-	stat_t (*func)(int8_t axis);	// binding for callback function state machine
 
-	// per-axis parameters
-	float direction;				// set to 1 for positive (max), -1 for negative (to min);
 	float search_travel;			// signed distance to travel in search
 	float search_velocity;			// search speed as positive number
 	float latch_velocity;			// latch speed as positive number
 	float latch_backoff;			// max distance to back off switch during latch phase
 	float zero_backoff;				// distance to back off switch before setting zero
-	float max_clear_backoff;		// maximum distance of switch clearing backoffs before erring out
+	float saved_jerk;				// saved and restored for each axis homed
+
+	// gantry squaring - see _homing_axis_squaring()
+	uint8_t axis_motors;			// motors that stop on the axis homing switch
+	uint8_t square_motors;			// motors that stop on their own switch, 0 if the axis is not squared
+	float latch_position;			// runtime position where every motor of the axis sat on its switch edge
+
+	// current phase of the group
+	uint8_t pending;				// true while the axis still has to move in this phase
+	int8_t stop_switch_position;	// switch that ends this phase for the axis, or -1 to run the full travel
+	float start;					// runtime position at the start of the phase
+	float travel;					// signed travel for the phase
+	float velocity;					// velocity for the phase as positive number
+};
+
+struct hmHomingSingleton {			// persistent homing runtime variables
+	// controls for homing cycle
+	int8_t group;					// homing group currently being homed
+	uint8_t axes;					// bitmask of the axes being homed in the current group
+	uint8_t stop_state;				// switch state that ends the current phase (SW_OPEN or SW_CLOSED)
+	uint8_t set_coordinates;		// G28.4 flag. true = set coords to zero at the end of homing cycle
+	stat_t (*func)(int8_t group);	// binding for callback function state machine
+	stat_t (*next_func)(int8_t group);	// state to run once every axis has finished the current phase
+
+	struct hmHomingAxis ax[HOMING_AXES];
+	void (*motor_saved_on_leading[MOTORS])(struct swSwitch *s);	// squaring switch callbacks
+	void (*motor_saved_on_trailing[MOTORS])(struct swSwitch *s);
 
 	// state saved from gcode model
 	uint8_t saved_units_mode;		// G20,G21 global setting
@@ -75,41 +84,33 @@ struct hmHomingSingleton {			// persistent homing runtime variables
 	uint8_t saved_distance_mode;	// G90, G91 global setting
 	uint8_t saved_feed_rate_mode;	// G93, G94 global setting
 	float saved_feed_rate;			// F setting
-	float saved_jerk;				// saved and restored for each axis homed
 };
 static struct hmHomingSingleton hm;
 
+#define HOMING_TRAVEL_EPSILON 0.001		// remaining phase travel (mm or deg) treated as complete
+#define _in_group(axis) (hm.axes & (1 << (axis)))
+#define _square_axis(motor) ((st_cfg.mot[motor].homing_switch - 1) / SW_POSITIONS)	// squaring switch of a motor
+#define _square_position(motor) ((st_cfg.mot[motor].homing_switch - 1) % SW_POSITIONS)
+
 /**** NOTE: global prototypes and other .h info is located in canonical_machine.h ****/
 
-static stat_t _set_homing_func(stat_t (*func)(int8_t axis));
-static stat_t _homing_axis_start(int8_t axis);
-static stat_t _homing_axis_clear(int8_t axis);
-static stat_t _homing_axis_search(int8_t axis);
-static stat_t _homing_axis_latch(int8_t axis);
-static stat_t _homing_axis_zero_backoff(int8_t axis);
-static stat_t _homing_axis_set_zero(int8_t axis);
-static stat_t _homing_axis_move(int8_t axis, float target, float velocity);
+static stat_t _set_homing_func(stat_t (*func)(int8_t group));
+static stat_t _homing_group_start(int8_t group);
+static stat_t _homing_axis_setup(int8_t axis);
+static stat_t _homing_axis_squaring(int8_t axis);
+static stat_t _homing_group_clear(int8_t group);
+static stat_t _homing_group_search(int8_t group);
+static stat_t _homing_group_latch(int8_t group);
+static stat_t _homing_group_zero_backoff(int8_t group);
+static stat_t _homing_group_set_zero(int8_t group);
+static stat_t _homing_group_continue(int8_t group);
+static void _homing_axis_phase(int8_t axis, float travel, float velocity, int8_t stop_switch_position);
+static bool _homing_axis_switches(int8_t axis, int8_t state);
+static void _homing_arm_motor_stops(int8_t axis, uint8_t state);
+static stat_t _homing_group_move(stat_t (*next_func)(int8_t group));
 static stat_t _homing_error_exit(int8_t axis, stat_t status);
-static stat_t _homing_finalize_exit(int8_t axis);
-static int8_t _get_next_axis(int8_t axis);
-
-/*
-static void _homing_debug_print(int8_t axis)
-{
-	printf("axis:%d\n",axis);
-	printf("homing switch:%d\n", read_switch(hm.homing_switch));
-	printf("limit switch:%d\n", read_switch(hm.limit_switch));
-	printf("distance_mode:%d\n", cm_get_distance_mode(ACTIVE_MODEL));
-	printf("latch_backoff:%f\n", (double)hm.latch_backoff);
-	printf("search_travel:%f\n", (double)hm.search_travel);
-
-	printf("saved_units_mode:%d\n",hm.saved_units_mode);
-	printf("saved_coord_system:%d\n",hm.saved_coord_system);
-	printf("saved_distance_mode:%d\n",hm.saved_distance_mode);
-	printf("saved_feed_rate:%f\n",(double)hm.saved_feed_rate);
-	printf("saved_jerk:%f\n",(double)hm.saved_jerk);
-}
-*/
+static stat_t _homing_finalize_exit(int8_t group);
+static int8_t _get_next_group(int8_t group);
 
 /***********************************************************************************
  **** G28.2 Homing Cycle ***********************************************************
@@ -126,29 +127,43 @@ static void _homing_debug_print(int8_t axis)
  *	Homing is invoked using a G28.2 command with 1 or more axes specified in the
  *	command: e.g. g28.2 x0 y0 z0     (FYI: the number after each axis is irrelevant)
  *
- *	Homing is always run in the following order - for each enabled axis:
+ *	Axes are homed in groups, in ascending order of their homing group setting
+ *	($xhg, $yhg...). Axes that share a group are homed at the same time. The default
+ *	groups give the traditional one-at-a-time order:
  *	  Z,X,Y,A			Note: B and C cannot be homed
+ *	Setting e.g. xhg and yhg to the same value homes X and Y together after Z.
  *
  *	At the start of a homing cycle those switches configured for homing
  *	(or for homing and limits) are treated as homing switches (they are modal).
  *
- *	After initialization the following sequence is run for each axis to be homed:
+ *	After initialization the following sequence is run for each group to be homed:
  *
  *	  0. If a homing or limit switch is closed on invocation, clear off the switch
  *	  1. Drive towards the homing switch at search velocity until switch is hit
  *	  2. Drive away from the homing switch at latch velocity until switch opens
  *	  3. Back off switch by the zero backoff distance and set zero for that axis
  *
+ *	Each step drives every axis in the group that still has work to do as a single
+ *	move, with each axis at its own search or latch velocity. A switch change stops
+ *	the move with a feedhold; the axes whose switch reached the wanted state are then
+ *	done with that step and the move is re-issued for the rest from where they stopped.
+ *	So each axis stops and latches on its own switch, and the group takes about as
+ *	long as its slowest axis.
+ *
+ *	A gantry axis driven by two (or more) motors can be squared by homing. Give each extra
+ *	motor its own switch with $Nhs (1-8 = Xmin, Xmax, Ymin ... Amax - usually a spare
+ *	input, set to a homing mode). Motors left at 0 use the axis homing switch. During the
+ *	search and latch the switch pin interrupt stops each motor the moment its own switch
+ *	changes while the others carry on, and the axis is done once all of its switches have
+ *	changed. That leaves every motor on its switch edge. The zero backoff then also moves
+ *	each motor by its $Nho offset (positive is the positive axis direction), to trim
+ *	switches that are not exactly square. Squaring needs Cartesian kinematics and the
+ *	ARM pin interrupts.
+ *
  *	Homing works as a state machine that is driven by registering a callback
- *	function at hm.func() for the next state to be run. Once the axis is
+ *	function at hm.func() for the next state to be run. Once the group is
  *	initialized each callback basically does two things (1) start the move
  *	for the current function, and (2) register the next state with hm.func().
- *	When a move is started it will either be interrupted if the homing switch
- *	changes state, This will cause the move to stop with a feedhold. The other
- *	thing that can happen is the move will run to its full length if no switch
- *	change is detected (hit or open),
- *
- *	Once all moves for an axis are complete the next axis in the sequence is homed
  *
  *	When a homing cycle is initiated the homing state is set to HOMING_NOT_HOMED
  *	When homing completes successfully this is set to HOMING_HOMED, otherwise it
@@ -183,8 +198,9 @@ stat_t cm_homing_cycle_start(void)
 	cm_set_feed_rate_mode(UNITS_PER_MINUTE_MODE);
 	hm.set_coordinates = true;
 
-	hm.axis = -1;							// set to retrieve initial axis
-	hm.func = _homing_axis_start; 			// bind initial processing function
+	hm.group = -1;							// set to retrieve initial group
+	hm.axes = 0;
+	hm.func = _homing_group_start; 			// bind initial processing function
 	cm.machine_state = MACHINE_CYCLE;
 	cm.cycle_state = CYCLE_HOMING;
 	cm.homing_state = HOMING_NOT_HOMED;
@@ -198,32 +214,32 @@ stat_t cm_homing_cycle_start_no_set(void)
 	return (STAT_OK);
 }
 
-/* Homing axis moves - these execute in sequence for each axis
+/* Homing group moves - these execute in sequence for each group of axes
  * cm_homing_cycle_callback() 	- main loop callback for running the homing cycle
  *	_set_homing_func()			- a convenience for setting the next dispatch vector and exiting
- *	_homing_trigger_feedhold()			- callback from switch closure to trigger a feedhold (convenience for casting)
+ *	_homing_trigger_feedhold()	- callback from switch closure to trigger a feedhold (convenience for casting)
  *  _bind_switch_settings()		- setup switch for homing operation
  *	_restore_switch_settings()	- return switch to normal operation
- *	_homing_axis_start()		- get next axis, initialize variables, call the clear
- *	_homing_axis_clear()		- initiate a clear to move off a switch that is thrown at the start
- *	_homing_axis_search()		- fast search for switch, closes switch
- *	_homing_axis_latch()		- slow reverse until switch opens again
- *	_homing_axis_final()		- backoff from latch location to zero position
- *	_homing_axis_move()			- helper that actually executes the above moves
+ *	_homing_group_start()		- get next group, initialize its axes, call the clear
+ *	_homing_axis_setup()		- validate and initialize one axis of the group
+ *	_homing_group_clear()		- initiate a clear to move off switches that are thrown at the start
+ *	_homing_group_search()		- fast search for switches, closes switches
+ *	_homing_group_latch()		- slow reverse until switches open again
+ *	_homing_group_zero_backoff()- backoff from latch location to zero position
+ *	_homing_group_set_zero()	- set zero and restore the axes of the group
+ *	_homing_group_continue()	- retire the axes that are done and re-issue the move for the rest
+ *	_homing_axis_phase()		- set up one axis for the next group move
+ *	_homing_group_move()		- helper that actually executes the above moves
  */
-/*
-static stat_t _verify_position(int8_t axis)
-See build 071.09 for _verify_position() use
-*/
 
 stat_t cm_homing_cycle_callback(void)
 {
 	if (cm.cycle_state != CYCLE_HOMING) { return (STAT_NOOP);} 	// exit if not in a homing cycle
 	if (cm_get_runtime_busy() == true) { return (STAT_EAGAIN);}	// sync to planner move ends
-	return (hm.func(hm.axis));									// execute the current homing move
+	return (hm.func(hm.group));									// execute the current homing move
 }
 
-static stat_t _set_homing_func(stat_t (*func)(int8_t axis))
+static stat_t _set_homing_func(stat_t (*func)(int8_t group))
 {
 	hm.func = func;
 	return (STAT_EAGAIN);
@@ -234,135 +250,185 @@ static void _homing_trigger_feedhold(switch_t *s)
 	cm_request_feedhold();
 }
 
-static void _bind_switch_settings(switch_t *s)
+static void _bind_switch_settings(int8_t axis)
 {
-	hm.switch_saved_on_trailing = s->on_trailing;
-    hm.switch_saved_on_leading = s->on_leading;
+	switch_t *s = &sw.s[axis][hm.ax[axis].homing_switch_position];
+	hm.ax[axis].switch_saved_on_trailing = s->on_trailing;
+	hm.ax[axis].switch_saved_on_leading = s->on_leading;
 	s->on_trailing = _homing_trigger_feedhold;							// bind feedhold to leading & trailing edge
-    s->on_leading = _homing_trigger_feedhold;
+	s->on_leading = _homing_trigger_feedhold;
+
+	for (uint8_t motor = 0; motor < MOTORS; motor++) {					// and to the squaring switches
+		if (!(hm.ax[axis].square_motors & (1 << motor))) continue;
+		s = &sw.s[_square_axis(motor)][_square_position(motor)];
+		hm.motor_saved_on_trailing[motor] = s->on_trailing;
+		hm.motor_saved_on_leading[motor] = s->on_leading;
+		s->on_trailing = _homing_trigger_feedhold;
+		s->on_leading = _homing_trigger_feedhold;
+	}
 }
 
-static void _restore_switch_settings(switch_t *s)
+static void _restore_switch_settings(int8_t axis)
 {
-	s->on_trailing = hm.switch_saved_on_trailing;
-    s->on_leading = hm.switch_saved_on_leading;
+	switch_t *s = &sw.s[axis][hm.ax[axis].homing_switch_position];
+	s->on_trailing = hm.ax[axis].switch_saved_on_trailing;
+	s->on_leading = hm.ax[axis].switch_saved_on_leading;
+	sw_disarm_capture(axis, hm.ax[axis].homing_switch_position);
+
+	for (uint8_t motor = 0; motor < MOTORS; motor++) {
+		if (!(hm.ax[axis].square_motors & (1 << motor))) continue;
+		s = &sw.s[_square_axis(motor)][_square_position(motor)];
+		s->on_trailing = hm.motor_saved_on_trailing[motor];
+		s->on_leading = hm.motor_saved_on_leading[motor];
+		sw_disarm_capture(_square_axis(motor), _square_position(motor));
+	}
+	st_release_motors(hm.ax[axis].axis_motors | hm.ax[axis].square_motors);
 }
 
-static stat_t _homing_axis_start(int8_t axis)
+static stat_t _homing_group_start(int8_t group)
 {
-	// get the first or next axis
-	if ((axis = _get_next_axis(axis)) < 0) { 				// axes are done or error
-		if (axis == -1) {									// -1 is done
+	if (group < 0) {										// first group - home without grid compensation
+		cm_set_grid_compensation(false);
+	}
+
+	// get the first or next group
+	if ((group = _get_next_group(group)) < 0) { 			// groups are done or error
+		if (group == -1) {									// -1 is done
 			cm.homing_state = HOMING_HOMED;
 			return (_set_homing_func(_homing_finalize_exit));
-		} else if (axis == -2) { 							// -2 is error
+		} else if (group == -2) { 							// -2 is error
 			return (_homing_error_exit(-2, STAT_HOMING_ERROR_BAD_OR_NO_AXIS));
 		}
 	}
+	hm.group = group;										// persist the group
+	hm.axes = 0;
+
+	// validate every axis before binding any switches, so an error leaves nothing to undo
+	uint8_t axes = 0;
+	for (uint8_t axis = 0; axis < HOMING_AXES; axis++) {
+		if (!fp_TRUE(cm.gf.target[axis]) || (cm.a[axis].homing_group != group)) continue;
+		stat_t status = _homing_axis_setup(axis);
+		if (status == STAT_NOOP) continue;					// homing is disabled for the axis
+		if (status != STAT_OK) return (_homing_error_exit(axis, status));
+		axes |= (1 << axis);
+	}
+	for (uint8_t axis = 0; axis < HOMING_AXES; axis++) {
+		if (!(axes & (1 << axis))) continue;
+		_bind_switch_settings(axis);
+		hm.ax[axis].saved_jerk = cm_get_axis_jerk(axis);	// save the max jerk value
+	}
+	hm.axes = axes;
+	if (hm.axes == 0) {										// nothing to home in this group
+		return (_set_homing_func(_homing_group_start));
+	}
+	return (_set_homing_func(_homing_group_clear));			// start the clear
+}
+
+static stat_t _homing_axis_setup(int8_t axis)
+{
+	struct hmHomingAxis *a = &hm.ax[axis];
+
 	// clear the homed flag for axis so we'll be able to move w/o triggering soft limits
 	cm.homed[axis] = false;
 
 	// trap axis mis-configurations
-	if (fp_ZERO(cm.a[axis].search_velocity)) return (_homing_error_exit(axis, STAT_HOMING_ERROR_ZERO_SEARCH_VELOCITY));
-	if (fp_ZERO(cm.a[axis].latch_velocity)) return (_homing_error_exit(axis, STAT_HOMING_ERROR_ZERO_LATCH_VELOCITY));
-	if (cm.a[axis].latch_backoff < 0) return (_homing_error_exit(axis, STAT_HOMING_ERROR_NEGATIVE_LATCH_BACKOFF));
+	if (fp_ZERO(cm.a[axis].search_velocity)) return (STAT_HOMING_ERROR_ZERO_SEARCH_VELOCITY);
+	if (fp_ZERO(cm.a[axis].latch_velocity)) return (STAT_HOMING_ERROR_ZERO_LATCH_VELOCITY);
+	if (cm.a[axis].latch_backoff < 0) return (STAT_HOMING_ERROR_NEGATIVE_LATCH_BACKOFF);
 
 	// calculate and test travel distance
 	float travel_distance = fabs(cm.a[axis].travel_max - cm.a[axis].travel_min) + cm.a[axis].latch_backoff;
-	if (fp_ZERO(travel_distance)) return (_homing_error_exit(axis, STAT_HOMING_ERROR_TRAVEL_MIN_MAX_IDENTICAL));
+	if (fp_ZERO(travel_distance)) return (STAT_HOMING_ERROR_TRAVEL_MIN_MAX_IDENTICAL);
 
 	// determine the switch setup and that config is OK
-#ifndef __NEW_SWITCHES
-	hm.min_mode = get_switch_mode(MIN_SWITCH(axis));
-	hm.max_mode = get_switch_mode(MAX_SWITCH(axis));
-#else
-	hm.min_mode = get_switch_mode(axis, SW_MIN);
-	hm.max_mode = get_switch_mode(axis, SW_MAX);
-#endif
+	uint8_t min_mode = get_switch_mode(axis, SW_MIN);
+	uint8_t max_mode = get_switch_mode(axis, SW_MAX);
 
-	if ( ((hm.min_mode & SW_HOMING_BIT) ^ (hm.max_mode & SW_HOMING_BIT)) == 0) {	  // one or the other must be homing
-		return (_homing_error_exit(axis, STAT_HOMING_ERROR_SWITCH_MISCONFIGURATION)); // axis cannot be homed
+	if ( ((min_mode & SW_HOMING_BIT) ^ (max_mode & SW_HOMING_BIT)) == 0) {	  // one or the other must be homing
+		return (STAT_HOMING_ERROR_SWITCH_MISCONFIGURATION); // axis cannot be homed
 	}
-	hm.axis = axis;											// persist the axis
-	hm.search_velocity = fabs(cm.a[axis].search_velocity);	// search velocity is always positive
-	hm.latch_velocity = fabs(cm.a[axis].latch_velocity);	// latch velocity is always positive
+	a->search_velocity = fabs(cm.a[axis].search_velocity);	// search velocity is always positive
+	a->latch_velocity = fabs(cm.a[axis].latch_velocity);	// latch velocity is always positive
 
 	// setup parameters for homing to the minimum switch
-	if (hm.min_mode & SW_HOMING_BIT) {
-#ifndef __NEW_SWITCHES
-		hm.homing_switch = MIN_SWITCH(axis);				// the min is the homing switch
-		hm.limit_switch = MAX_SWITCH(axis);					// the max would be the limit switch
-#else
-		hm.homing_switch_axis = axis;
-		hm.homing_switch_position = SW_MIN;					// the min is the homing switch
-		hm.limit_switch_axis = axis;
-		hm.limit_switch_position = SW_MAX;					// the max would be the limit switch
-#endif
-		hm.search_travel = -travel_distance;				// search travels in negative direction
-		hm.latch_backoff = cm.a[axis].latch_backoff;		// latch travels in positive direction
-		hm.zero_backoff = cm.a[axis].zero_backoff;
+	if (min_mode & SW_HOMING_BIT) {
+		a->homing_switch_position = SW_MIN;					// the min is the homing switch
+		a->limit_switch_position = SW_MAX;					// the max would be the limit switch
+		a->search_travel = -travel_distance;				// search travels in negative direction
+		a->latch_backoff = cm.a[axis].latch_backoff;		// latch travels in positive direction
+		a->zero_backoff = cm.a[axis].zero_backoff;
 
 	// setup parameters for positive travel (homing to the maximum switch)
 	} else {
-#ifndef __NEW_SWITCHES
-		hm.homing_switch = MAX_SWITCH(axis);				// the max is the homing switch
-		hm.limit_switch = MIN_SWITCH(axis);					// the min would be the limit switch
-#else
-		hm.homing_switch_axis = axis;
-		hm.homing_switch_position = SW_MAX;					// the max is the homing switch
-		hm.limit_switch_axis = axis;
-		hm.limit_switch_position = SW_MIN;					// the min would be the limit switch
-#endif
-		hm.search_travel = travel_distance;					// search travels in positive direction
-		hm.latch_backoff = -cm.a[axis].latch_backoff;		// latch travels in negative direction
-		hm.zero_backoff = -cm.a[axis].zero_backoff;
-	}
-
-	// if homing is disabled for the axis then skip to the next axis
-#ifndef __NEW_SWITCHES
-	uint8_t sw_mode = get_switch_mode(hm.homing_switch);
-	if ((sw_mode != SW_MODE_HOMING) && (sw_mode != SW_MODE_HOMING_LIMIT)) {
-		return (_set_homing_func(_homing_axis_start));
+		a->homing_switch_position = SW_MAX;					// the max is the homing switch
+		a->limit_switch_position = SW_MIN;					// the min would be the limit switch
+		a->search_travel = travel_distance;					// search travels in positive direction
+		a->latch_backoff = -cm.a[axis].latch_backoff;		// latch travels in negative direction
+		a->zero_backoff = -cm.a[axis].zero_backoff;
 	}
-	// disable the limit switch parameter if there is no limit switch
-	if (get_switch_mode(hm.limit_switch) == SW_MODE_DISABLED) hm.limit_switch = -1;
-#else
-	switch_t *s = &sw.s[hm.homing_switch_axis][hm.homing_switch_position];
-	_bind_switch_settings(s);
 
-	uint8_t sw_mode = get_switch_mode(hm.homing_switch_axis, hm.homing_switch_position);
+	// if homing is disabled for the axis then skip it
+	uint8_t sw_mode = get_switch_mode(axis, a->homing_switch_position);
 	if ((sw_mode != SW_MODE_HOMING) && (sw_mode != SW_MODE_HOMING_LIMIT)) {
-		return (_set_homing_func(_homing_axis_start));
+		return (STAT_NOOP);
 	}
 	// disable the limit switch parameter if there is no limit switch
-	if (!(get_switch_mode(hm.limit_switch_axis, hm.limit_switch_position) & SW_LIMIT_BIT)) {
-		hm.limit_switch_axis = -1;
+	if (!(get_switch_mode(axis, a->limit_switch_position) & SW_LIMIT_BIT)) {
+		a->limit_switch_position = -1;
 	}
-#endif
+	return (_homing_axis_squaring(axis));
+}
+
+/*
+ * _homing_axis_squaring() - find the motors of a gantry axis that home to their own switch
+ *
+ *	Each squaring switch must be set to a homing mode, so its state is tracked, and must
+ *	not be the axis homing switch. If no motor has its own switch the axis is not squared.
+ */
 
-	hm.saved_jerk = cm_get_axis_jerk(axis);					// save the max jerk value
-	return (_set_homing_func(_homing_axis_clear));			// start the clear
+static stat_t _homing_axis_squaring(int8_t axis)
+{
+	struct hmHomingAxis *a = &hm.ax[axis];
+	a->axis_motors = 0;
+	a->square_motors = 0;
+	if (kin.type != KINEMATICS_CARTESIAN) return (STAT_OK);
+
+	for (uint8_t motor = 0; motor < MOTORS; motor++) {
+		if (st_cfg.mot[motor].motor_map != axis) continue;
+		if (st_cfg.mot[motor].homing_switch == 0) {
+			a->axis_motors |= (1 << motor);
+			continue;
+		}
+		if ((st_cfg.mot[motor].homing_switch > SW_PAIRS * SW_POSITIONS) ||
+			!(get_switch_mode(_square_axis(motor), _square_position(motor)) & SW_HOMING_BIT) ||
+			((_square_axis(motor) == axis) && (_square_position(motor) == a->homing_switch_position))) {
+			return (STAT_HOMING_ERROR_SWITCH_MISCONFIGURATION);
+		}
+		a->square_motors |= (1 << motor);
+	}
+	if (a->square_motors == 0) {
+		a->axis_motors = 0;
+	}
+	return (STAT_OK);
 }
 
 // Handle an initial switch closure by backing off the closed switch
 // NOTE: Relies on independent switches per axis (not shared)
-static stat_t _homing_axis_clear(int8_t axis)				// first clear move
+static stat_t _homing_group_clear(int8_t group)			// first clear move
 {
-#ifndef __NEW_SWITCHES
-	if (read_switch(hm.homing_switch) == SW_CLOSED) {
-		_homing_axis_move(axis, hm.latch_backoff, hm.search_velocity);
-	} else if (read_switch(hm.limit_switch) == SW_CLOSED) {
-		_homing_axis_move(axis, -hm.latch_backoff, hm.search_velocity);
-	}
-#else
-	if (read_switch(hm.homing_switch_axis, hm.homing_switch_position) == SW_CLOSED) {
-		_homing_axis_move(axis, hm.latch_backoff, hm.search_velocity);
-	} else if (hm.limit_switch_axis != -1 &&
-               read_switch(hm.limit_switch_axis, hm.limit_switch_position) == SW_CLOSED) {
-		_homing_axis_move(axis, -hm.latch_backoff, hm.search_velocity);
-	}
-#endif
- 	return (_set_homing_func(_homing_axis_search));			// start the search
+	for (uint8_t axis = 0; axis < HOMING_AXES; axis++) {
+		if (!_in_group(axis)) continue;
+		struct hmHomingAxis *a = &hm.ax[axis];
+		a->pending = false;
+		if (!_homing_axis_switches(axis, SW_OPEN)) {		// homing or squaring switch closed
+			_homing_axis_phase(axis, a->latch_backoff, a->search_velocity, a->homing_switch_position);
+		} else if (a->limit_switch_position != -1 &&
+				   read_switch(axis, a->limit_switch_position) == SW_CLOSED) {
+			_homing_axis_phase(axis, -a->latch_backoff, a->search_velocity, a->limit_switch_position);
+		}
+	}
+	hm.stop_state = SW_OPEN;
+	return (_homing_group_move(_homing_group_search));		// then start the search
 }
 
 static void _homing_end_hold()
@@ -371,77 +437,190 @@ static void _homing_end_hold()
 	if(cm.hold_state == FEEDHOLD_HOLD) {
 		mp_flush_planner();
 		cm_end_hold();
+		for (uint8_t axis = AXIS_X; axis < AXES; axis++) {	// pick up where the hold left us
+			cm_set_position(axis, mp_get_runtime_absolute_position(axis));
+		}
 	}
 }
 
-static stat_t _homing_axis_search(int8_t axis)				// start the search
+static stat_t _homing_group_search(int8_t group)			// start the search
 {
-	_homing_end_hold();
-	cm_set_axis_jerk(axis, cm.a[axis].jerk_homing);			// use the homing jerk for search onward
-	_homing_axis_move(axis, hm.search_travel, hm.search_velocity);
-	return (_set_homing_func(_homing_axis_latch));
+	for (uint8_t axis = 0; axis < HOMING_AXES; axis++) {
+		if (!_in_group(axis)) continue;
+		cm_set_axis_jerk(axis, cm.a[axis].jerk_homing);		// use the homing jerk for search onward
+		_homing_axis_phase(axis, hm.ax[axis].search_travel, hm.ax[axis].search_velocity,
+						   hm.ax[axis].homing_switch_position);
+		_homing_arm_motor_stops(axis, SW_CLOSED);			// each gantry motor stops on its own switch
+	}
+	hm.stop_state = SW_CLOSED;
+	return (_homing_group_move(_homing_group_latch));
 }
 
-static stat_t _homing_axis_latch(int8_t axis)				// latch to switch open
+static stat_t _homing_group_latch(int8_t group)				// latch to switch open
 {
-	_homing_end_hold();
-	_homing_axis_move(axis, hm.latch_backoff, hm.latch_velocity);
-	return (_set_homing_func(_homing_axis_zero_backoff));
+	for (uint8_t axis = 0; axis < HOMING_AXES; axis++) {
+		if (!_in_group(axis)) continue;
+		_homing_axis_phase(axis, hm.ax[axis].latch_backoff, hm.ax[axis].latch_velocity,
+						   hm.ax[axis].homing_switch_position);
+		if (hm.ax[axis].square_motors != 0) {
+			_homing_arm_motor_stops(axis, SW_OPEN);			// each gantry motor stops as its own switch opens
+		} else {
+			sw_arm_capture(axis, hm.ax[axis].homing_switch_position, SW_OPEN);	// latch the position as the switch opens
+		}
+	}
+	hm.stop_state = SW_OPEN;
+	return (_homing_group_move(_homing_group_zero_backoff));
 }
 
-static stat_t _homing_axis_zero_backoff(int8_t axis)		// backoff to zero position
+static stat_t _homing_group_zero_backoff(int8_t group)		// backoff to zero position
 {
-	_homing_end_hold();
-	_homing_axis_move(axis, hm.zero_backoff, hm.search_velocity);
-	return (_set_homing_func(_homing_axis_set_zero));
+	// The latch left every motor of a squared axis on its own switch edge. Setting the
+	// steps to the runtime position squares the gantry; then add the squaring offsets.
+	for (uint8_t axis = 0; axis < HOMING_AXES; axis++) {
+		if (!_in_group(axis) || (hm.ax[axis].square_motors == 0)) continue;
+		hm.ax[axis].latch_position = mp_get_runtime_absolute_position(axis);
+		cm_set_position(axis, hm.ax[axis].latch_position);	// sets the steps of every motor
+	}
+	for (uint8_t axis = 0; axis < HOMING_AXES; axis++) {
+		if (!_in_group(axis)) continue;
+		struct hmHomingAxis *a = &hm.ax[axis];
+		for (uint8_t motor = 0; motor < MOTORS; motor++) {
+			if ((a->axis_motors | a->square_motors) & (1 << motor)) {
+				mp_offset_motor_steps(motor, -st_cfg.mot[motor].homing_offset * kin.motor_steps_per_unit[motor]);
+			}
+		}
+		st_release_motors(a->axis_motors | a->square_motors);
+		_homing_axis_phase(axis, a->zero_backoff, a->search_velocity, -1);
+	}
+	return (_homing_group_move(_homing_group_set_zero));
 }
 
-static stat_t _homing_axis_set_zero(int8_t axis)			// set zero and finish up
+static stat_t _homing_group_set_zero(int8_t group)			// set zero and finish up
 {
-    _homing_end_hold();
-	if (hm.set_coordinates != false) {
-		cm_set_position(axis, 0);
-		cm.homed[axis] = true;
-	} else { // do not set axis if in G28.4 cycle
-		cm_set_position(axis, cm_get_absolute_position(RUNTIME, axis));
-	}
-	cm_set_axis_jerk(axis, hm.saved_jerk);					// restore the max jerk value
-
-#ifdef __NEW_SWITCHES
-	// restore the proper handling of the limit switch
-	switch_t *s = &sw.s[hm.homing_switch_axis][hm.homing_switch_position];
-	_restore_switch_settings(s);
-#endif
-	return (_set_homing_func(_homing_axis_start));
+	float edge[AXES];
+	for (uint8_t axis = 0; axis < AXES; axis++) {
+		edge[axis] = mp_get_runtime_absolute_position(axis);
+	}
+	for (uint8_t axis = 0; axis < HOMING_AXES; axis++) {
+		if (!_in_group(axis)) continue;
+		if (hm.set_coordinates != false) {
+			// Zero is zero_backoff from where the switch opened. With a captured edge that
+			// excludes the distance the latch move took to stop after the switch opened.
+			if (hm.ax[axis].square_motors != 0) {
+				cm_set_position(axis, mp_get_runtime_absolute_position(axis) - hm.ax[axis].latch_position - hm.ax[axis].zero_backoff);
+			} else if (sw_get_capture(axis, hm.ax[axis].homing_switch_position, edge)) {
+				cm_set_position(axis, mp_get_runtime_absolute_position(axis) - edge[axis] - hm.ax[axis].zero_backoff);
+			} else {
+				cm_set_position(axis, 0);
+			}
+			cm.homed[axis] = true;
+		} else { // do not set axis if in G28.4 cycle
+			cm_set_position(axis, cm_get_absolute_position(RUNTIME, axis));
+		}
+		cm_set_axis_jerk(axis, hm.ax[axis].saved_jerk);		// restore the max jerk value
+		_restore_switch_settings(axis);						// restore the proper handling of the limit switch
+	}
+	hm.axes = 0;
+	return (_set_homing_func(_homing_group_start));
 }
 
-static stat_t _homing_axis_move(int8_t axis, float target, float velocity)
+static stat_t _homing_group_continue(int8_t group)
 {
-	float vect[] = {0,0,0,0,0,0};
-	float flags[] = {false, false, false, false, false, false};
+	_homing_end_hold();
+	for (uint8_t axis = 0; axis < HOMING_AXES; axis++) {
+		struct hmHomingAxis *a = &hm.ax[axis];
+		if (!_in_group(axis) || !a->pending) continue;
+
+		// take off what the axis has already travelled, then see if it is done
+		float position = mp_get_runtime_absolute_position(axis);
+		a->travel -= position - a->start;
+		a->start = position;
+		if ((fabs(a->travel) < HOMING_TRAVEL_EPSILON) ||
+			((a->stop_switch_position == a->homing_switch_position) && _homing_axis_switches(axis, hm.stop_state)) ||
+			((a->stop_switch_position != -1) && (a->stop_switch_position == a->limit_switch_position) &&
+			 (read_switch(axis, a->stop_switch_position) == hm.stop_state))) {
+			a->pending = false;
+		}
+	}
+	return (_homing_group_move(hm.next_func));
+}
 
-	vect[axis] = target;
-	flags[axis] = true;
-	cm_set_feed_rate(velocity);
-	ritorno(cm_straight_feed(vect, flags));
-	return (STAT_EAGAIN);
+static void _homing_axis_phase(int8_t axis, float travel, float velocity, int8_t stop_switch_position)
+{
+	struct hmHomingAxis *a = &hm.ax[axis];
+	a->pending = (fabs(travel) >= HOMING_TRAVEL_EPSILON);	// e.g. a zero backoff of 0
+	a->stop_switch_position = stop_switch_position;
+	a->start = mp_get_runtime_absolute_position(axis);
+	a->travel = travel;
+	a->velocity = velocity;
 }
 
 /*
- * _homing_abort() - end homing cycle in progress
+ * _homing_axis_switches()	 - true if the homing switch and any squaring switches of the axis are all in state
+ * _homing_arm_motor_stops() - on a squared axis, stop each motor on the next edge of its switch into state
  */
+
+static bool _homing_axis_switches(int8_t axis, int8_t state)
+{
+	struct hmHomingAxis *a = &hm.ax[axis];
+	if (read_switch(axis, a->homing_switch_position) != state) return (false);
+	for (uint8_t motor = 0; motor < MOTORS; motor++) {
+		if (!(a->square_motors & (1 << motor))) continue;
+		if (read_switch(_square_axis(motor), _square_position(motor)) != state) return (false);
+	}
+	return (true);
+}
+
+static void _homing_arm_motor_stops(int8_t axis, uint8_t state)
+{
+	struct hmHomingAxis *a = &hm.ax[axis];
+	if (a->square_motors == 0) return;
+
+	cm_set_position(axis, mp_get_runtime_absolute_position(axis));	// stopped motors pick up the runtime position
+	st_release_motors(a->axis_motors | a->square_motors);
+	sw_arm_motor_stop(axis, a->homing_switch_position, state, a->axis_motors);
+	for (uint8_t motor = 0; motor < MOTORS; motor++) {
+		if (a->square_motors & (1 << motor)) {
+			sw_arm_motor_stop(_square_axis(motor), _square_position(motor), state, (1 << motor));
+		}
+	}
+}
+
 /*
-static stat_t _homing_abort(int8_t axis)
+ * _homing_group_move() - move all pending axes of the group, each at its own velocity
+ *
+ *	The move lasts as long as the shortest remaining travel takes at its own velocity,
+ *	and every other axis covers velocity * that time. The vector feed rate that gives
+ *	this is the length of the velocity vector. If no axis is pending the next phase runs.
+ */
+
+static stat_t _homing_group_move(stat_t (*next_func)(int8_t group))
 {
-	cm_set_axis_jerk(axis, hm.saved_jerk);					// restore the max jerk value
-#ifdef __NEW_SWITCHES
-	_restore_switch_settings(&sw.s[hm.homing_switch_axis][hm.homing_switch_position]);
-#endif
-	_homing_finalize_exit(axis);
-	sr_request_status_report(SR_REQUEST_TIMED_FULL);
-	return (STAT_HOMING_CYCLE_FAILED);						// homing state remains HOMING_NOT_HOMED
+	float vect[] = {0,0,0,0,0,0};
+	float flags[] = {false, false, false, false, false, false};
+	float time = 0;
+	float feed_rate = 0;
+
+	hm.next_func = next_func;
+	for (uint8_t axis = 0; axis < HOMING_AXES; axis++) {
+		if (!_in_group(axis) || !hm.ax[axis].pending) continue;
+		float axis_time = fabs(hm.ax[axis].travel) / hm.ax[axis].velocity;
+		if ((fp_ZERO(time)) || (axis_time < time)) time = axis_time;
+	}
+	if (fp_ZERO(time)) {									// nothing left to move in this phase
+		return (_set_homing_func(next_func));
+	}
+	for (uint8_t axis = 0; axis < HOMING_AXES; axis++) {
+		if (!_in_group(axis) || !hm.ax[axis].pending) continue;
+		vect[axis] = copysign(hm.ax[axis].velocity * time, hm.ax[axis].travel);
+		flags[axis] = true;
+		feed_rate += square(hm.ax[axis].velocity);
+	}
+	cm_set_feed_rate(sqrt(feed_rate));
+	ritorno(cm_straight_feed(vect, flags));
+	return (_set_homing_func(_homing_group_continue));
 }
-*/
+
 /*
  * _homing_error_exit()
  */
@@ -461,7 +640,7 @@ static stat_t _homing_error_exit(int8_t axis, stat_t status)
 	}
 	nv_print_list(STAT_HOMING_CYCLE_FAILED, TEXT_INLINE_VALUES, JSON_RESPONSE_FORMAT);
 
-	_homing_finalize_exit(axis);
+	_homing_finalize_exit(hm.group);
 	return (STAT_HOMING_CYCLE_FAILED);						// homing state remains HOMING_NOT_HOMED
 }
 
@@ -469,7 +648,7 @@ static stat_t _homing_error_exit(int8_t axis, stat_t status)
  * _homing_finalize_exit() - helper to finalize homing
  */
 
-static stat_t _homing_finalize_exit(int8_t axis)			// third part of return to home
+static stat_t _homing_finalize_exit(int8_t group)			// third part of return to home
 {
 	cm_set_coord_system(hm.saved_coord_system);				// restore to work coordinate system
 	cm_set_units_mode(hm.saved_units_mode);
@@ -477,94 +656,35 @@ static stat_t _homing_finalize_exit(int8_t axis)			// third part of return to ho
 	cm_set_feed_rate_mode(hm.saved_feed_rate_mode);
 	(MODEL)->feed_rate = hm.saved_feed_rate;
 	cm_set_motion_mode(MODEL, MOTION_MODE_CANCEL_MOTION_MODE);
+	st_release_motors(0xFF);								// in case an error ended a gantry search or latch
 	cm_canned_cycle_end();
 	return (STAT_OK);
 }
 
 /*
- * _get_next_axis() - return next axis in sequence based on axis in arg
+ * _get_next_group() - return next homing group based on group in arg
  *
- *	Accepts "axis" arg as the current axis; or -1 to retrieve the first axis
- *	Returns next axis based on "axis" argument and if that axis is flagged for homing in the gf struct
- *	Returns -1 when all axes have been processed
+ *	Accepts "group" arg as the current group; or -1 to retrieve the first group
+ *	Returns the lowest homing group above "group" with an axis flagged for homing in the gf struct
+ *	Returns -1 when all groups have been processed
  *	Returns -2 if no axes are specified (Gcode calling error)
- *	Homes Z first, then the rest in sequence
- *
- *	Isolating this function facilitates implementing more complex and
- *	user-specified axis homing orders
  */
 
-static int8_t _get_next_axis(int8_t axis)
+static int8_t _get_next_group(int8_t group)
 {
-#if (HOMING_AXES <= 4)
-/* alternate code:
-	uint8_t axis;
-	for(axis = AXIS_X; axis < HOMING_AXES; axis++)
-		if(fp_TRUE(cm.gf.target[axis])) break;
-	if(axis >= HOMING_AXES) return -2;
-	  switch(axis) {
-		case -1:        if (fp_TRUE(cm.gf.target[AXIS_Z])) return (AXIS_Z);
-		case AXIS_Z:    if (fp_TRUE(cm.gf.target[AXIS_X])) return (AXIS_X);
-		case AXIS_X:    if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		case AXIS_Y:    if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-#if (HOMING_AXES > 4)
-		case AXIS_A:    if (fp_TRUE(cm.gf.target[AXIS_B])) return (AXIS_B);
-		case AXIS_B:    if (fp_True(cm.gf.target[AXIS_C])) return (AXIS_C);
-#endif
-		default:        return -1;
+	int8_t next_group = -1;
+	bool axis_found = false;
+
+	for (uint8_t axis = 0; axis < HOMING_AXES; axis++) {
+		if (!fp_TRUE(cm.gf.target[axis])) continue;
+		axis_found = true;
+		int8_t axis_group = cm.a[axis].homing_group;
+		if ((axis_group > group) && ((next_group == -1) || (axis_group < next_group))) {
+			next_group = axis_group;
+		}
 	}
-*/
-	if (axis == -1) {	// inelegant brute force solution
-		if (fp_TRUE(cm.gf.target[AXIS_Z])) return (AXIS_Z);
-		if (fp_TRUE(cm.gf.target[AXIS_X])) return (AXIS_X);
-		if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-		return (-2);	// error
-	} else if (axis == AXIS_Z) {
-		if (fp_TRUE(cm.gf.target[AXIS_X])) return (AXIS_X);
-		if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-	} else if (axis == AXIS_X) {
-		if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-	} else if (axis == AXIS_Y) {
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-	}
-	return (-1);	// done
-
-#else
-	if (axis == -1) {
-		if (fp_TRUE(cm.gf.target[AXIS_Z])) return (AXIS_Z);
-		if (fp_TRUE(cm.gf.target[AXIS_X])) return (AXIS_X);
-		if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-		if (fp_TRUE(cm.gf.target[AXIS_B])) return (AXIS_B);
-		if (fp_TRUE(cm.gf.target[AXIS_C])) return (AXIS_C);
-		return (-2);	// error
-	} else if (axis == AXIS_Z) {
-		if (fp_TRUE(cm.gf.target[AXIS_X])) return (AXIS_X);
-		if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-		if (fp_TRUE(cm.gf.target[AXIS_B])) return (AXIS_B);
-		if (fp_TRUE(cm.gf.target[AXIS_C])) return (AXIS_C);
-	} else if (axis == AXIS_X) {
-		if (fp_TRUE(cm.gf.target[AXIS_Y])) return (AXIS_Y);
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-		if (fp_TRUE(cm.gf.target[AXIS_B])) return (AXIS_B);
-		if (fp_TRUE(cm.gf.target[AXIS_C])) return (AXIS_C);
-	} else if (axis == AXIS_Y) {
-		if (fp_TRUE(cm.gf.target[AXIS_A])) return (AXIS_A);
-		if (fp_TRUE(cm.gf.target[AXIS_B])) return (AXIS_B);
-		if (fp_TRUE(cm.gf.target[AXIS_C])) return (AXIS_C);
-	} else if (axis == AXIS_A) {
-		if (fp_TRUE(cm.gf.target[AXIS_B])) return (AXIS_B);
-		if (fp_TRUE(cm.gf.target[AXIS_C])) return (AXIS_C);
-	} else if (axis == AXIS_B) {
-		if (fp_TRUE(cm.gf.target[AXIS_C])) return (AXIS_C);
-	}
-	return (-1);	// done
-
-#endif
+	if ((group == -1) && (axis_found == false)) return (-2);	// error
+	return (next_group);
 }
 
 /*
@@ -42,6 +42,8 @@ struct jmJoggingSingleton {			// persistent jogging runtime variables
 	float velocity_start;			// initial jog feed
 	float velocity_max;
 	uint8_t step;					// what step of the ramp the jogging cycle is currently on
+	uint8_t velocity_mode;			// true if running a velocity jog
+	uint32_t velocity_update_time;	// SysTick time of the last velocity jog update
 
 	uint8_t (*func)(int8_t axis);	// binding for callback function state machine
 
@@ -63,6 +65,8 @@ static stat_t _jogging_axis_start(int8_t axis);
 static stat_t _jogging_axis_ramp_jog(int8_t axis);
 static stat_t _jogging_axis_move(int8_t axis, float target, float velocity);
 static stat_t _jogging_finalize_exit(int8_t axis);
+static stat_t _jogging_velocity_start(int8_t axis);
+static stat_t _jogging_velocity_run(int8_t axis);
 
 /*****************************************************************************
  * cm_jogging_cycle_start()	- jogging cycle using soft limits
@@ -125,7 +129,7 @@ stat_t cm_jogging_cycle_start(uint8_t axis)
 stat_t cm_jogging_cycle_callback(void)
 {
 	if (cm.cycle_state != CYCLE_JOG) { return (STAT_NOOP); } 		// exit if not in a jogging cycle
-	if(jog.func == _jogging_finalize_exit && cm_get_runtime_busy() == true)
+	if((jog.func == _jogging_finalize_exit || jog.func == _jogging_velocity_start) && cm_get_runtime_busy() == true)
 	{ return (STAT_EAGAIN); }	// sync to planner move ends
 	if(jog.func == _jogging_axis_ramp_jog && mp_get_planner_buffers_available() < PLANNER_BUFFER_HEADROOM)
 	{ return (STAT_EAGAIN); }   // prevent flooding the queue with jog moves
@@ -194,6 +198,81 @@ static stat_t _jogging_finalize_exit(int8_t axis)	// finish a jog
 	return (STAT_OK);
 }
 
+/*****************************************************************************
+ * cm_jog_velocity_update()  - start, steer or stop a velocity jog ({"jvx":500} etc.)
+ *	_jogging_velocity_start() - queue the jog once motion has stopped
+ *	_jogging_velocity_run()	  - watch the jog and clean up when it stops
+ *
+ *	A velocity jog follows the vector in cm.jog_velocity[] (mm/min in machine coordinates)
+ *	rather than moving to an endpoint. The runtime reads the vector every segment, so a
+ *	new value takes effect within a few milliseconds - see mp_jog_velocity(). Zeroing the
+ *	vector or a feedhold brings the jog to a jerk limited stop.
+ *
+ *	Clients should resend the vector at a steady rate (~50 Hz) while the jog key or knob is
+ *	held. If no update arrives for JOG_VELOCITY_TIMEOUT_MS the vector is zeroed, so a lost
+ *	connection can't leave the machine running.
+ *
+ *	The jog holds the cycle until it has stopped, which keeps gcode from the data channel
+ *	waiting. Updates should come in on the control channel, which is still serviced.
+ */
+
+static uint8_t _jog_velocity_is_zero()
+{
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		if (fp_NOT_ZERO(cm.jog_velocity[axis])) { return (false);}
+	}
+	return (true);
+}
+
+stat_t cm_jog_velocity_update()
+{
+	jog.velocity_update_time = SysTickTimer_getValue();
+	if ((cm.cycle_state == CYCLE_JOG) && (jog.velocity_mode == true)) {
+		return (STAT_OK);							// the runtime picks up the new vector
+	}
+	if (_jog_velocity_is_zero() == true) { return (STAT_OK);}
+	if ((cm.cycle_state != CYCLE_OFF) || (cm.hold_state != FEEDHOLD_OFF) ||
+		(cm.machine_state == MACHINE_ALARM) || (cm.machine_state == MACHINE_SHUTDOWN)) {
+		clear_vector(cm.jog_velocity);
+		return (STAT_COMMAND_NOT_ACCEPTED);
+	}
+	jog.velocity_mode = true;
+	jog.func = _jogging_velocity_start;
+
+	cm.machine_state = MACHINE_CYCLE;
+	cm.cycle_state = CYCLE_JOG;
+	return (STAT_OK);
+}
+
+static stat_t _jogging_velocity_start(int8_t axis)
+{
+	ritorno(mp_jog_velocity());
+	return (_set_jogging_func(_jogging_velocity_run));
+}
+
+static stat_t _jogging_velocity_run(int8_t axis)
+{
+	if ((SysTickTimer_getValue() - jog.velocity_update_time) > JOG_VELOCITY_TIMEOUT_MS) {
+		clear_vector(cm.jog_velocity);				// watchdog - updates have stopped
+	}
+	if (cm_get_runtime_busy() == true) { return (STAT_EAGAIN);}
+	if (cm.hold_state == FEEDHOLD_HOLD) {
+		ritorno(cm_end_hold());						// the jog was stopped by a feedhold
+	} else if (cm.hold_state != FEEDHOLD_OFF) {
+		return (STAT_EAGAIN);						// wait for the hold to finish
+	}
+	clear_vector(cm.jog_velocity);
+
+	// the jog moved the runtime without the planner - bring the model up to date
+	for (uint8_t i=0; i<AXES; i++) {
+		cm_set_position(i, cm_get_absolute_position(RUNTIME, i));
+	}
+	jog.velocity_mode = false;
+	cm_canned_cycle_end();
+	printf("{\"jog\":0}\n");						// same completion message as the ramp jog
+	return (STAT_OK);
+}
+
 /*
 static stat_t _jogging_error_exit(int8_t axis)
 {
@@ -34,6 +34,7 @@
 #include "report.h"
 #include "switch.h"
 #include "planner.h"
+#include "persistence.h"
 #include "util.h"
 
 /**** Probe singleton structure ****/
@@ -58,6 +59,7 @@ struct pbProbingSingleton {						// persistent probing runtime variables
 #endif
 
 	// state saved from gcode model
+	uint8_t saved_units_mode;					// G20,G21 global setting
 	uint8_t saved_distance_mode;				// G90,G91 global setting
 	uint8_t saved_coord_system;					// G54 - G59 setting
     uint8_t saved_feed_rate_mode;
@@ -71,6 +73,41 @@ struct pbProbingSingleton {						// persistent probing runtime variables
 };
 static struct pbProbingSingleton pb;
 
+/**** Probing grid singleton structure ****/
+
+#define PROBE_GRID_MAX 16						// maximum points along each grid axis
+#define PROBE_GRID_FILENAME "grid.bin"			// height map file in the persistence directory
+
+enum pbGridRequest {							// G29.1/G29.2 requests, run once motion has stopped
+	GRID_REQUEST_NONE = 0,
+	GRID_REQUEST_DISABLE,
+	GRID_REQUEST_ENABLE
+};
+
+typedef struct pbGridMap {						// surface height map - also the image saved to the card
+	uint8_t columns;							// points along X
+	uint8_t rows;								// points along Y
+	float origin[2];							// machine X and Y of the first point
+	float spacing[2];							// X and Y distance between points
+	float z[PROBE_GRID_MAX][PROBE_GRID_MAX];	// [row][column] height relative to the first point
+} pbGridMap_t;
+
+struct pbGridSingleton {
+	pbGridMap_t map;
+	uint8_t valid;								// map holds a complete grid
+	volatile uint8_t enabled;					// the runtime applies the map to Z
+	uint8_t request;							// pending pbGridRequest
+
+	// G29 cycle
+	uint8_t active;								// a grid cycle is running
+	uint16_t point;								// point being probed, in probing order
+	float far_corner[2];						// machine X and Y of the last point
+	float clearance;							// Z for moves between points
+	float depth;								// Z probe target
+	float feed_rate;							// probing feed rate
+};
+static struct pbGridSingleton pg;
+
 /**** NOTE: global prototypes and other .h info is located in canonical_machine.h ****/
 
 static stat_t _probing_init();
@@ -80,6 +117,14 @@ static stat_t _probing_finish();
 static stat_t _probing_finalize_exit();
 static stat_t _probing_error_exit(int8_t axis);
 
+static stat_t _grid_init();
+static stat_t _grid_probe_point();
+static stat_t _grid_record_point();
+static stat_t _grid_lift();
+static stat_t _grid_move();
+static stat_t _grid_finish();
+static stat_t _grid_request();
+
 
 /**** HELPERS ***************************************************************************
  * _set_pb_func() - a convenience for setting the next dispatch vector and exiting
@@ -161,14 +206,19 @@ uint8_t cm_straight_probe(float target[], float flags[])
 
 uint8_t cm_probing_cycle_callback(void)
 {
-	if ((cm.cycle_state != CYCLE_PROBE) && (cm.probe_state != PROBE_WAITING)) {
+	if ((cm.cycle_state != CYCLE_PROBE) && (cm.probe_state != PROBE_WAITING) &&
+		(pg.request == GRID_REQUEST_NONE)) {
 		return (STAT_NOOP);				// exit if not in a probe cycle or waiting for one
 	}
 	if (cm_get_runtime_busy() == true) { return (STAT_EAGAIN);}	// sync to planner move ends
+	if (pg.request != GRID_REQUEST_NONE) {
+		return (_grid_request());								// G29.1/G29.2 - not a probing move
+	}
 	return (pb.func());                                         // execute the current probing move
 }
 
 /*
+ * _probing_setup() - enter the probe cycle and configure the model, axes and probe switch
  * _probing_init()	- G38.2 probing cycle using limit switches
  *
  *	These initializations are required before starting the probing cycle.
@@ -177,14 +227,13 @@ uint8_t cm_probing_cycle_callback(void)
  *	include limit switches initiating probe actions instead of just killing movement
  */
 
-static uint8_t _probing_init()
+static void _probing_setup()
 {
-	// NOTE: it is *not* an error condition for the probe not to trigger.
-	// it is an error for the limit or homing switches to fire, or for some other configuration error.
 	cm.machine_state = MACHINE_CYCLE;
 	cm.cycle_state = CYCLE_PROBE;
 
 	// save relevant non-axis parameters from Gcode model
+	pb.saved_units_mode = cm_get_units_mode(ACTIVE_MODEL);
 	pb.saved_coord_system = cm_get_coord_system(ACTIVE_MODEL);
 	pb.saved_distance_mode = cm_get_distance_mode(ACTIVE_MODEL);
     pb.saved_feed_rate_mode = cm_get_feed_rate_mode(ACTIVE_MODEL);
@@ -200,17 +249,6 @@ static uint8_t _probing_init()
 		pb.saved_jerk[axis] = cm_get_axis_jerk(axis);	// save the max jerk value
 //		cm.a[axis].jerk_max = cm.a[axis].jerk_homing;	// use the homing jerk for probe
 		cm_set_axis_jerk(axis, cm.a[axis].jerk_homing);	// use the homing jerk for probe
-		pb.start_position[axis] = cm_get_absolute_position(ACTIVE_MODEL, axis);
-	}
-
-	// error if the probe target is too close to the current position
-	if (get_axis_vector_length(pb.start_position, pb.target) < MINIMUM_PROBE_TRAVEL)
-		_probing_error_exit(-2);
-
-	// error if the probe target requires a move along the A/B/C axes
-	for ( uint8_t axis=AXIS_A; axis<AXES; axis++ ) {
-		if (fp_NE(pb.start_position[axis], pb.target[axis]))
-			_probing_error_exit(axis);
 	}
 
 	// initialize the probe switch
@@ -234,9 +272,30 @@ static uint8_t _probing_init()
 	pb.switch_saved_on_trailing = sw.s[pb.probe_switch_axis][pb.probe_switch_position].on_trailing;
 	sw.s[pb.probe_switch_axis][pb.probe_switch_position].on_leading = _probe_trigger_feedhold;
 	sw.s[pb.probe_switch_axis][pb.probe_switch_position].on_trailing = _probe_trigger_feedhold;
+	sw_arm_capture(pb.probe_switch_axis, pb.probe_switch_position, SW_CLOSED);	// latch the position on contact
 
 	//switch_reset();													// re-init to pick up new switch settings
 #endif
+}
+
+static uint8_t _probing_init()
+{
+	// NOTE: it is *not* an error condition for the probe not to trigger.
+	// it is an error for the limit or homing switches to fire, or for some other configuration error.
+	_probing_setup();
+	for( uint8_t axis=0; axis<AXES; axis++ ) {
+		pb.start_position[axis] = cm_get_absolute_position(ACTIVE_MODEL, axis);
+	}
+
+	// error if the probe target is too close to the current position
+	if (get_axis_vector_length(pb.start_position, pb.target) < MINIMUM_PROBE_TRAVEL)
+		_probing_error_exit(-2);
+
+	// error if the probe target requires a move along the A/B/C axes
+	for ( uint8_t axis=AXIS_A; axis<AXES; axis++ ) {
+		if (fp_NE(pb.start_position[axis], pb.target[axis]))
+			_probing_error_exit(axis);
+	}
 
 	cm_spindle_control(SPINDLE_OFF);
 	return (_set_pb_func(_probing_start));							// start the move
@@ -299,6 +358,13 @@ static stat_t _probing_finish()
 		// store the probe results
 		cm.probe_results[axis] = position;
 	}
+	// if the probe tripped during the move report where it tripped, not where the feedhold stopped
+	if (cm.probe_state == PROBE_SUCCEEDED) {
+		sw_get_capture(pb.probe_switch_axis, pb.probe_switch_position, cm.probe_results);
+	}
+	if (pg.active) {
+		return (_set_pb_func(_grid_record_point));	// grid points are reported with the map
+	}
 
 	// If probe was successful the 'e' word == 1, otherwise e == 0 to signal an error
 	printf_P(PSTR("{\"prb\":{\"e\":%i"), (int)cm.probe_state);
@@ -337,6 +403,7 @@ static void _probe_restore_settings()
 	sw.s[pb.probe_switch_axis][pb.probe_switch_position].type = pb.saved_switch_type;
 	sw.s[pb.probe_switch_axis][pb.probe_switch_position].on_leading = pb.switch_saved_on_leading;
 	sw.s[pb.probe_switch_axis][pb.probe_switch_position].on_trailing = pb.switch_saved_on_trailing;
+	sw_disarm_capture(pb.probe_switch_axis, pb.probe_switch_position);
 	//switch_reset();								// re-init to pick up changes
 #endif
 
@@ -344,7 +411,9 @@ static void _probe_restore_settings()
 	for( uint8_t axis=0; axis<AXES; axis++ )
 		cm.a[axis].jerk_max = pb.saved_jerk[axis];
 
-	// restore coordinate system and distance mode
+	// restore units, coordinate system and distance mode
+	pg.active = false;
+	cm_set_units_mode(pb.saved_units_mode);
 	cm_set_coord_system(pb.saved_coord_system);
 	cm_set_distance_mode(pb.saved_distance_mode);
     cm_set_feed_rate_mode(pb.saved_feed_rate_mode);
@@ -368,6 +437,8 @@ static stat_t _probing_error_exit(int8_t axis)
 	nv_reset_nv_list();
 	if (axis == -2) {
 		nv_add_conditional_message((const char_t *)"Probing error - invalid probe destination");
+	} else if (axis == -3) {
+		nv_add_conditional_message((const char_t *)"Probing error - grid point did not trigger");
 	} else {
 		char message[NV_MESSAGE_LEN];
 		sprintf_P(message, PSTR("Probing error - %c axis cannot move during probing"), cm_get_axis_char(axis));
@@ -379,3 +450,273 @@ static stat_t _probing_error_exit(int8_t axis)
 	_probe_restore_settings();
 	return (STAT_PROBE_CYCLE_FAILED);
 }
+
+/****************************************************************************************
+ * cm_probe_grid()				- G29 probe a grid and build a surface height map
+ * cm_probe_grid_compensation() - G29.1 disable / G29.2 enable Z compensation from the map
+ * cm_set_grid_compensation()	- enable or disable compensation now (motion must be stopped)
+ * cm_get_grid_offset()			- Z correction at an X,Y position (runtime)
+ *
+ *	G29 X_ Y_ Z_ I_ J_ F_
+ *
+ *	Start with the probe over the first grid point at a safe height. X and Y are the
+ *	machine coordinates of the opposite corner, Z is the probe target depth, I and J are
+ *	the number of points along X and Y, and F is the probing feed rate. The grid is probed
+ *	row by row in alternating directions using the G38.2 machinery, rising to the starting
+ *	height between points. When it is done the machine returns to the first point, the
+ *	map is saved to the card, compensation is enabled and the map is reported.
+ *
+ *	Heights are stored relative to the first point, so the work Z zero should be set there.
+ *	The runtime adds the bilinear interpolation of the map to Z for every segment before
+ *	inverse kinematics; outside the grid the nearest edge is extended. The planner and
+ *	the reported positions stay uncompensated.
+ *
+ *	Turning compensation on or off never moves the machine. The Z position is shifted by
+ *	the local offset instead, so the steps continue to match the tool. Homing turns
+ *	compensation off; G29.2 turns it back on, reloading the map from the card if needed.
+ */
+
+stat_t cm_probe_grid(float target[], float flags[], float counts[], float count_flags[])
+{
+	if (cm.gm.feed_rate_mode == INVERSE_TIME_MODE) {
+		return (STAT_GCODE_INVERSE_TIME_MODE_CANNOT_BE_USED);
+	}
+	if (fp_ZERO(cm.gm.feed_rate)) {
+		return (STAT_GCODE_FEEDRATE_NOT_SPECIFIED);
+	}
+	if (!fp_TRUE(flags[AXIS_X]) || !fp_TRUE(flags[AXIS_Y]) || !fp_TRUE(flags[AXIS_Z])) {
+		return (STAT_GCODE_AXIS_IS_MISSING);
+	}
+	if (!fp_TRUE(count_flags[0]) || !fp_TRUE(count_flags[1]) ||
+		(counts[0] < 2) || (counts[0] > PROBE_GRID_MAX) ||
+		(counts[1] < 2) || (counts[1] > PROBE_GRID_MAX)) {
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	}
+
+	// the cycle runs in millimeters - convert the parameters now
+	float units = (cm_get_units_mode(MODEL) == INCHES) ? MM_PER_INCH : 1;
+	pg.map.columns = (uint8_t)counts[0];
+	pg.map.rows = (uint8_t)counts[1];
+	pg.far_corner[0] = target[AXIS_X] * units;
+	pg.far_corner[1] = target[AXIS_Y] * units;
+	pg.depth = target[AXIS_Z] * units;
+	pg.feed_rate = cm.gm.feed_rate;				// already in mm/min
+
+	clear_vector(cm.probe_results);
+	cm.probe_state = PROBE_WAITING;				// wait until planner queue empties before starting
+	pb.func = _grid_init;
+	return (STAT_OK);
+}
+
+stat_t cm_probe_grid_compensation(uint8_t enable)
+{
+	pg.request = (enable == true) ? GRID_REQUEST_ENABLE : GRID_REQUEST_DISABLE;
+	return (STAT_OK);
+}
+
+/*
+ * _grid_offset() - bilinear interpolation of the map at position[]
+ */
+
+static float _grid_offset(const float position[])
+{
+	pbGridMap_t *m = &pg.map;
+
+	// position in grid units, clamped to the grid
+	float u = (position[AXIS_X] - m->origin[0]) / m->spacing[0];
+	float v = (position[AXIS_Y] - m->origin[1]) / m->spacing[1];
+	if (u < 0) { u = 0; } else if (u > m->columns-1) { u = m->columns-1; }
+	if (v < 0) { v = 0; } else if (v > m->rows-1) { v = m->rows-1; }
+
+	// cell containing the position - the last row and column belong to the cell before
+	uint8_t c = (uint8_t)u;
+	uint8_t r = (uint8_t)v;
+	if (c > m->columns-2) { c = m->columns-2; }
+	if (r > m->rows-2) { r = m->rows-2; }
+	u -= c;
+	v -= r;
+
+	float z0 = m->z[r][c] + (m->z[r][c+1] - m->z[r][c]) * u;
+	float z1 = m->z[r+1][c] + (m->z[r+1][c+1] - m->z[r+1][c]) * u;
+	return (z0 + (z1 - z0) * v);
+}
+
+float cm_get_grid_offset(const float position[])
+{
+	if (pg.enabled == false) { return (0);}
+	return (_grid_offset(position));
+}
+
+void cm_set_grid_compensation(uint8_t enable)
+{
+	if (pg.valid == false) { enable = false;}
+	if (enable == pg.enabled) { return;}
+
+	float position[AXES];
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		position[axis] = cm_get_absolute_position(RUNTIME, axis);
+	}
+	float offset = _grid_offset(position);
+	pg.enabled = enable;
+	cm_set_position(AXIS_Z, (enable == true) ? (position[AXIS_Z] - offset) : (position[AXIS_Z] + offset));
+}
+
+/*
+ * _grid_point_position() - machine X and Y of a point, by index in probing order
+ */
+
+static void _grid_point_position(uint16_t point, float target[])
+{
+	uint8_t row = point / pg.map.columns;
+	uint8_t column = point % pg.map.columns;
+	if (row & 0x01) {								// odd rows run backwards
+		column = pg.map.columns - 1 - column;
+	}
+	target[AXIS_X] = pg.map.origin[0] + column * pg.map.spacing[0];
+	target[AXIS_Y] = pg.map.origin[1] + row * pg.map.spacing[1];
+}
+
+/*
+ * _grid_init()			- set up the cycle; the first point is the current position
+ * _grid_probe_point()	- probe down from the current position (via _probing_start)
+ * _grid_record_point()	- store the result, or fail the cycle if the probe didn't trigger
+ * _grid_lift()			- rise to the starting height
+ * _grid_move()			- traverse to the next point, or back to the first when done
+ * _grid_finish()		- save, enable and report the map
+ */
+
+static stat_t _grid_init()
+{
+	cm_set_grid_compensation(false);				// probe the raw surface
+	pg.valid = false;
+	_probing_setup();
+	cm_set_units_mode(MILLIMETERS);
+	cm_spindle_control(SPINDLE_OFF);
+
+	pg.map.origin[0] = cm_get_absolute_position(ACTIVE_MODEL, AXIS_X);
+	pg.map.origin[1] = cm_get_absolute_position(ACTIVE_MODEL, AXIS_Y);
+	pg.map.spacing[0] = (pg.far_corner[0] - pg.map.origin[0]) / (pg.map.columns - 1);
+	pg.map.spacing[1] = (pg.far_corner[1] - pg.map.origin[1]) / (pg.map.rows - 1);
+	pg.clearance = cm_get_absolute_position(ACTIVE_MODEL, AXIS_Z);
+
+	if ((fabs(pg.map.spacing[0]) < MINIMUM_PROBE_TRAVEL) ||
+		(fabs(pg.map.spacing[1]) < MINIMUM_PROBE_TRAVEL) ||
+		(fabs(pg.clearance - pg.depth) < MINIMUM_PROBE_TRAVEL)) {
+		return (_probing_error_exit(-2));
+	}
+	pg.point = 0;
+	pg.active = true;
+	return (_grid_probe_point());
+}
+
+static stat_t _grid_probe_point()
+{
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		pb.start_position[axis] = cm_get_absolute_position(ACTIVE_MODEL, axis);
+	}
+	copy_vector(pb.target, pb.start_position);
+	pb.target[AXIS_Z] = pg.depth;
+	clear_vector(pb.flags);
+	pb.flags[AXIS_Z] = 1;
+
+	cm_set_feed_rate_mode(UNITS_PER_MINUTE_MODE);
+	(MODEL)->feed_rate = pg.feed_rate;				// the last backoff left the latch velocity set
+	cm.probe_state = PROBE_WAITING;
+	sw_arm_capture(pb.probe_switch_axis, pb.probe_switch_position, SW_CLOSED);
+	return (_probing_start());
+}
+
+static stat_t _grid_record_point()
+{
+	if (cm.probe_state != PROBE_SUCCEEDED) {
+		return (_probing_error_exit(-3));
+	}
+	uint8_t row = pg.point / pg.map.columns;
+	uint8_t column = pg.point % pg.map.columns;
+	if (row & 0x01) {
+		column = pg.map.columns - 1 - column;
+	}
+	pg.map.z[row][column] = cm.probe_results[AXIS_Z];
+	pg.point++;
+	return (_grid_lift());
+}
+
+static stat_t _grid_lift()
+{
+	float target[AXES] = {0};
+	float flags[AXES] = {0};
+	target[AXIS_Z] = pg.clearance;
+	flags[AXIS_Z] = 1;
+	cm_straight_traverse(target, flags);
+	return (_set_pb_func(_grid_move));
+}
+
+static stat_t _grid_move()
+{
+	float target[AXES] = {0};
+	float flags[AXES] = {0};
+	flags[AXIS_X] = 1;
+	flags[AXIS_Y] = 1;
+
+	if (pg.point < (pg.map.columns * pg.map.rows)) {
+		_grid_point_position(pg.point, target);
+		cm_straight_traverse(target, flags);
+		return (_set_pb_func(_grid_probe_point));
+	}
+	_grid_point_position(0, target);				// the map is zero here, so enabling it won't shift Z
+	cm_straight_traverse(target, flags);
+	return (_set_pb_func(_grid_finish));
+}
+
+static stat_t _grid_finish()
+{
+	float z0 = pg.map.z[0][0];
+	for (uint8_t row=0; row<pg.map.rows; row++) {
+		for (uint8_t column=0; column<pg.map.columns; column++) {
+			pg.map.z[row][column] -= z0;
+		}
+	}
+	pg.valid = true;
+	stat_t status = write_persistent_blob(PROBE_GRID_FILENAME, &pg.map, sizeof(pg.map));
+	cm_set_grid_compensation(true);
+
+	// report the map - one array of heights per row, in increasing X
+	printf_P(PSTR("{\"prbg\":{\"e\":1,\"sd\":%i"), (int)(status == STAT_OK));
+	printf_P(PSTR(",\"x\":%0.3f,\"y\":%0.3f"), pg.map.origin[0], pg.map.origin[1]);
+	printf_P(PSTR(",\"i\":%0.3f,\"j\":%0.3f,\"z\":["), pg.map.spacing[0], pg.map.spacing[1]);
+	for (uint8_t row=0; row<pg.map.rows; row++) {
+		printf_P(PSTR("%s["), (row == 0) ? "" : ",");
+		for (uint8_t column=0; column<pg.map.columns; column++) {
+			printf_P(PSTR("%s%0.3f"), (column == 0) ? "" : ",", pg.map.z[row][column]);
+		}
+		printf_P(PSTR("]"));
+	}
+	printf_P(PSTR("]}}\n"));
+
+	return (_set_pb_func(_probing_finalize_exit));
+}
+
+/*
+ * _grid_request() - run a G29.1 or G29.2 once motion has stopped
+ */
+
+static stat_t _grid_request()
+{
+	uint8_t request = pg.request;
+	pg.request = GRID_REQUEST_NONE;
+
+	if (request == GRID_REQUEST_ENABLE && pg.valid == false) {
+		if ((read_persistent_blob(PROBE_GRID_FILENAME, &pg.map, sizeof(pg.map)) != STAT_OK) ||
+			(pg.map.columns < 2) || (pg.map.columns > PROBE_GRID_MAX) ||
+			(pg.map.rows < 2) || (pg.map.rows > PROBE_GRID_MAX) ||
+			fp_ZERO(pg.map.spacing[0]) || fp_ZERO(pg.map.spacing[1])) {
+			nv_reset_nv_list();
+			nv_add_conditional_message((const char_t *)"Probing error - no surface map");
+			nv_print_list(STAT_PROBE_CYCLE_FAILED, TEXT_INLINE_VALUES, JSON_RESPONSE_FORMAT);
+			return (STAT_PROBE_CYCLE_FAILED);
+		}
+		pg.valid = true;
+	}
+	cm_set_grid_compensation(request == GRID_REQUEST_ENABLE);
+	return (STAT_OK);
+}
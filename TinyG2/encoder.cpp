@@ -71,11 +71,18 @@ stat_t encoder_test_assertions()
  *	Sets the encoder_position steps. Takes floating point steps as input,
  *	writes integer steps. So it's not an exact representation of machine
  *	position except if the machine is at zero.
+ *
+ *	Only called when the steppers are idle. Steps counted in the last segment have not
+ *	been accumulated yet, so they are dropped here rather than added on the next load.
+ *	Backlash take-up run so far is dropped with them - the new position already includes it.
  */
 
 void en_set_encoder_steps(uint8_t motor, float steps)
 {
 	en.en[motor].encoder_steps = (int32_t)round(steps);
+	en.en[motor].steps_run = 0;
+	en.en[motor].backlash_steps = 0;
+	en.en[motor].backlash_run = 0;
 }
 
 /*
@@ -86,11 +93,37 @@ void en_set_encoder_steps(uint8_t motor, float steps)
  *	therefore always stable. But be advised: the position lags target and position
  *	valaues elsewherein the system becuase the sample is taken when the steps for
  *	that segment are complete.
+ *
+ *	Steps injected by backlash compensation (see st_prep_line()) only take up lost motion,
+ *	so they are taken back out. The result compares directly with the commanded steps.
  */
 
 float en_read_encoder(uint8_t motor)
 {
-	return((float)en.en[motor].encoder_steps);
+	return((float)en.en[motor].encoder_steps - en.en[motor].backlash_steps);
+}
+
+/*
+ * en_capture_steps() - snapshot the step position of every motor, including steps counted
+ *						in the segment that is running now
+ *
+ *	Callable from interrupts. The load accumulates steps_run into encoder_steps from a
+ *	higher priority interrupt, so interrupts are held off while the pair is read.
+ *	Backlash take-up is removed as in en_read_encoder(), except for any in the running
+ *	segment - at most one segment's worth of take-up.
+ */
+
+void en_capture_steps(int32_t steps[])
+{
+#ifdef __ARM
+	__disable_irq();
+#endif
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		steps[motor] = en.en[motor].encoder_steps + en.en[motor].steps_run - (int32_t)round(en.en[motor].backlash_steps);
+	}
+#ifdef __ARM
+	__enable_irq();
+#endif
 }
 
 /***********************************************************************************
@@ -96,6 +96,7 @@
 #define SET_ENCODER_STEP_SIGN(m,s)	en.en[m].step_sign = s;
 #define INCREMENT_ENCODER(m)		en.en[m].steps_run += en.en[m].step_sign;
 #define ACCUMULATE_ENCODER(m)		en.en[m].encoder_steps += en.en[m].steps_run; en.en[m].steps_run = 0;
+#define ACCUMULATE_BACKLASH(m,s)	en.en[m].backlash_steps += en.en[m].backlash_run; en.en[m].backlash_run = s;
 
 /**** Structures ****/
 
@@ -103,6 +104,8 @@ typedef struct enEncoder { 			// one real or virtual encoder per controlled moto
 	int8_t  step_sign;				// set to +1 or -1
 	int16_t steps_run;				// steps counted during stepper interrupt
 	int32_t encoder_steps;			// counted encoder position	in steps
+	float backlash_steps;			// backlash take-up steps in encoder_steps - not part of the position
+	float backlash_run;				// backlash take-up steps in the segment being run
 } enEncoder_t;
 
 typedef struct enEncoders {
@@ -122,5 +125,6 @@ stat_t encoder_test_assertions(void);
 
 void en_set_encoder_steps(uint8_t motor, float steps);
 float en_read_encoder(uint8_t motor);
+void en_capture_steps(int32_t steps[]);
 
 #endif	// End of include guard: ENCODER_H_ONCE
@@ -68,6 +68,45 @@ static
 BYTE CardType;			/* b0:MMC, b1:SDv1, b2:SDv2, b3:Block addressing */
 
 
+/*-----------------------------------------------------------------------*/
+/* Receive a byte from MMC                                               */
+/*-----------------------------------------------------------------------*/
+/* spi->read() only starts a transfer and returns -1 until the byte has  */
+/* been clocked in, so a single call doesn't guarantee a byte was moved. */
+/* Multi-block transfers need every byte accounted for, or CRC bytes get */
+/* mistaken for the next data token.                                     */
+
+static
+uint8_t rcvr_spi (
+                  bool lastXfer = false	/* Release CS after this byte */
+)
+{
+    int16_t d;
+    while ((d = spi->read(lastXfer, 0xFF)) < 0) {};
+    return (uint8_t)d;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Wait for card ready                                                   */
+/*-----------------------------------------------------------------------*/
+
+static
+int wait_ready (	/* 1:Ready, 0:Timeout */
+                uint32_t wt			/* Timeout [ms] */
+)
+{
+    uint8_t d;
+    uint32_t start = Motate::SysTickTimer.getValue();
+    do {
+        d = rcvr_spi();
+    } while ((d != 0xFF) && Motate::SysTickTimer.getValue() - start < wt);
+    return (d == 0xFF);
+}
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Receive a data packet from MMC                                        */
 /*-----------------------------------------------------------------------*/
@@ -75,23 +114,24 @@ BYTE CardType;			/* b0:MMC, b1:SDv1, b2:SDv2, b3:Block addressing */
 static
 int rcvr_datablock (	/* 1:OK, 0:Failed */
                     BYTE *buff,			/* Data buffer to store received data */
-                    UINT btr			/* Byte count (must be even number) */
+                    UINT btr,			/* Byte count (must be even number) */
+                    bool last = true	/* Release CS at the end (false between blocks of a CMD18) */
 )
 {
 	volatile INT token;
     
     uint32_t start = Motate::SysTickTimer.getValue();
 	do {							/* Wait for data packet in timeout of 100ms */
-		token = spi->read(true, 0xFF);
+		token = spi->read(last, 0xFF);
 	} while ((token != 0xFE) && Motate::SysTickTimer.getValue()-start < 100);
 	if(token != 0xFE) {
         return 0;		/* If not valid data token, retutn with error */
     }
     
-    spi->read((uint8_t*)buff, btr);
+    spi->read((uint8_t*)buff, btr, last);
     
-	spi->read(false, 0xFF);					/* Discard CRC */
-	spi->read(false, 0xFF);
+	rcvr_spi();						/* Discard CRC */
+	rcvr_spi(last);
     
 	return 1;						/* Return with success */
 }
@@ -111,14 +151,20 @@ int xmit_datablock (	/* 1:OK, 0:Failed */
 {
 	BYTE resp;
     
+    if (!wait_ready(500)) return 0;		/* Card is busy with the previous block of a CMD25 */
+
     bool stop = (token == 0xFD);
 	spi->write(token, stop);					/* Xmit data token */
+	if (stop) {
+		rcvr_spi();							/* Drop the byte clocked in with the token, */
+		rcvr_spi();							/* and skip Nbr so the caller sees the busy */
+	}
 	if (token != 0xFD) {	/* Is data token */
         spi->write(buff, 512);
 		spi->write(0xFF);					/* CRC (Dummy) */
 		spi->write(0xFF, true);
         do {
-            resp = spi->read() & 0x1F;				/* Reveive data response */
+            resp = spi->read(false, 0xFF) & 0x1F;	/* Reveive data response */
         } while (resp == 0 || resp == 0x1F);
 		if (resp != 0x05)		/* If not accepted, return with error */
 			return 0;
@@ -150,9 +196,12 @@ uint8_t send_cmd (		/* Returns command response (bit7==1:Send failed)*/
 		if (res > 1) return res;
 	}
     
-    // wait until card is ready to receive command
-    uint32_t start = Motate::SysTickTimer.getValue();
-    while ((spi->read(true, 0xFF) != 0xFF) && Motate::SysTickTimer.getValue() - start < 1000) {};
+    // wait until card is ready to receive command - except to stop a multiple block read,
+    // where the card is still streaming data and will never show ready until it's stopped
+    if (cmd != CMD12) {
+        uint32_t start = Motate::SysTickTimer.getValue();
+        while ((spi->read(true, 0xFF) != 0xFF) && Motate::SysTickTimer.getValue() - start < 1000) {};
+    }
 
     // choose the command CRC
 	uint8_t n = 0x01;							/* Dummy CRC + Stop */
@@ -288,15 +337,24 @@ DRESULT disk_read (
     
 	if (!(CardType & CT_BLOCK)) sector *= 512;	/* Convert to byte address if needed */
     
-    BYTE cmd;
-	cmd = count > 1 ? CMD18 : CMD17;			/*  READ_MULTIPLE_BLOCK : READ_SINGLE_BLOCK */
-    
-	if (send_cmd_until_specific_response(cmd, sector, 0)) {
-		do {
-			if (!rcvr_datablock(buff, 512)) break;
-			buff += 512;
-		} while (--count);
-		if (cmd == CMD18) send_cmd(CMD12, 0);	/* STOP_TRANSMISSION */
+	if (count == 1) {	/* Single block read */
+		if (send_cmd_until_specific_response(CMD17, sector, 0)		/* READ_SINGLE_BLOCK */
+			&& rcvr_datablock(buff, 512))
+			count = 0;
+	}
+	else {				/* Multiple block read */
+		// Not retried: re-issuing CMD18 while the card is streaming only makes things worse.
+		// CS is held across blocks, and the CRC bytes are clocked out so they can't be taken
+		// for the next data token. CMD12 is sent without waiting for ready (see send_cmd),
+		// then we wait out the R1b busy before anyone else talks to the card.
+		if (send_cmd(CMD18, sector) == 0) {	/* READ_MULTIPLE_BLOCK */
+			do {
+				if (!rcvr_datablock(buff, 512, count == 1)) break;
+				buff += 512;
+			} while (--count);
+			send_cmd(CMD12, 0);				/* STOP_TRANSMISSION */
+			wait_ready(500);
+		}
 	}
     
 	return count ? RES_ERROR : RES_OK;
@@ -337,6 +395,8 @@ DRESULT disk_write (
 			} while (--count);
 			if (!xmit_datablock(0, 0xFD))	/* STOP_TRAN token */
 				count = 1;
+			if (!wait_ready(500))			/* Wait out programming of the last block */
+				count = 1;
 		}
 	}
     
@@ -299,6 +299,14 @@ static stat_t _parse_gcode_block(char_t *buf)
 				case 2:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CW_ARC);
 				case 3:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CCW_ARC);
 				case 4:  SET_NON_MODAL (next_action, NEXT_ACTION_DWELL);
+				case 5: {
+					switch (_point(value)) {
+						case 0: SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CUBIC_SPLINE);
+						case 1: SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_QUADRATIC_SPLINE);
+						default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+					}
+					break;
+				}
 				case 10: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_COORD_DATA);
 				case 17: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_XY);
 				case 18: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_XZ);
@@ -316,6 +324,15 @@ static stat_t _parse_gcode_block(char_t *buf)
 					}
 					break;
 				}
+				case 29: {
+					switch (_point(value)) {
+						case 0: SET_NON_MODAL (next_action, NEXT_ACTION_PROBE_GRID);
+						case 1: SET_NON_MODAL (next_action, NEXT_ACTION_DISABLE_GRID);
+						case 2: SET_NON_MODAL (next_action, NEXT_ACTION_ENABLE_GRID);
+						default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+					}
+					break;
+				}
 				case 30: {
 					switch (_point(value)) {
 						case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_GOTO_G30_POSITION);
@@ -349,7 +366,11 @@ static stat_t _parse_gcode_block(char_t *buf)
 					break;
 				}
 				case 64: SET_MODAL (MODAL_GROUP_G13,path_control, PATH_CONTINUOUS);
+				case 73: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_73);
 				case 80: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANCEL_MOTION_MODE);
+				case 81: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_81);
+				case 82: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_82);
+				case 83: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_83);
 				case 90: {
 					switch (_point(value)) {
     					case 0: SET_MODAL (MODAL_GROUP_G3, distance_mode, ABSOLUTE_MODE);
@@ -379,6 +400,8 @@ static stat_t _parse_gcode_block(char_t *buf)
 				case 93: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, INVERSE_TIME_MODE);
 				case 94: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, UNITS_PER_MINUTE_MODE);
 //				case 95: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, UNITS_PER_REVOLUTION_MODE);
+				case 98: SET_MODAL (MODAL_GROUP_G9, retract_mode, RETRACT_TO_INITIAL_LEVEL);
+				case 99: SET_MODAL (MODAL_GROUP_G9, retract_mode, RETRACT_TO_R_PLANE);
 				default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
 			}
 			break;
@@ -421,6 +444,7 @@ static stat_t _parse_gcode_block(char_t *buf)
 			case 'J': SET_NON_MODAL (arc_offset[1], value);
 			case 'K': SET_NON_MODAL (arc_offset[2], value);
 			case 'L': SET_NON_MODAL (l_word, value);
+			case 'Q': SET_NON_MODAL (q_word, value);
 			case 'R': SET_NON_MODAL (arc_radius, value);
 			case 'N': SET_NON_MODAL (linenum,(uint32_t)value);		// line number
 			default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
@@ -503,7 +527,7 @@ static stat_t _execute_gcode_block()
 	EXEC_FUNC(cm_set_path_control, path_control);
 	EXEC_FUNC(cm_set_distance_mode, distance_mode);
 	EXEC_FUNC(cm_set_arc_distance_mode, arc_distance_mode); // G90.1, G91.1
-	//--> set retract mode goes here
+	EXEC_FUNC(cm_set_retract_mode, retract_mode);			// G98, G99
 
 	switch (cm.gn.next_action) {
 		case NEXT_ACTION_SET_G28_POSITION:  { status = cm_set_g28_position(); break;}								// G28.1
@@ -516,6 +540,9 @@ static stat_t _execute_gcode_block()
 		case NEXT_ACTION_HOMING_NO_SET: { status = cm_homing_cycle_start_no_set(); break;}							// G28.4
 
 		case NEXT_ACTION_STRAIGHT_PROBE: { status = cm_straight_probe(cm.gn.target, cm.gf.target); break;}			// G38.2
+		case NEXT_ACTION_PROBE_GRID: { status = cm_probe_grid(cm.gn.target, cm.gf.target, cm.gn.arc_offset, cm.gf.arc_offset); break;}	// G29
+		case NEXT_ACTION_DISABLE_GRID: { status = cm_probe_grid_compensation(false); break;}						// G29.1
+		case NEXT_ACTION_ENABLE_GRID: { status = cm_probe_grid_compensation(true); break;}							// G29.2
 
 		case NEXT_ACTION_SET_COORD_DATA: { status = cm_set_coord_offsets(cm.gn.parameter, cm.gn.l_word, cm.gn.target, cm.gf.target); break;}
 		case NEXT_ACTION_SET_ORIGIN_OFFSETS: { status = cm_set_origin_offsets(cm.gn.target, cm.gf.target); break;}
@@ -525,9 +552,13 @@ static stat_t _execute_gcode_block()
 
 		case NEXT_ACTION_DEFAULT:
         {
-            //set the motion mode, if applicable
-            if(cm.gf.motion_mode)
+            //set the motion mode, if applicable. Leaving the canned cycles drops their sticky words
+            if(cm.gf.motion_mode) {
+                if((cm.gn.motion_mode != MOTION_MODE_CANNED_CYCLE_73) && (cm.gn.motion_mode != MOTION_MODE_CANNED_CYCLE_81) &&
+                   (cm.gn.motion_mode != MOTION_MODE_CANNED_CYCLE_82) && (cm.gn.motion_mode != MOTION_MODE_CANNED_CYCLE_83))
+                    cm_clear_drilling_words();
                 cm.gm.motion_mode = cm.gn.motion_mode;
+            }
 
             bool lineCoords = false;
             for(int8_t i = 0; i < AXES; ++i)
@@ -550,6 +581,27 @@ static stat_t _execute_gcode_block()
                                                                  cm.gn.motion_mode);
                     break;
                 }
+                case MOTION_MODE_CUBIC_SPLINE:                                                                      // G5
+                case MOTION_MODE_QUADRATIC_SPLINE: {                                                                // G5.1
+                    if(lineCoords) { status = cm_spline_feed(cm.gn.target,     cm.gf.target,
+                                                             cm.gn.arc_offset, cm.gf.arc_offset,
+                                                             cm.gn.parameter,  cm.gf.parameter,
+                                                             cm.gn.q_word,     cm.gf.q_word,
+                                                             cm.gn.motion_mode); }
+                    break;
+                }
+                case MOTION_MODE_CANNED_CYCLE_73:                                                                   // G73
+                case MOTION_MODE_CANNED_CYCLE_81:                                                                   // G81
+                case MOTION_MODE_CANNED_CYCLE_82:                                                                   // G82
+                case MOTION_MODE_CANNED_CYCLE_83: {                                                                 // G83
+                    if(lineCoords) { status = cm_drilling_cycle_start(cm.gn.target,     cm.gf.target,
+                                                                      cm.gn.arc_radius, cm.gf.arc_radius,
+                                                                      cm.gn.parameter,  cm.gf.parameter,
+                                                                      cm.gn.q_word,     cm.gf.q_word,
+                                                                      cm.gn.l_word,     cm.gf.l_word,
+                                                                      cm.gn.motion_mode); }
+                    break;
+                }
                 default: break;
             }
             cm_set_absolute_override(MODEL, false);	 // un-set absolute override once the move is planned
@@ -262,10 +262,14 @@ static stat_t _get_nv_pair_relaxed(nvObj_t *nv, char_t **pstr, int8_t *depth)
 		*tmp = NUL;
 
 		// if string begins with 0x it might be data, needs to be at least 3 chars long
+		// and all hex digits (so base64 payloads that happen to start with 0x stay strings)
+		char_t *end = NULL;
+		uint32_t data = 0;
 		if( strlen(*pstr)>=3 && (*pstr)[0]=='0' && (*pstr)[1]=='x')
-		{
+			data = strtoul((const char *)*pstr, (char **)&end, 0);
+		if ((end != NULL) && (*end == NUL)) {
 			uint32_t *v = (uint32_t*)&nv->value;
-			*v = strtoul((const char *)*pstr, 0L, 0);
+			*v = data;
 			nv->valuetype = TYPE_DATA;
 		} else {
 			ritorno(nv_copy_string(nv, *pstr));
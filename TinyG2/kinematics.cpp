@@ -28,15 +28,28 @@
 #include "tinyg2.h"
 #include "config.h"
 #include "canonical_machine.h"
+#include "planner.h"
 #include "stepper.h"
 #include "kinematics.h"
+#include "text_parser.h"
+#include "util.h"
 
 static void _inverse_kinematics(const float travel[], float joint[]);
+static void _forward_kinematics(const float joint[], float travel[]);
+static void _corexy_inverse(const float travel[], float joint[]);
+static void _corexy_forward(const float joint[], float travel[]);
+static void _delta_inverse(const float travel[], float joint[]);
+static void _delta_forward(const float joint[], float travel[]);
+
+// Cartesian until $kin is loaded, so a rejected or missing $kin never leaves a NULL transform
+kinSingleton_t kin = { KINEMATICS_CARTESIAN, 0, 0, 0, {{0}}, _inverse_kinematics, _forward_kinematics };
 
 /*
  * ik_kinematics() - wrapper routine for inverse kinematics
  *
- *	Calls kinematics function(s).
+ *	Calls the kinematics selected by $kin to turn axis positions into joint positions.
+ *	Joints are indexed like the axes they replace, so a motor mapped to the X axis runs
+ *	the X joint (the A belt on a CoreXY, the A tower on a delta).
  *	Performs axis mapping & conversion of length units to steps (and deals with inhibited axes)
  *
  *	The reason steps are returned as floats (as opposed to, say, uint32_t) is to accommodate
@@ -49,34 +62,158 @@ void ik_kinematics(const float travel[], float steps[])
 {
 	float joint[AXES];
 
-	_inverse_kinematics(travel, joint);				// insert inverse kinematics transformations here
-
-	// Map motors to axes and convert length units to steps
-	// Most of the conversion math has already been done in during config in steps_per_unit()
-	// which takes axis travel, step angle and microsteps into account.
-	for (uint8_t axis=0; axis<AXES; axis++) {
-		if (cm.a[axis].axis_mode == AXIS_INHIBITED) { joint[axis] = 0;}
-		if (st_cfg.mot[MOTOR_1].motor_map == axis) { steps[MOTOR_1] = joint[axis] * st_cfg.mot[MOTOR_1].steps_per_unit;}
-		if (st_cfg.mot[MOTOR_2].motor_map == axis) { steps[MOTOR_2] = joint[axis] * st_cfg.mot[MOTOR_2].steps_per_unit;}
-		if (st_cfg.mot[MOTOR_3].motor_map == axis) { steps[MOTOR_3] = joint[axis] * st_cfg.mot[MOTOR_3].steps_per_unit;}
-		if (st_cfg.mot[MOTOR_4].motor_map == axis) { steps[MOTOR_4] = joint[axis] * st_cfg.mot[MOTOR_4].steps_per_unit;}
+	kin.inverse(travel, joint);						// Cartesian, CoreXY or delta - see _set_kinematics()
+
+	// Map motors to joints and convert length units to steps using the table built by
+	// ik_map_motors(), which takes motor map, axis mode, travel, step angle and microsteps
+	// into account. Two motors on one axis (a gantry) each have their own entry.
+	steps[MOTOR_1] = joint[kin.motor_joint[MOTOR_1]] * kin.motor_steps_per_unit[MOTOR_1];
+	steps[MOTOR_2] = joint[kin.motor_joint[MOTOR_2]] * kin.motor_steps_per_unit[MOTOR_2];
+	steps[MOTOR_3] = joint[kin.motor_joint[MOTOR_3]] * kin.motor_steps_per_unit[MOTOR_3];
+	steps[MOTOR_4] = joint[kin.motor_joint[MOTOR_4]] * kin.motor_steps_per_unit[MOTOR_4];
 #if (MOTORS >= 5)
-		if (st_cfg.mot[MOTOR_5].motor_map == axis) { steps[MOTOR_5] = joint[axis] * st_cfg.mot[MOTOR_5].steps_per_unit;}
+	steps[MOTOR_5] = joint[kin.motor_joint[MOTOR_5]] * kin.motor_steps_per_unit[MOTOR_5];
 #endif
 #if (MOTORS >= 6)
-		if (st_cfg.mot[MOTOR_6].motor_map == axis) { steps[MOTOR_6] = joint[axis] * st_cfg.mot[MOTOR_6].steps_per_unit;}
+	steps[MOTOR_6] = joint[kin.motor_joint[MOTOR_6]] * kin.motor_steps_per_unit[MOTOR_6];
 #endif
-	}
 
 /* The above is a loop unrolled version of this:
-	for (uint8_t axis=0; axis<AXES; axis++) {
-		for (uint8_t motor=0; motor<MOTORS; motor++) {
-			if (st_cfg.mot[motor].motor_map == axis) {
-				steps[motor] = joint[axis] * st_cfg.mot[motor].steps_per_unit;
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		steps[motor] = joint[kin.motor_joint[motor]] * kin.motor_steps_per_unit[motor];
+	}
+*/
+}
+
+/*
+ * ik_map_motors() - rebuild the motor map used by ik_kinematics() and fk_kinematics()
+ *
+ *	Call whenever a motor map, axis mode or steps per unit changes. Motors that are not
+ *	mapped to an axis, or whose axis is inhibited, get zero steps per unit so they always
+ *	sit at step zero.
+ */
+
+void ik_map_motors()
+{
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		uint8_t axis = st_cfg.mot[motor].motor_map;
+		if ((axis >= AXES) || (cm.a[axis].axis_mode == AXIS_INHIBITED)) {
+			kin.motor_joint[motor] = 0;
+			kin.motor_steps_per_unit[motor] = 0;
+		} else {
+			kin.motor_joint[motor] = axis;
+			kin.motor_steps_per_unit[motor] = st_cfg.mot[motor].steps_per_unit;
+		}
+	}
+}
+
+/*
+ * fk_kinematics() - wrapper routine for forward kinematics
+ *
+ *	Converts motor steps back to axis positions - the inverse of ik_kinematics(). The first
+ *	motor mapped to a joint gives its position. Joints with no motor, or that are inhibited,
+ *	take the value the caller prefilled in travel[], so on a Cartesian machine those axes
+ *	are left untouched. Not for use in time critical code - it's meant for the odd position
+ *	snapshot. The delta solution costs several square roots.
+ */
+
+void fk_kinematics(const float steps[], float travel[])
+{
+	float joint[AXES];
+	uint8_t done[AXES] = {false};
+
+	kin.inverse(travel, joint);						// joints with no motor keep the prefilled position
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		uint8_t axis = kin.motor_joint[motor];
+		if ((done[axis] == true) || (fp_ZERO(kin.motor_steps_per_unit[motor]))) continue;
+		joint[axis] = steps[motor] / kin.motor_steps_per_unit[motor];
+		done[axis] = true;
+	}
+	kin.forward(joint, travel);
+}
+
+/*
+ * ik_reachable() - return false if a target is outside the workspace of the kinematics
+ *
+ *	Only a delta has a limit - the effector can't get further than an arm length from any
+ *	tower. That workspace is convex, so a straight move is reachable if its end is.
+ *	Called from cm_test_soft_limits() so the runtime never gets an unreachable target.
+ */
+
+bool ik_reachable(const float target[])
+{
+	if (kin.type != KINEMATICS_DELTA) { return (true);}
+	for (uint8_t t=0; t<3; t++) {
+		float dx = kin.tower[t][0] - target[AXIS_X];
+		float dy = kin.tower[t][1] - target[AXIS_Y];
+		if ((dx*dx + dy*dy) >= kin.arm_square) { return (false);}
+	}
+	return (true);
+}
+
+/*
+ * ik_joint_moves() - return true if a move along unit[] moves the joint
+ *
+ *	Used to find the motors a move will run. A coupled joint moves if any of the axes
+ *	that drive it do.
+ */
+
+bool ik_joint_moves(const float unit[], uint8_t joint)
+{
+	switch (kin.type) {
+		case KINEMATICS_COREXY:
+		case KINEMATICS_HBOT: {
+			if ((joint == AXIS_X) || (joint == AXIS_Y)) {
+				return (fp_NOT_ZERO(unit[AXIS_X]) || fp_NOT_ZERO(unit[AXIS_Y]));
 			}
+			break;
+		}
+		case KINEMATICS_DELTA: {
+			if (joint <= AXIS_Z) {
+				return (fp_NOT_ZERO(unit[AXIS_X]) || fp_NOT_ZERO(unit[AXIS_Y]) || fp_NOT_ZERO(unit[AXIS_Z]));
+			}
+			break;
 		}
 	}
-*/
+	return (fp_NOT_ZERO(unit[joint]));
+}
+
+/*
+ * ik_joint_move_time() - minimum time for a move given the joint velocity limits
+ *
+ *	The planner limits each axis to its velocity_max (traverse) or feedrate_max (feed).
+ *	With coupled kinematics those limits are applied again to the joints, using the limits
+ *	of the axis each joint replaces, so a CoreXY diagonal doesn't run a belt motor at twice
+ *	its rated speed. CoreXY is linear and the joint travel gives the answer directly. A
+ *	delta's joint velocities change along the move, so the move is divided into pieces and
+ *	the fastest piece sets the time. Returns zero for Cartesian machines, where the axis
+ *	limits already are the joint limits.
+ */
+
+float ik_joint_move_time(const float start[], const float end[], bool traverse)
+{
+	if (kin.type == KINEMATICS_CARTESIAN) { return (0);}
+
+	uint8_t pieces = (kin.type == KINEMATICS_DELTA) ? KINEMATICS_DELTA_SAMPLES : 1;
+	float point[AXES];
+	float joint[AXES];
+	float prev_joint[AXES];
+	float max_time = 0;
+
+	kin.inverse(start, prev_joint);
+	for (uint8_t i=1; i<=pieces; i++) {
+		for (uint8_t axis=0; axis<AXES; axis++) {
+			point[axis] = start[axis] + (end[axis] - start[axis]) * i / pieces;
+		}
+		kin.inverse(point, joint);
+		for (uint8_t axis=0; axis<AXES; axis++) {
+			float limit = (traverse == true) ? cm.a[axis].velocity_max : cm.a[axis].feedrate_max;
+			if (fp_ZERO(limit)) { continue;}
+			max_time = max(max_time, fabs(joint[axis] - prev_joint[axis]) / limit);
+		}
+		copy_vector(prev_joint, joint);
+	}
+	return (max_time * pieces);
 }
 
 /*
@@ -101,3 +238,172 @@ static void _inverse_kinematics(const float travel[], float joint[])
 //		joint[i] = travel[i];
 //	}
 }
+
+static void _forward_kinematics(const float joint[], float travel[])
+{
+	memcpy(travel, joint, sizeof(float)*AXES);
+}
+
+/*
+ * _corexy_inverse() - CoreXY and H-bot: A = X + Y, B = X - Y
+ * _corexy_forward() - X = (A + B) / 2, Y = (A - B) / 2
+ *
+ *	The A belt motor runs the X joint and the B belt motor the Y joint. Swap the motor
+ *	maps or reverse a motor's polarity to match the belt routing. An H-bot has the same
+ *	equations - the difference is the racking load on the gantry, not the math.
+ */
+
+static void _corexy_inverse(const float travel[], float joint[])
+{
+	memcpy(joint, travel, sizeof(float)*AXES);
+	joint[AXIS_X] = travel[AXIS_X] + travel[AXIS_Y];
+	joint[AXIS_Y] = travel[AXIS_X] - travel[AXIS_Y];
+}
+
+static void _corexy_forward(const float joint[], float travel[])
+{
+	memcpy(travel, joint, sizeof(float)*AXES);
+	travel[AXIS_X] = (joint[AXIS_X] + joint[AXIS_Y]) * 0.5;
+	travel[AXIS_Y] = (joint[AXIS_X] - joint[AXIS_Y]) * 0.5;
+}
+
+/*
+ * _delta_inverse() - linear delta: carriage heights for the A, B and C towers
+ * _delta_forward() - effector position from the carriage heights (trilateration)
+ *
+ *	The towers stand at 210, 330 and 90 degrees around the Z axis, delta_radius from the
+ *	center once the effector and carriage offsets are taken out, and run the X, Y and Z
+ *	joints. Each carriage sits an arm's length above the effector:
+ *
+ *		height = Z + sqrt(arm^2 - (tower_x - X)^2 - (tower_y - Y)^2)
+ *
+ *	That is three square roots per segment. The forward solution intersects the three
+ *	arm spheres and takes the point below the carriages. Joint zero is the carriage height
+ *	with the effector at Z zero, so home the towers and set the position with G28.3.
+ *
+ *	Cost on the board: the SAM3X8C has no FPU, so every float operation is a soft-float
+ *	library call. _delta_inverse() makes 15 adds, 6 multiplies, 3 compares and 3 square
+ *	roots per segment. Taking about 60 cycles for an add or multiply, 30 for a compare
+ *	and 600 for sqrtf() that is roughly 3000 cycles, or 36 uS at 84 MHz, on top of the
+ *	6 multiplies ik_kinematics() makes for any kinematics. The exec has MIN_SEGMENT_USEC
+ *	(2500 uS) to prep a segment, so delta adds under 2% to the per-segment budget. To
+ *	measure it, enable DWT->CYCCNT and read it either side of ik_kinematics().
+ */
+
+static void _delta_inverse(const float travel[], float joint[])
+{
+	memcpy(joint, travel, sizeof(float)*AXES);
+	for (uint8_t t=0; t<3; t++) {
+		float dx = kin.tower[t][0] - travel[AXIS_X];
+		float dy = kin.tower[t][1] - travel[AXIS_Y];
+		float h = kin.arm_square - dx*dx - dy*dy;	// cm_test_soft_limits() keeps this positive
+		joint[AXIS_X + t] = travel[AXIS_Z] + ((h > 0) ? sqrt(h) : 0);
+	}
+}
+
+static void _delta_forward(const float joint[], float travel[])
+{
+	float p[3][3];
+	float ex[3], ey[3], ez[3], v13[3];
+
+	memcpy(travel, joint, sizeof(float)*AXES);
+	for (uint8_t t=0; t<3; t++) {
+		p[t][0] = kin.tower[t][0];
+		p[t][1] = kin.tower[t][1];
+		p[t][2] = joint[AXIS_X + t];
+	}
+	for (uint8_t i=0; i<3; i++) {
+		ex[i] = p[1][i] - p[0][i];
+		v13[i] = p[2][i] - p[0][i];
+	}
+	float d = sqrt(square(ex[0]) + square(ex[1]) + square(ex[2]));
+	for (uint8_t i=0; i<3; i++) { ex[i] /= d;}
+	float a = ex[0]*v13[0] + ex[1]*v13[1] + ex[2]*v13[2];
+	for (uint8_t i=0; i<3; i++) { ey[i] = v13[i] - a*ex[i];}
+	float j = sqrt(square(ey[0]) + square(ey[1]) + square(ey[2]));
+	for (uint8_t i=0; i<3; i++) { ey[i] /= j;}
+	ez[0] = ex[1]*ey[2] - ex[2]*ey[1];
+	ez[1] = ex[2]*ey[0] - ex[0]*ey[2];
+	ez[2] = ex[0]*ey[1] - ex[1]*ey[0];
+	if (ez[2] < 0) {								// point ez up so the effector is below
+		for (uint8_t i=0; i<3; i++) { ez[i] = -ez[i];}
+	}
+	float x = d * 0.5;								// the arms are all the same length
+	float y = (a*a + j*j) / (2*j) - x * a / j;
+	float h = kin.arm_square - x*x - y*y;
+	float z = (h > 0) ? sqrt(h) : 0;
+
+	for (uint8_t i=0; i<3; i++) {
+		travel[AXIS_X + i] = p[0][i] + x*ex[i] + y*ey[i] - z*ez[i];
+	}
+}
+
+/***********************************************************************************
+ * CONFIGURATION AND INTERFACE FUNCTIONS
+ * Functions to get and set variables from the cfgArray table
+ ***********************************************************************************/
+
+/*
+ * _set_kinematics() - select the kinematics functions and compute derived values
+ * ik_set_kin()		 - set the kinematics type
+ * ik_set_delta()	 - set a delta arm length or radius
+ *
+ *	If the machine is stopped the step positions are recomputed from the current position
+ *	so the next move doesn't jump. Home the machine after changing the kinematics.
+ */
+
+static void _set_kinematics()
+{
+	switch (kin.type) {
+		case KINEMATICS_COREXY:
+		case KINEMATICS_HBOT: { kin.inverse = _corexy_inverse; kin.forward = _corexy_forward; break;}
+		case KINEMATICS_DELTA: { kin.inverse = _delta_inverse; kin.forward = _delta_forward; break;}
+		default: { kin.inverse = _inverse_kinematics; kin.forward = _forward_kinematics; break;}
+	}
+	kin.arm_square = square(kin.delta_arm_length);
+	for (uint8_t t=0; t<3; t++) {
+		float angle = (210 + 120*t) / RADIAN;		// 210, 330 and 450 (90) degrees
+		kin.tower[t][0] = kin.delta_radius * cos(angle);
+		kin.tower[t][1] = kin.delta_radius * sin(angle);
+	}
+	if (cm.motion_state == MOTION_STOP) {
+		mp_set_steps_to_runtime_position();
+	}
+}
+
+stat_t ik_set_kin(nvObj_t *nv)
+{
+	if (nv->value > KINEMATICS_DELTA) { return (STAT_INPUT_VALUE_UNSUPPORTED);}
+	set_ui8(nv);
+	_set_kinematics();
+	return (STAT_OK);
+}
+
+stat_t ik_set_delta(nvObj_t *nv)
+{
+	if (nv->value <= 0) { return (STAT_INPUT_VALUE_RANGE_ERROR);}
+	set_flu(nv);
+	_set_kinematics();
+	return (STAT_OK);
+}
+
+/***********************************************************************************
+ * TEXT MODE SUPPORT
+ * Functions to print variables from the cfgArray table
+ ***********************************************************************************/
+
+#ifdef __TEXT_MODE
+
+static const char msg_units0[] PROGMEM = " in";	// used by GET_UNITS()
+static const char msg_units1[] PROGMEM = " mm";
+static const char *const msg_units[] PROGMEM = { msg_units0, msg_units1 };
+
+static const char fmt_kin[] PROGMEM = "[kin] kinematics%20d [0=cartesian,1=corexy,2=hbot,3=delta]\n";
+static const char fmt_kdl[] PROGMEM = "[kdl] delta arm length%17.3f%s\n";
+static const char fmt_kdr[] PROGMEM = "[kdr] delta radius%21.3f%s\n";
+
+void ik_print_kin(nvObj_t *nv) { text_print_ui8(nv, fmt_kin);}
+void ik_print_kdl(nvObj_t *nv) { text_print_flt_units(nv, fmt_kdl, GET_UNITS(ACTIVE_MODEL));}
+void ik_print_kdr(nvObj_t *nv) { text_print_flt_units(nv, fmt_kdr, GET_UNITS(ACTIVE_MODEL));}
+
+#endif // __TEXT_MODE
@@ -28,11 +28,61 @@
 #ifndef KINEMATICS_H_ONCE
 #define KINEMATICS_H_ONCE
 
+#include "config.h"
+
+#define KINEMATICS_DELTA_SAMPLES 4		// pieces a delta move is divided into to find its peak joint velocities
+
+enum kinType {							// kinematics selected by the machine profile ($kin)
+	KINEMATICS_CARTESIAN = 0,			// joints are the axes
+	KINEMATICS_COREXY,					// X and Y joints are the A and B belt motors
+	KINEMATICS_HBOT,					// same equations as CoreXY
+	KINEMATICS_DELTA					// X, Y and Z joints are the tower carriage heights
+};
+
+typedef struct kinSingleton {
+	uint8_t type;						// see kinType
+	float delta_arm_length;				// diagonal rod length, pivot to pivot
+	float delta_radius;					// horizontal distance from the effector pivots to the carriage pivots
+
+	// derived values - set by _set_kinematics()
+	float arm_square;					// delta_arm_length squared
+	float tower[3][2];					// X,Y of the A, B and C towers
+	void (*inverse)(const float travel[], float joint[]);
+	void (*forward)(const float joint[], float travel[]);
+
+	// motor map - set by ik_map_motors()
+	uint8_t motor_joint[MOTORS];		// joint each motor runs
+	float motor_steps_per_unit[MOTORS];	// zero for unmapped motors and inhibited axes
+} kinSingleton_t;
+extern kinSingleton_t kin;
+
 /*
  * Global Scope Functions
  */
 
 void ik_kinematics(const float travel[], float steps[]);
+void fk_kinematics(const float steps[], float travel[]);
+void ik_map_motors(void);
+bool ik_reachable(const float target[]);
+bool ik_joint_moves(const float unit[], uint8_t joint);
+float ik_joint_move_time(const float start[], const float end[], bool traverse);
+
+stat_t ik_set_kin(nvObj_t *nv);
+stat_t ik_set_delta(nvObj_t *nv);
+
+#ifdef __TEXT_MODE
+
+	void ik_print_kin(nvObj_t *nv);
+	void ik_print_kdl(nvObj_t *nv);
+	void ik_print_kdr(nvObj_t *nv);
+
+#else
+
+	#define ik_print_kin tx_print_stub
+	#define ik_print_kdl tx_print_stub
+	#define ik_print_kdr tx_print_stub
+
+#endif // __TEXT_MODE
 
 #endif // End of include Guard: KINEMATICS_H_ONCE
 
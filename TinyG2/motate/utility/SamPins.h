@@ -361,6 +361,8 @@ namespace Motate {
 		void setFrequency(const uint32_t freq) {};
 		void operator=(const float value) { write(value); };
 		void write(const float value) { Pin<pinNum>::write(value >= 0.5); };
+		uint32_t getTopValue() { return 2; };
+		void writeRaw(const uint16_t duty) { Pin<pinNum>::write(duty >= 1); };
 		bool canPWM() { return false; };
 
 		/*Override these to pick up new methods */
@@ -394,7 +396,10 @@ namespace Motate {
 			};\
 			void operator=(const float value) { write(value); };\
 			void write(const float value) {\
-				uint16_t duty = getTopValue() * value;\
+				writeRaw(getTopValue() * value);\
+			};\
+			/* duty as a compare value from 0 .. getTopValue() - no float math */\
+			void writeRaw(const uint16_t duty) {\
 				if (duty < 2)\
 					stopPWMOutput ## channelAorB ();\
 				else\
@@ -47,6 +47,8 @@ nvmSingleton_t nvm;
 
 stat_t prepare_persistence_file();
 stat_t write_persistent_values();
+stat_t append_persistent_values();
+stat_t load_persistence_journal();
 stat_t validate_persistence_file();
 uint8_t active_file_index();
 
@@ -78,6 +80,16 @@ const char* filenames[PERSISTENCE_FILENAME_CNT] = {
 
 #define CRC_LEN 4
 
+/*
+ Values changed between full writes are appended to a journal of fixed-size records, so a
+ single G10 or $ change costs one small append rather than a copy of every value. Later
+ records win on replay. Once the journal holds JOURNAL_MAX_RECORDS records it is compacted:
+ the current values are rewritten into the next persistence file and the journal is deleted.
+ Replaying a journal over a file that already contains its values is harmless, so losing
+ power between those two steps is safe.
+ */
+#define JOURNAL_FILENAME PERSISTENCE_DIR"/journal.bin"
+
 #endif
 
 /***********************************************************************************
@@ -94,6 +106,11 @@ void persistence_init()
 	nvm.file_index = 0;
 	nvm.last_write_systick = SysTickTimer_getValue();
 	nvm.write_failures = 0;
+	nvm.journal_records = 0;
+	nvm.boot_mount_ms = 0;
+	nvm.boot_validate_ms = 0;
+	nvm.boot_load_ms = 0;
+	nvm.boot_defaults_ms = 0;
 #endif
 	return;
 }
@@ -120,6 +137,13 @@ stat_t read_persistent_value(nvObj_t *nv)
 {
 	ritorno(prepare_persistence_file());
 	DEBUG_PRINT("file opened for reading\n");
+
+	// values in the journal supersede the ones in the file
+	auto j = nvm.journal.find(nv->index);
+	if (j != nvm.journal.end()) {
+		nv->value = j->second;
+		return (STAT_OK);
+	}
 	fs_ritorno(f_lseek(&nvm.file, nv->index * NVM_VALUE_LEN), "f_lseek during read");
 	UINT br;
 	fs_ritorno(f_read(&nvm.file, &nvm.io_buffer, NVM_VALUE_LEN, &br), "read value");
@@ -132,6 +156,52 @@ stat_t read_persistent_value(nvObj_t *nv)
 }
 #endif // __ARM
 
+/*
+ * read_persistent_values() - read all values in index order, calling load_func() for each
+ *
+ *	On ARM the file is streamed through the IO buffer in one pass instead of seeking to
+ *	each value, and journaled values are substituted as they come up. nv->index and
+ *	nv->value are set before each call; the token is left to load_func().
+ */
+
+#ifdef __AVR
+stat_t read_persistent_values(nvObj_t *nv, void (*load_func)(nvObj_t *nv))
+{
+	for (nv->index=0; nv->index < nv_index_max(); nv->index++) {
+		read_persistent_value(nv);
+		load_func(nv);
+	}
+	return (STAT_OK);
+}
+#endif // __AVR
+
+#ifdef __ARM
+stat_t read_persistent_values(nvObj_t *nv, void (*load_func)(nvObj_t *nv))
+{
+	ritorno(prepare_persistence_file());
+	fs_ritorno(f_lseek(&nvm.file, 0), "f_lseek to start for bulk read");
+
+	uint16_t step = IO_BUFFER_SIZE/NVM_VALUE_LEN;
+	auto j = nvm.journal.begin();
+	for (index_t cnt = 0; cnt < nv_index_max(); cnt += step) {
+		uint16_t io_byte_count = std::min(IO_BUFFER_SIZE, (nv_index_max()-cnt) * NVM_VALUE_LEN);
+		UINT br;
+		fs_ritorno(f_read(&nvm.file, &nvm.io_buffer, io_byte_count, &br), "bulk read");
+		if (br != io_byte_count) return (STAT_PERSISTENCE_ERROR);	// validated file, so shouldn't happen
+
+		for (nv->index = cnt; nv->index < cnt + io_byte_count/NVM_VALUE_LEN; nv->index++) {
+			if ((j != nvm.journal.end()) && (j->first == nv->index)) {
+				nv->value = (j++)->second;
+			} else {
+				memcpy(&nv->value, nvm.io_buffer + (nv->index - cnt) * NVM_VALUE_LEN, NVM_VALUE_LEN);
+			}
+			load_func(nv);
+		}
+	}
+	return (STAT_OK);
+}
+#endif // __ARM
+
 /*
  * write_persistent_value() - write to NVM by index, but only if the value has changed.
  *
@@ -179,6 +249,10 @@ stat_t write_persistent_value(nvObj_t *nv)
  * write_persistent_values_callback()
  *
  *	On ARM, write cached values to a file. No-op on AVR.
+ *
+ *	Cached values are normally appended to the journal, which is cheap enough to do while
+ *	the machine is moving. A full rewrite (compaction, or creating the first file on a new
+ *	card) is held off until the cycle ends.
  */
 
 stat_t write_persistent_values_callback()
@@ -190,15 +264,21 @@ stat_t write_persistent_values_callback()
 	f_polldisk();
 	if (nvm.write_cache.size()) {
 		if (SysTickTimer_getValue() - nvm.last_write_systick < MIN_WRITE_INTERVAL) return (STAT_NOOP);
-		// this check may not be necessary on ARM, but just in case...
-		if (cm.cycle_state != CYCLE_OFF) return(STAT_NOOP);	   // can't write when machine is moving
-		
-		if(write_persistent_values() == STAT_OK) {
+
+		bool compact = (prepare_persistence_file() != STAT_OK) ||
+					   (nvm.journal_records + nvm.write_cache.size() > JOURNAL_MAX_RECORDS);
+		if (compact && (cm.cycle_state != CYCLE_OFF)) return(STAT_NOOP);	// full rewrites wait for the machine to stop
+
+		if ((compact ? write_persistent_values() : append_persistent_values()) == STAT_OK) {
 			nvm.write_cache.clear();
 			nvm.write_failures = 0;
 		} else {
 			// if the write failed, make sure no half-written output file exists
-			f_unlink(filenames[NEXT_FILE_INDEX]);
+			if (compact) {
+				f_unlink(filenames[NEXT_FILE_INDEX]);
+			} else {
+				nvm.journal_records = JOURNAL_MAX_RECORDS;	// a failed append may leave a torn record; compact next time
+			}
 			if (++nvm.write_failures >= MAX_WRITE_FAILURES) {
 				nvm.write_cache.clear(); // give up on these values
 				nvm.write_failures = 0;  // but try again if we get more values later
@@ -253,9 +333,12 @@ stat_t prepare_persistence_file()
 	if (f_is_open(&nvm.file) && validate(&nvm.file) == FR_OK) return STAT_OK;
 	
 	// mount volume if necessary
+	uint32_t start = SysTickTimer_getValue();
 	if (!nvm.fat_fs.fs_type) {
 		fs_ritorno(f_mount(&nvm.fat_fs, "", 1), "mount");		/* Give a work area to the default drive */
 	}
+	nvm.boot_mount_ms = SysTickTimer_getValue() - start;
+	start = SysTickTimer_getValue();
 	f_mkdir(PERSISTENCE_DIR);
 	uint8_t index = active_file_index();
 	fs_ritorno(f_open(&nvm.file, filenames[index], FA_READ | FA_OPEN_EXISTING), "open input");
@@ -270,7 +353,75 @@ stat_t prepare_persistence_file()
 	}
 	// OK to delete old file now (if it still exists), since we know the current one is good
 	f_unlink(filenames[PREV_FILE_INDEX]);
-	return STAT_OK;
+	stat_t status = load_persistence_journal();
+	nvm.boot_validate_ms = SysTickTimer_getValue() - start;
+	return (status);
+}
+
+/*
+ * load_persistence_journal()
+ *
+ *	ARM only. Replays the journal into nvm.journal. Replay stops at the first record with
+ *  a bad CRC or index, and the journal is truncated there so later appends aren't lost
+ *  behind a torn record. A missing journal is not an error.
+ */
+stat_t load_persistence_journal()
+{
+	FIL f_jnl;
+	UINT br;
+	nvmJournalRecord_t rec;
+
+	nvm.journal.clear();
+	nvm.journal_records = 0;
+	if (f_open(&f_jnl, JOURNAL_FILENAME, FA_READ | FA_WRITE | FA_OPEN_EXISTING) != FR_OK) {
+		return (STAT_OK);
+	}
+	while ((f_read(&f_jnl, &rec, sizeof(rec), &br) == FR_OK) && (br == sizeof(rec))) {
+		if ((rec.crc != crc32(0, &rec, JOURNAL_CRC_SPAN)) || (rec.index >= nv_index_max())) {
+			break;
+		}
+		nvm.journal[rec.index] = rec.value;
+		nvm.journal_records++;
+	}
+	if (f_size(&f_jnl) != nvm.journal_records * sizeof(rec)) {
+		DEBUG_PRINT("truncating journal after %i records\n", nvm.journal_records);
+		f_lseek(&f_jnl, nvm.journal_records * sizeof(rec));
+		f_truncate(&f_jnl);
+	}
+	fs_ritorno(f_close(&f_jnl), "close journal");
+	return (STAT_OK);
+}
+
+/*
+ * append_persistent_values()
+ *
+ *	ARM only. Appends the write cache to the journal as one record per value, then syncs.
+ *  Assumes prepare_persistence_file() has succeeded, so the journal has been replayed.
+ */
+stat_t append_persistent_values()
+{
+	FIL f_jnl;
+	UINT bw;
+	nvmJournalRecord_t rec;
+
+	fs_ritorno(f_open(&f_jnl, JOURNAL_FILENAME, FA_WRITE | FA_OPEN_ALWAYS), "open journal");
+	fs_ritorno(f_lseek(&f_jnl, nvm.journal_records * sizeof(rec)), "journal seek");
+	for (auto i = nvm.write_cache.begin(); i != nvm.write_cache.end(); ++i) {
+		rec.index = i->first;
+		rec.value = i->second;
+		rec.crc = crc32(0, &rec, JOURNAL_CRC_SPAN);
+		fs_ritorno(f_write(&f_jnl, &rec, sizeof(rec), &bw), "journal write");
+		if (bw != sizeof(rec)) return (STAT_PERSISTENCE_ERROR);
+	}
+	fs_ritorno(f_close(&f_jnl), "close journal");		// f_close syncs
+
+	// only take the new values into the journal map once they are on the card
+	for (auto i = nvm.write_cache.begin(); i != nvm.write_cache.end(); ++i) {
+		nvm.journal[i->first] = i->second;
+	}
+	nvm.journal_records += nvm.write_cache.size();
+	DEBUG_PRINT("appended %i journal records\n", nvm.write_cache.size());
+	return (STAT_OK);
 }
 
 /*
@@ -311,7 +462,8 @@ stat_t validate_persistence_file()
  * 
  * ARM only. Writes all the values from the write cache to the SD card. Since we can't
  *  rewrite individual pieces of data in the middle of an existing file, this requires
- *  rewriting all the data into a new file.
+ *  rewriting all the data into a new file. Journaled values are folded in as well, after
+ *  which the journal is deleted.
  */
 stat_t write_persistent_values()
 {
@@ -348,7 +500,12 @@ stat_t write_persistent_values()
 		}
 		DEBUG_PRINT("io_buffer populated with %i bytes total\n", br);
 		
-		// update the values in the buffer from the write cache
+		// update the values in the buffer from the journal, then from the write cache
+		for (auto i = nvm.journal.lower_bound(cnt);
+			i != nvm.journal.lower_bound(cnt+step);
+			 ++i) {
+			memcpy(nvm.io_buffer + (i->first - cnt) * NVM_VALUE_LEN, &i->second, NVM_VALUE_LEN);
+		}
 		for (auto i = nvm.write_cache.lower_bound(cnt);
 			i != nvm.write_cache.lower_bound(cnt+step);
 			 ++i) {
@@ -379,12 +536,79 @@ stat_t write_persistent_values()
 		DEBUG_PRINT("deleted obsolete file %s\n", filenames[nvm.file_index]);
 		nvm.file_index = 0;
 	}
-	
+
+	// the new file holds everything the journal did
+	f_unlink(JOURNAL_FILENAME);
+	nvm.journal.clear();
+	nvm.journal_records = 0;
 	return (STAT_OK);
 }
 #endif // __ARM
 
+/*
+ * write_persistent_blob()	- write a block of data to a file in the persistence directory
+ * read_persistent_blob()	- read it back; fails if the file is missing, short or corrupt
+ *
+ *	For data that doesn't fit the config table, such as the probing grid height map.
+ *	The data is written as-is and followed by its CRC32. The file is replaced whole,
+ *	so a blob is either the old one, the new one, or fails its CRC check on read.
+ *	There is no card on AVR, so both fail there.
+ */
+#ifdef __AVR
+stat_t write_persistent_blob(const char *name, const void *data, uint16_t size)
+{
+	return (STAT_PERSISTENCE_ERROR);
+}
+
+stat_t read_persistent_blob(const char *name, void *data, uint16_t size)
+{
+	return (STAT_PERSISTENCE_ERROR);
+}
+#endif // __AVR
 
+#ifdef __ARM
+#define BLOB_PATH_LEN 32
 
+static stat_t _open_persistent_blob(FIL *f_blob, const char *name, BYTE mode)
+{
+	char path[BLOB_PATH_LEN];
+
+	if (!nvm.fat_fs.fs_type) {
+		fs_ritorno(f_mount(&nvm.fat_fs, "", 1), "mount");
+	}
+	f_mkdir(PERSISTENCE_DIR);
+	snprintf(path, sizeof(path), PERSISTENCE_DIR"/%s", name);
+	fs_ritorno(f_open(f_blob, path, mode), "open blob");
+	return (STAT_OK);
+}
 
+stat_t write_persistent_blob(const char *name, const void *data, uint16_t size)
+{
+	FIL f_blob;
+	UINT bw;
+	uint32_t crc = crc32(0, data, size);
+
+	ritorno(_open_persistent_blob(&f_blob, name, FA_WRITE | FA_CREATE_ALWAYS));
+	fs_ritorno(f_write(&f_blob, data, size, &bw), "blob write");
+	if (bw != size) { f_close(&f_blob); return (STAT_PERSISTENCE_ERROR); }
+	fs_ritorno(f_write(&f_blob, &crc, CRC_LEN, &bw), "blob crc write");
+	fs_ritorno(f_close(&f_blob), "close blob");
+	return (bw == CRC_LEN) ? STAT_OK : STAT_PERSISTENCE_ERROR;
+}
 
+stat_t read_persistent_blob(const char *name, void *data, uint16_t size)
+{
+	FIL f_blob;
+	UINT br, crc_br;
+	uint32_t crc;
+
+	ritorno(_open_persistent_blob(&f_blob, name, FA_READ | FA_OPEN_EXISTING));
+	fs_ritorno(f_read(&f_blob, data, size, &br), "blob read");
+	fs_ritorno(f_read(&f_blob, &crc, CRC_LEN, &crc_br), "blob crc read");
+	fs_ritorno(f_close(&f_blob), "close blob");
+	if ((br != size) || (crc_br != CRC_LEN) || (crc != crc32(0, data, size))) {
+		return (STAT_PERSISTENCE_ERROR);
+	}
+	return (STAT_OK);
+}
+#endif // __ARM
@@ -38,9 +38,23 @@
 #include "util.h"                   // FIXME: this won't compile if included after <map>
 #include <map>
 
-#define IO_BUFFER_SIZE 512      // this should be evenly divisible by NVM_VALUE_LEN, and <=512 until multi-block reads are fixed (right now they are hanging...)
+// IO_BUFFER_SIZE should be evenly divisible by NVM_VALUE_LEN and a multiple of the 512 byte
+// sector size, so FatFs can move whole sectors straight to and from it with multi-block transfers.
+// Boards that are short on RAM can override it.
+#ifndef IO_BUFFER_SIZE
+#define IO_BUFFER_SIZE 2048
+#endif
 #define MIN_WRITE_INTERVAL 1000               // minimum interval between persistence file writes
 #define MAX_WRITE_FAILURES 3
+#define JOURNAL_MAX_RECORDS 128               // journal records allowed before compaction into a new persistence file
+
+// Journal record - one changed value, appended to the journal instead of rewriting the whole file
+typedef struct nvmJournalRecord {
+	uint32_t index;							// config index of the value
+	float value;
+	uint32_t crc;							// CRC32 of index and value; a torn append fails this check
+} nvmJournalRecord_t;
+#define JOURNAL_CRC_SPAN (sizeof(nvmJournalRecord_t) - sizeof(uint32_t))
 
 #endif
 
@@ -60,16 +74,28 @@ typedef struct nvmSingleton {
     uint8_t file_index;
     uint8_t io_buffer[IO_BUFFER_SIZE];
     std::map<index_t, float> write_cache;
+    std::map<index_t, float> journal;	// values in the journal that supersede the persistence file
+    uint16_t journal_records;			// records in the journal file, including superseded ones
     uint32_t last_write_systick;
     uint8_t write_failures;
+
+    // boot timing breakdown in ms, reported in the system ready message
+    uint16_t boot_mount_ms;				// mounting the card
+    uint16_t boot_validate_ms;			// CRC check of the persistence file and journal replay
+    uint16_t boot_load_ms;				// bulk load of the validated file into the config table
+    uint16_t boot_defaults_ms;			// loading defaults when the file is missing or out of rev
 #endif
 } nvmSingleton_t;
+extern nvmSingleton_t nvm;
 
 //**** persistence function prototypes ****
 
 void persistence_init(void);
 stat_t read_persistent_value(nvObj_t *nv);
+stat_t read_persistent_values(nvObj_t *nv, void (*load_func)(nvObj_t *nv));
 stat_t write_persistent_value(nvObj_t *nv);
 stat_t write_persistent_values_callback();
+stat_t write_persistent_blob(const char *name, const void *data, uint16_t size);
+stat_t read_persistent_blob(const char *name, void *data, uint16_t size);
 
 #endif // End of include guard: PERSISTENCE_H_ONCE
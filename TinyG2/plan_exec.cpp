@@ -41,6 +41,14 @@ static stat_t _exec_aline_head(void);
 static stat_t _exec_aline_body(void);
 static stat_t _exec_aline_tail(void);
 static stat_t _exec_aline_segment(void);
+static stat_t _exec_segment_steps(void);
+static float _shaped_position(uint8_t axis);
+static void _shape_target(const float target[], float shaped[]);
+static stat_t _exec_shaper_settle(void);
+static void _exec_raster_segment(void);
+static stat_t _exec_jog(mpBuf_t *bf);
+static float _traverse_axis_position(uint8_t axis, float time);
+static void _spline_target(float distance);
 
 static void _init_forward_diffs(float Vi, float Vt);
 
@@ -55,18 +63,30 @@ OutputPin<kDebug2_PinNumber> exec_debug_pin2;
  *
  *	Dequeues the buffer queue and executes the move continuations.
  *	Manages run buffers and other details
+ *
+ *	When motion stops with input shaping active the shaped position is still behind the
+ *	commanded one. Settling segments are run until it catches up, before anything that
+ *	isn't motion - commands, dwells, holds - is allowed to run. A hold that comes to rest
+ *	while the shaper is settling waits in FEEDHOLD_READY_TO_HOLD (see mp_start_hold()).
  */
 
 stat_t mp_exec_move()
 {
 	mpBuf_t *bf;
 
-	if (cm.hold_state == FEEDHOLD_HOLD || (bf = mp_get_run_buffer()) == NULL) {			// NULL bf means nothing's running
+	if (cm.hold_state == FEEDHOLD_HOLD || mb.start_held == true ||	// held for more blocks, see mp_start_callback()
+		(bf = mp_get_run_buffer()) == NULL) {			// NULL bf means nothing's running
+		if (mr.shaper_settle_time > 0) return (_exec_shaper_settle());
 		st_prep_null();
 		return (STAT_NOOP);
 	}
+	if ((mr.shaper_settle_time > 0) && (mr.move_state == MOVE_OFF) &&
+		((cm.hold_state == FEEDHOLD_READY_TO_HOLD) || ((bf->move_type != MOVE_TYPE_ALINE) &&
+		 (bf->move_type != MOVE_TYPE_JOG) && (bf->move_type != MOVE_TYPE_TRAVERSE)))) {
+		return (_exec_shaper_settle());
+	}
 	// Manage cycle and motion state transitions
-	if (bf->move_type == MOVE_TYPE_ALINE) { 			// cycle auto-start for lines only
+	if ((bf->move_type == MOVE_TYPE_ALINE) || (bf->move_type == MOVE_TYPE_TRAVERSE)) { // cycle auto-start for lines only
 		if (cm.motion_state == MOTION_STOP) {
 			cm_cycle_start();
 			cm_set_motion_state(MOTION_RUN);
@@ -179,6 +199,10 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 		bf->replannable = false;
 														// too short lines have already been removed
 		if (fp_ZERO(bf->length)) {						// ...looks for an actual zero here
+			for (uint8_t i=0; i<bf->attached_count; i++) {	// no segment to carry attached commands
+				float value[AXES] = { bf->attached[i].value, 0,0,0,0,0 };
+				bf->attached[i].func(value, value);
+			}
 			mr.move_state = MOVE_OFF;					// reset mr buffer
 			mr.section_state = SECTION_OFF;
 			if(bf->nx->move_state == MOVE_NEW)
@@ -199,9 +223,19 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 		mr.entry_velocity = bf->entry_velocity;
 		mr.cruise_velocity = bf->cruise_velocity;
 		mr.exit_velocity = bf->exit_velocity;
+		mr.requested_velocity = bf->cruise_vmax;
+
+		mpRasterLine_t *line;							// a raster line resumed after a feedhold...
+		mr.raster_distance = 0;							// ...picks up at the pixel it stopped on
+		if ((line = mp_get_raster_line(bf->gm.raster)) != NULL) {
+			mr.raster_distance = max(0, line->count * line->pitch - bf->length);
+		}
 
 		copy_vector(mr.unit, bf->unit);
 		copy_vector(mr.target, bf->gm.target);			// save the final target of the move
+		for (uint8_t i=0; i<bf->attached_count; i++) {	// run attached commands with the first segment
+			st_prep_attached_command(bf->attached[i].func, bf->attached[i].value);
+		}
 
 		// generate the waypoints for position correction at section ends
 		for (uint8_t axis=0; axis<AXES; axis++) {
@@ -209,6 +243,21 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 			mr.waypoint[SECTION_BODY][axis] = mr.position[axis] + mr.unit[axis] * (mr.head_length + mr.body_length);
 			mr.waypoint[SECTION_TAIL][axis] = mr.position[axis] + mr.unit[axis] * (mr.head_length + mr.body_length + mr.tail_length);
 		}
+
+		// a spline runs on distance along the curve instead (see _spline_target())
+		if (mp_is_spline(&mr.gm)) {
+			mr.spline_origin[0] = bf->spline_origin[0];
+			mr.spline_origin[1] = bf->spline_origin[1];
+			mp_spline_coefficients(mr.spline_origin, &mr.gm, mr.spline_coeff);
+			mr.spline_length = bf->spline_length;
+			if (fp_ZERO(bf->spline_start)) {			// a new curve - otherwise the rest of one split by a feedhold
+				mr.spline_t = 0;
+				mr.spline_distance = 0;
+			}
+			mr.spline_waypoint[SECTION_HEAD] = bf->spline_start + mr.head_length;
+			mr.spline_waypoint[SECTION_BODY] = bf->spline_start + mr.head_length + mr.body_length;
+			mr.spline_waypoint[SECTION_TAIL] = bf->spline_start + mr.head_length + mr.body_length + mr.tail_length;
+		}
 	}
 	// NB: from this point on the contents of the bf buffer do not affect execution
 
@@ -528,9 +577,6 @@ static stat_t _exec_aline_tail()
 
 static stat_t _exec_aline_segment()
 {
-	uint8_t i;
-	float travel_steps[MOTORS];
-
 	// Set target position for the segment
 	// If the segment ends on a section waypoint synchronize to the head, body or tail end
 	// Otherwise if not at a section waypoint compute target from segment time and velocity
@@ -538,19 +584,129 @@ static stat_t _exec_aline_segment()
 
 	if ((--mr.segment_count == 0) && (mr.section_state == SECTION_2nd_HALF) &&
 		(cm.motion_state != MOTION_HOLD)) {
-		copy_vector(mr.gm.target, mr.waypoint[mr.section]);
+		if (mp_is_spline(&mr.gm)) {
+			_spline_target(mr.spline_waypoint[mr.section]);
+		} else {
+			copy_vector(mr.gm.target, mr.waypoint[mr.section]);
+		}
 	} else {
 		float segment_length = mr.segment_velocity * mr.segment_time;
-		for (i=0; i<AXES; i++) {
-			mr.gm.target[i] = mr.position[i] + (mr.unit[i] * segment_length);
+		if (mp_is_spline(&mr.gm)) {
+			_spline_target(mr.spline_distance + segment_length);
+		} else {
+			for (uint8_t i=0; i<AXES; i++) {
+				mr.gm.target[i] = mr.position[i] + (mr.unit[i] * segment_length);
+			}
 		}
 	}
 
+	if (mr.gm.raster != 0) {								// raster move - power follows the pixels
+		_exec_raster_segment();
+	} else if (cm_spindle_dynamic_power() == true) {		// laser mode - power follows velocity
+		st_prep_attached_command(cm_exec_spindle_dynamic_power, mr.segment_velocity / mr.requested_velocity);
+	}
+	ritorno(_exec_segment_steps());
+	if (mr.segment_count == 0) return (STAT_OK);			// this section has run all its segments
+	return (STAT_EAGAIN);									// this section still has more segments to run
+}
+
+/*
+ * _spline_target() - set the segment target to the point a distance along the curve
+ *
+ *	The curve parameter t for the new distance is found with Newton's method, starting from
+ *	the t of the last segment end, on the curve length between the two. Segments are short,
+ *	so it usually converges in a step or two. Each step is kept inside the bracket around
+ *	the answer so it can't run away where the curve slows to a stop next to a control point.
+ *	The end of the curve is taken exactly.
+ */
+
+static void _spline_target(float distance)
+{
+	copy_vector(mr.gm.target, mr.position);
+	if (distance >= mr.spline_length - SPLINE_LENGTH_TOLERANCE) {
+		mr.spline_t = 1;
+		mr.spline_distance = mr.spline_length;
+		copy_vector(mr.gm.target, mr.target);
+		return;
+	}
+	float ds = distance - mr.spline_distance;
+	float t = mr.spline_t;
+	float lo = (ds < 0) ? 0 : t;
+	float hi = (ds < 0) ? t : 1;
+	float t1 = t + ds / mp_spline_speed(mr.spline_coeff, t);
+
+	for (uint8_t i=0; i<SPLINE_NEWTON_ITERATIONS; i++) {
+		if (!((t1 > lo) && (t1 < hi))) {				// also catches a stall (division by zero)
+			t1 = (lo + hi) / 2;
+		}
+		float error = mp_spline_length(mr.spline_coeff, t, t1) - ds;
+		if (fabs(error) < SPLINE_LENGTH_TOLERANCE) break;
+		if (error > 0) { hi = t1;} else { lo = t1;}
+		t1 -= error / mp_spline_speed(mr.spline_coeff, t1);
+	}
+	if (!((t1 >= lo) && (t1 <= hi))) {
+		t1 = (lo + hi) / 2;
+	}
+	mr.spline_t = t1;
+	mr.spline_distance = distance;
+	for (uint8_t i=0; i<2; i++) {
+		mr.gm.target[i] = mr.spline_origin[i] + ((mr.spline_coeff[2][i] * t1 + mr.spline_coeff[1][i]) * t1 + mr.spline_coeff[0][i]) * t1;
+	}
+}
+
+/*
+ * _exec_raster_segment() - stage the pixels a raster segment runs over (see cm_raster_line())
+ *
+ *	The pixel under the start of the segment is always staged at its start, so a line
+ *	resumed after a feedhold picks up the right power. A blank raster move stages a single
+ *	zero pixel.
+ */
+
+static void _exec_raster_segment()
+{
+	float length = 0;
+	for (uint8_t i=0; i<AXES; i++) {
+		length += (mr.gm.target[i] - mr.position[i]) * mr.unit[i];
+	}
+	float start = mr.raster_distance;
+	mr.raster_distance += length;
+
+	float fraction[RASTER_SEGMENT_PIXELS_MAX];
+	uint8_t pixel[RASTER_SEGMENT_PIXELS_MAX];
+	uint8_t count = 1;
+	fraction[0] = 0;
+	pixel[0] = 0;
+
+	mpRasterLine_t *line;
+	if ((line = mp_get_raster_line(mr.gm.raster)) != NULL) {
+		uint16_t p = (uint16_t)(start / line->pitch);
+		if (p >= line->count) { p = line->count - 1;}
+		pixel[0] = line->pixel[p];
+		for (p++; (p < line->count) && (count < RASTER_SEGMENT_PIXELS_MAX); p++) {
+			float offset = p * line->pitch - start;
+			if (offset >= length) break;
+			fraction[count] = offset / length;
+			pixel[count++] = line->pixel[p];
+		}
+	}
+	st_prep_raster(fraction, pixel, count, mr.segment_velocity / mr.requested_velocity, mr.segment_time);
+}
+
+/*
+ * _exec_segment_steps() - prep the steppers for a segment ending at mr.gm.target
+ */
+
+static stat_t _exec_segment_steps()
+{
+	uint8_t i;
+	float travel_steps[MOTORS];
+
 	// Convert target position to steps
 	// Bucket-brigade the old target down the chain before getting the new target from kinematics
 	//
-	// NB: The direct manipulation of steps to compute travel_steps only works for Cartesian kinematics.
-	//	   Other kinematics may require transforming travel distance as opposed to simply subtracting steps.
+	// Steps are joint positions, so subtracting them gives the joint travel for any kinematics.
+	// Between segment ends the joints move in a straight line, so a non-Cartesian path is
+	// followed as a chain of segment-length chords in joint space.
 
 	for (i=0; i<MOTORS; i++) {
 		mr.commanded_steps[i] = mr.position_steps[i];		// previous segment's position, delayed by 1 segment
@@ -558,7 +714,10 @@ static stat_t _exec_aline_segment()
 		mr.encoder_steps[i] = en_read_encoder(i);			// get current encoder position (time aligns to commanded_steps)
 		mr.following_error[i] = mr.encoder_steps[i] - mr.commanded_steps[i];
 	}
-	ik_kinematics(mr.gm.target, mr.target_steps);			// now determine the target steps...
+	float target[AXES];										// apply input shaping and probing grid Z compensation
+	_shape_target(mr.gm.target, target);
+	target[AXIS_Z] += cm_get_grid_offset(target);
+	ik_kinematics(target, mr.target_steps);					// now determine the target steps...
 	for (i=0; i<MOTORS; i++) {								// and compute the distances to be traveled
 		travel_steps[i] = mr.target_steps[i] - mr.position_steps[i];
 	}
@@ -567,6 +726,355 @@ static stat_t _exec_aline_segment()
 
 	ritorno(st_prep_line(travel_steps, mr.following_error, mr.segment_time));
 	copy_vector(mr.position, mr.gm.target); 				// update position from target
-	if (mr.segment_count == 0) return (STAT_OK);			// this section has run all its segments
-	return (STAT_EAGAIN);									// this section still has more segments to run
+	return (STAT_OK);
+}
+
+/*
+ * mp_reset_shaper()	  - fill the shaper history with a stationary position
+ * _shaper_position()	  - unshaped position of an axis a delay (minutes) before the newest segment end
+ * _shaped_position()	  - shaped position of an axis at the newest segment end
+ * _shape_target()		  - shape a segment target and add it to the history
+ * _exec_shaper_settle()  - run a stationary segment so the shaped position can catch up
+ *
+ *	Each shaped axis is commanded to the sum of its shaper impulses applied to the unshaped
+ *	position history: amplitude[0] * p(now) + amplitude[1] * p(now - delay[1]) + ...
+ *	The history holds the segment end positions and times; positions between segment ends
+ *	are interpolated. The shaped position reaches the commanded one once the longest delay
+ *	has passed without motion, which shaper_settle_time counts down.
+ *
+ *	mp_reset_shaper() returns the shaped position the steps must be set to. If the shaper
+ *	is still settling the history is moved to the new position rather than refilled, so
+ *	the correction in progress carries over and the motors still finish it.
+ */
+
+void mp_reset_shaper(const float position[], float shaped[])
+{
+	if (mr.shaper_settle_time > 0) {
+		float offset[AXES];
+		for (uint8_t axis=0; axis<AXES; axis++) {
+			offset[axis] = position[axis] - mr.shaper_position[mr.shaper_index][axis];
+		}
+		for (uint8_t i=0; i<SHAPER_HISTORY; i++) {
+			for (uint8_t axis=0; axis<AXES; axis++) {
+				mr.shaper_position[i][axis] += offset[axis];
+			}
+		}
+		for (uint8_t axis=0; axis<AXES; axis++) {
+			shaped[axis] = _shaped_position(axis);
+		}
+		return;
+	}
+	for (uint8_t i=0; i<SHAPER_HISTORY; i++) {
+		copy_vector(mr.shaper_position[i], position);
+		mr.shaper_time[i] = NOM_SEGMENT_TIME;
+	}
+	mr.shaper_index = 0;
+	memcpy(shaped, position, sizeof(float)*AXES);
+}
+
+static float _shaper_position(uint8_t axis, float delay)
+{
+	uint8_t i = mr.shaper_index;
+
+	for (uint8_t n=1; n<SHAPER_HISTORY; n++) {
+		uint8_t prev = (i == 0) ? (SHAPER_HISTORY - 1) : (i - 1);
+		if (delay < mr.shaper_time[i]) {
+			float fraction = delay / mr.shaper_time[i];
+			return (mr.shaper_position[i][axis] - (mr.shaper_position[i][axis] - mr.shaper_position[prev][axis]) * fraction);
+		}
+		delay -= mr.shaper_time[i];
+		i = prev;
+	}
+	return (mr.shaper_position[i][axis]);						// older than the history - use the oldest
+}
+
+static float _shaped_position(uint8_t axis)
+{
+	cfgAxis_t *a = &cm.a[axis];
+	float *newest = mr.shaper_position[mr.shaper_index];
+
+	if (a->shaper_impulses == 0) { return (newest[axis]);}
+	float shaped = a->shaper_amplitude[0] * newest[axis];
+	for (uint8_t i=1; i<a->shaper_impulses; i++) {
+		shaped += a->shaper_amplitude[i] * _shaper_position(axis, a->shaper_delay[i]);
+	}
+	return (shaped);
+}
+
+static void _shape_target(const float target[], float shaped[])
+{
+	uint8_t prev = mr.shaper_index;
+	if (++mr.shaper_index >= SHAPER_HISTORY) { mr.shaper_index = 0;}
+	copy_vector(mr.shaper_position[mr.shaper_index], target);
+	mr.shaper_time[mr.shaper_index] = mr.segment_time;
+	memcpy(shaped, target, sizeof(float)*AXES);
+
+	float settle_time = 0;
+	uint8_t moved = false;
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		cfgAxis_t *a = &cm.a[axis];
+		if (fp_NE(target[axis], mr.shaper_position[prev][axis])) { moved = true;}
+		if (a->shaper_impulses == 0) { continue;}
+		settle_time = max(settle_time, a->shaper_delay[a->shaper_impulses-1]);
+		shaped[axis] = _shaped_position(axis);
+	}
+	if (moved == true) {
+		mr.shaper_settle_time = settle_time;
+	} else {
+		mr.shaper_settle_time = min(mr.shaper_settle_time, settle_time) - mr.segment_time;
+	}
+	if (mr.shaper_settle_time <= 0) {
+		mr.shaper_settle_time = 0;
+		memcpy(shaped, target, sizeof(float)*AXES);				// settled - no rounding left over
+	}
+}
+
+static stat_t _exec_shaper_settle()
+{
+	mr.segment_time = NOM_SEGMENT_TIME;
+	copy_vector(mr.gm.target, mr.position);
+	if (_exec_segment_steps() != STAT_OK) {						// can't prep - give up on settling
+		mr.shaper_settle_time = 0;
+		st_prep_null();
+	}
+	return (STAT_OK);
+}
+
+/*************************************************************************
+ * mp_jog_velocity() - queue a velocity jog
+ * _exec_jog()		 - run one segment of a velocity jog
+ *
+ *	A velocity jog has no endpoint. Every segment each axis moves toward its commanded
+ *	velocity in cm.jog_velocity[] (mm/min, machine coordinates), so a new vector sent over
+ *	the control channel takes effect on the next segment. Velocity changes are jerk limited
+ *	per axis using the axis jerk_max: the acceleration may build to sqrt(2*J*|dv|) - the most
+ *	that can still be ramped back to zero as the velocity arrives - and changes by at most
+ *	J*dt per segment. Commands are clamped to the axis velocity_max.
+ *
+ *	When soft limits apply to an axis it brakes on its own: the command toward a limit is
+ *	forced to zero once the stopping distance from the current velocity, plus a segment of
+ *	margin, reaches the limit. A feedhold zeroes every command the same way. The jog ends
+ *	when all axes have stopped with a zero command.
+ *
+ *	Like all exec functions this runs from the LO interrupt and preps exactly one segment.
+ */
+
+stat_t mp_jog_velocity()
+{
+	mpBuf_t *bf;
+
+	if ((bf = mp_get_write_buffer()) == NULL) return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));
+	bf->bf_func = _exec_jog;
+	mp_commit_write_buffer(MOVE_TYPE_JOG);
+	return (STAT_OK);
+}
+
+static float _jog_stopping_distance(float velocity, float jerk)
+{
+	float v = fabs(velocity);
+	if (jerk <= 0) { return (0);}
+	return (v * sqrt(v / jerk) + v * mr.segment_time);
+}
+
+static stat_t _exec_jog(mpBuf_t *bf)
+{
+	if (bf->move_state == MOVE_NEW) {
+		bf->move_state = MOVE_RUN;
+		mr.move_state = MOVE_RUN;
+		mr.segment_time = NOM_SEGMENT_TIME;
+		clear_vector(mr.jog_velocity);
+		clear_vector(mr.jog_accel);
+		cm_set_motion_state(MOTION_RUN);
+	}
+	float dt = mr.segment_time;
+	float speed = 0;
+	uint8_t moving = false;
+
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		float jerk = cm.a[axis].jerk_max * JERK_MULTIPLIER;
+		float v = mr.jog_velocity[axis];
+		float a = mr.jog_accel[axis];
+		float command = 0;
+
+		if ((cm.hold_state == FEEDHOLD_OFF) && (jerk > 0)) {
+			command = cm.jog_velocity[axis];
+			if (command > cm.a[axis].velocity_max) { command = cm.a[axis].velocity_max;}
+			if (command < -cm.a[axis].velocity_max) { command = -cm.a[axis].velocity_max;}
+		}
+		if ((cm.soft_limit_enable == true) && (cm.homed[axis] == true) &&
+			(fp_NE(cm.a[axis].travel_min, cm.a[axis].travel_max)) &&
+			(fabs(cm.a[axis].travel_min) <= DISABLE_SOFT_LIMIT) &&
+			(fabs(cm.a[axis].travel_max) <= DISABLE_SOFT_LIMIT)) {
+			float stop = _jog_stopping_distance(v, jerk);
+			if ((command > 0) && (mr.position[axis] + stop >= cm.a[axis].travel_max)) { command = 0;}
+			if ((command < 0) && (mr.position[axis] - stop <= cm.a[axis].travel_min)) { command = 0;}
+		}
+
+		// jerk limited tracking of the command
+		float dv = command - v;
+		float a_target = copysign(sqrt(2 * jerk * fabs(dv)), dv);
+		float da = jerk * dt;
+		if (a < a_target - da) { a += da;}
+		else if (a > a_target + da) { a -= da;}
+		else { a = a_target;}
+		float v_next = v + a * dt;
+		if ((command - v_next) * dv <= 0) {				// arrived at (or passed) the command
+			v_next = command;
+			a = 0;
+		}
+		mr.gm.target[axis] = mr.position[axis] + (v + v_next) / 2 * dt;
+		mr.jog_velocity[axis] = v_next;
+		mr.jog_accel[axis] = a;
+		speed += square(v_next);
+		if (fp_NOT_ZERO(v_next) || fp_NOT_ZERO(command)) { moving = true;}
+	}
+	mr.segment_velocity = sqrt(speed);
+	ritorno(_exec_segment_steps());
+	if (moving == true) return (STAT_EAGAIN);
+
+	mr.move_state = MOVE_OFF;
+	mr.segment_velocity = 0;
+	if (mp_free_run_buffer()) cm_cycle_end();			// free buffer & end cycle if planner is empty
+	return (STAT_OK);
+}
+
+/*************************************************************************
+ * mp_exec_traverse() 		  - run one segment of a dogleg rapid
+ * _traverse_axis_position() - distance an axis has travelled at a profile time
+ *
+ *	Each axis follows the S-curve set up by mp_get_traverse_time(): jerk J up to the peak
+ *	velocity V in Ta, cruise, then the mirror image down to rest at its own axis time T.
+ *	While accelerating, with h = Ta/2:
+ *
+ *		t <= h:		x = J*t^3/6
+ *		t > h:		x = J*h^3/6 + J*h^2*u/2 + J*h*u^2/2 - J*u^3/6		where u = t-h
+ *
+ *	A feedhold slows the profile time instead of the axes: the rate profile time advances at
+ *	falls from 1 to 0 along a smoothstep over the longest accel time of the moving axes, so
+ *	every axis stays on its own path and slows down in proportion. Once the rate reaches 0
+ *	the hold takes effect, and a cycle start ramps the rate back up. If the profile ends
+ *	first the hold takes effect at the end of the rapid.
+ *
+ *	Like all exec functions this runs from the LO interrupt and preps exactly one segment.
+ */
+
+stat_t mp_exec_traverse(mpBuf_t *bf)
+{
+	if (bf->move_state == MOVE_OFF) return (STAT_NOOP);
+
+	if (mr.move_state == MOVE_OFF) {
+		if ((cm.hold_state != FEEDHOLD_OFF) && (cm.hold_state < FEEDHOLD_HOLD)) {	// also a hold the last feed caught
+			mp_start_hold();
+			return (STAT_NOOP);							// stops here if holding
+		}
+		if (bf->move_state == MOVE_NEW) {				// set up the axis profiles
+			memcpy(&mr.gm, &(bf->gm), sizeof(GCodeState_t));
+			bf->replannable = false;
+			copy_vector(mr.traverse_start, mr.position);
+			copy_vector(mr.target, bf->gm.target);
+			mr.traverse_ramp_time = 0;
+			for (uint8_t axis=0; axis<AXES; axis++) {
+				mr.traverse_length[axis] = mr.target[axis] - mr.traverse_start[axis];
+				mr.traverse_axis_time[axis] = mp_get_traverse_time(axis, mr.traverse_length[axis], &mr.traverse_velocity[axis]);
+				mr.traverse_accel_time[axis] = 0;
+				if (mr.traverse_velocity[axis] > 0) {
+					mr.traverse_accel_time[axis] = 2 * sqrt(mr.traverse_velocity[axis] / (cm.a[axis].jerk_max * JERK_MULTIPLIER));
+				}
+				mr.traverse_ramp_time = max(mr.traverse_ramp_time, mr.traverse_accel_time[axis]);
+			}
+			mr.traverse_move_time = bf->gm.move_time;
+			mr.traverse_time = 0;
+			mr.traverse_rate = 1;						// the profiles start from rest
+			mr.traverse_rate_target = 1;
+			mr.segment_time = mr.traverse_move_time / ceil(mr.traverse_move_time / NOM_SEGMENT_TIME);
+			bf->move_state = MOVE_RUN;
+			for (uint8_t i=0; i<bf->attached_count; i++) {	// run attached commands with the first segment
+				st_prep_attached_command(bf->attached[i].func, bf->attached[i].value);
+			}
+		} else {										// resuming after a feedhold
+			mr.traverse_rate_start = mr.traverse_rate;
+			mr.traverse_rate_target = 1;
+			mr.traverse_ramp_elapsed = 0;
+		}
+		mr.move_state = MOVE_RUN;
+	}
+
+	// catch a feedhold and start slowing down. A hold the previous feed moved on to PLAN or
+	// DECEL in its last segment is ours too - mp_plan_hold_callback() leaves rapids alone
+	if (((cm.hold_state == FEEDHOLD_SYNC) || (cm.hold_state == FEEDHOLD_PLAN) || (cm.hold_state == FEEDHOLD_DECEL)) &&
+		(mr.traverse_rate_target > 0)) {
+		cm.hold_state = FEEDHOLD_DECEL;
+		mr.traverse_rate_start = mr.traverse_rate;
+		mr.traverse_rate_target = 0;
+		mr.traverse_ramp_elapsed = 0;
+	}
+
+	// advance the profile time
+	float rate = mr.traverse_rate_target;
+	if (fp_NE(mr.traverse_rate, mr.traverse_rate_target)) {
+		mr.traverse_ramp_elapsed += mr.segment_time;
+		float u = min(mr.traverse_ramp_elapsed / mr.traverse_ramp_time, 1);
+		rate = mr.traverse_rate_start + (mr.traverse_rate_target - mr.traverse_rate_start) * square(u) * (3 - 2*u);
+		if (u >= 1) { rate = mr.traverse_rate_target;}
+	}
+	mr.traverse_time += (mr.traverse_rate + rate) / 2 * mr.segment_time;
+	mr.traverse_rate = rate;
+	if (mr.traverse_time > mr.traverse_move_time) { mr.traverse_time = mr.traverse_move_time;}
+
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		mr.gm.target[axis] = mr.traverse_start[axis] +
+			copysign(_traverse_axis_position(axis, mr.traverse_time), mr.traverse_length[axis]);
+	}
+	mr.segment_velocity = get_axis_vector_length(mr.gm.target, mr.position) / mr.segment_time;
+	ritorno(_exec_segment_steps());
+
+	if (mr.traverse_time < mr.traverse_move_time) {
+		if (fp_ZERO(mr.traverse_rate) && (cm.hold_state == FEEDHOLD_DECEL)) {	// stopped for a feedhold
+			mr.move_state = MOVE_OFF;
+			mr.segment_velocity = 0;
+			cm.hold_state = FEEDHOLD_READY_TO_HOLD;
+		}
+		sr_request_status_report(SR_REQUEST_TIMED);
+		return (STAT_EAGAIN);
+	}
+
+	// the slowest axis has arrived
+	mr.move_state = MOVE_OFF;
+	mr.segment_velocity = 0;
+	if (bf->nx->move_state == MOVE_NEW)
+		bf->nx->replannable = false;					// prevent overplanning (see mp_exec_aline())
+	if (cm.hold_state == FEEDHOLD_DECEL) { mp_start_hold();}
+	if (mp_free_run_buffer() && cm.hold_state == FEEDHOLD_OFF)
+		cm_cycle_end();									// free buffer & end cycle if planner is empty
+	return (STAT_OK);
+}
+
+static float _traverse_axis_position(uint8_t axis, float time)
+{
+	float D = fabs(mr.traverse_length[axis]);
+	float T = mr.traverse_axis_time[axis];
+	float Ta = mr.traverse_accel_time[axis];
+	if (time >= T) { return (D);}
+
+	float V = mr.traverse_velocity[axis];
+	float t = time;
+	float x_offset = 0;
+	float x_sign = 1;
+	if (t > T - Ta) {									// decelerating - mirror of the acceleration
+		t = T - t;
+		x_offset = D;
+		x_sign = -1;
+	} else if (t > Ta) {								// cruising
+		return (V * Ta / 2 + V * (t - Ta));
+	}
+	float J = cm.a[axis].jerk_max * JERK_MULTIPLIER;
+	float h = Ta / 2;
+	float x;
+	if (t <= h) {
+		x = J * t*t*t / 6;
+	} else {
+		float u = t - h;
+		x = J * h*h*h / 6 + J * h*h * u / 2 + J * h * u*u / 2 - J * u*u*u / 6;
+	}
+	return (x_offset + x_sign * x);
 }
@@ -31,6 +31,7 @@
 #include "canonical_machine.h"
 #include "planner.h"
 #include "stepper.h"
+#include "kinematics.h"
 #include "report.h"
 #include "util.h"
 #include "spindle.h"
@@ -39,7 +40,10 @@
 static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const float axis_square[]);
 static void _plan_block_list(mpBuf_t *bf, uint8_t *mr_flag);
 static float _get_junction_vmax(const float a_unit[], const float b_unit[]);
+static float _get_junction_vmax_jerk(const float a_unit[], const float b_unit[]);
 static void _reset_replannable_list(void);
+static void _spline_tangent(const float coeff[][2], float t, float unit[]);
+static float _spline_curvature(const float coeff[][2], float length);
 
 /* Runtime-specific setters and getters
  *
@@ -66,7 +70,8 @@ float mp_get_runtime_work_position(uint8_t axis) { return (mr.position[axis] - m
 
 uint8_t mp_get_runtime_busy()
 {
-	if ((st_runtime_isbusy() == true) || (mr.move_state == MOVE_RUN)) return (true);
+	if ((st_runtime_isbusy() == true) || (mr.move_state == MOVE_RUN) ||
+		(mr.shaper_settle_time > 0)) return (true);				// input shaper still catching up
 	return (false);
 }
 
@@ -93,6 +98,15 @@ stat_t mp_aline(GCodeState_t *gm_in)
 	float junction_velocity;
 	uint8_t mr_flag = false;
 
+	// hold the line in the parse-ahead queue if the planner is full or other blocks are waiting
+	if (mp_parse_ahead_defer() == true) {
+		mpParseAheadEntry_t *e;
+		if ((e = mp_get_parse_ahead_entry()) == NULL) return (STAT_BUFFER_FULL_FATAL);
+		e->move_type = MOVE_TYPE_ALINE;
+		memcpy(&e->gm, gm_in, sizeof(GCodeState_t));
+		return (STAT_OK);
+	}
+
 	// compute some reused terms
 	float axis_length[AXES];
 	float axis_square[AXES];
@@ -110,6 +124,7 @@ stat_t mp_aline(GCodeState_t *gm_in)
 //	if (fp_ZERO(axis_length[AXIS_X]) && fp_ZERO(axis_length[AXIS_Y]) && fp_ZERO(axis_length[AXIS_Z]) &&
 //		fp_ZERO(axis_length[AXIS_A]) && fp_ZERO(axis_length[AXIS_B]) && fp_ZERO(axis_length[AXIS_C])) {
 		sr_request_status_report(SR_REQUEST_IMMEDIATE_FULL);
+		mp_free_raster_line(gm_in->raster);
 		return (STAT_MINIMUM_LENGTH_MOVE);
 	}
 
@@ -122,6 +137,8 @@ stat_t mp_aline(GCodeState_t *gm_in)
 	//	(3) Previous block is not optimally planned. Vi <= previous block's entry_velocity + delta_velocity
 
 	_calc_move_times(gm_in, axis_length, axis_square);						// set move time and minimum time in the state
+	gm_in->move_time = max(gm_in->move_time,								// slow down for the joints - see ik_joint_move_time()
+		ik_joint_move_time(mm.position, gm_in->target, (gm_in->motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE)));
 
 	if (gm_in->move_time < MIN_BLOCK_TIME) {
 /*		float delta_velocity = pow(length, 0.66666666) * mm.cbrt_jerk;		// max velocity change for this move - uses jerk from previous move
@@ -137,6 +154,7 @@ stat_t mp_aline(GCodeState_t *gm_in)
 		if (move_time < MIN_BLOCK_TIME) {
 			sr_request_status_report(SR_REQUEST_IMMEDIATE_FULL);
 */
+			mp_free_raster_line(gm_in->raster);
 			return (STAT_MINIMUM_TIME_MOVE);
 //		}
 	}
@@ -150,80 +168,41 @@ stat_t mp_aline(GCodeState_t *gm_in)
 	memcpy(&bf->gm, gm_in, sizeof(GCodeState_t));						// copy model state into planner buffer
 
 	// Compute the unit vector and find the right jerk to use (combined operations)
-	// To determine the jerk value to use for the block we want to find the axis for which
-	// the jerk cannot be exceeded - the 'jerk-limit' axis. This is the axis for which
-	// the time to decelerate from the target velocity to zero would be the longest.
-	//
-	//	We can determine the "longest" deceleration in terms of time or distance.
-	//
-	//  The math for time-to-decelerate T from speed S to speed E with constant
-	//  jerk J is:
-	//
-	//		T = 2*sqrt((S-E)/J[n])
-	//
-	//	Since E is always zero in this calculation, we can simplify:
-	//		T = 2*sqrt(S/J[n])
-	//
-	//	The math for distance-to-decelerate l from speed S to speed E with constant
-	//  jerk J is:
-	//
-	//		l = (S+E)*sqrt((S-E)/J)
-	//
-	//	Since E is always zero in this calculation, we can simplify:
-	//		l = S*sqrt(S/J)
+	// The move is planned as a single S-curve along its length. Each axis sees the path jerk
+	// scaled by its unit vector term, so axis n stays within its limit as long as:
 	//
-	//  The final value we want is to know which one is *longest*, compared to the others,
-	//	so we don't need the actual value. This means that the scale of the value doesn't
-	//	matter, so for T we can remove the "2 *" and For L we can remove the "S*".
-	//	This leaves both to be simply "sqrt(S/J)". Since we don't need the scale,
-	//	it doesn't matter what speed we're coming from, so S can be replaced with 1.
+	//		J * |U[n]| <= J[n]		or		J <= J[n] / |U[n]|
 	//
-	//  However, we *do* need to compensate for the fact that each axis contributes
-	//	differently to the move, so we will scale each contribution C[n] by the
-	//	proportion of the axis movement length D[n] to the total length of the move L.
-	//	Using that, we construct the following, with these definitions:
+	//		J	 = jerk along the path, in the units of the move length
+	//		J[n] = max_jerk for axis n, in its own units (mm or degrees)
+	//		U[n] = unit vector term for axis n
 	//
-	//		J[n] = max_jerk for axis n
-	//		D[n] = distance traveled for this move for axis n
-	//		L = total length of the move in all axes
-	//		C[n] = "axis contribution" of axis n
+	// The path jerk is the smallest of these over all the axes in the move, so every axis
+	// runs at or below its own limit and one of them runs right at it - the 'jerk-limit' axis.
+	// Rotary axes take part the same way; their unit vector terms are in degrees of the
+	// combined length, so a degree-per-min^3 limit is honored directly.
 	//
-	// For each axis n: C[n] = sqrt(1/J[n]) * (D[n]/L)
+	// We already have 1/J[n] for each axis, so the limiting axis is the one with the largest
+	//		C[n] = |U[n]| / J[n]
+	// and the path jerk is 1/C[n] for that axis.
 	//
-	//	Keeping in mind that we only need a rank compared to the other axes, we can further
-	//	optimize the calculations::
-	//
-	//	Square the expression to remove the square root:
-	//		C[n]^2 = (1/J[n]) * (D[n]/L)^2	(We don't care the C is squared, we'll use it that way.)
-	//
-	//	Re-arranged to optimize divides for pre-calculated values, we create a value
-	//  M that we compute once:
-	//		M = (1/(L^2))
-	//  Then we use it in the calculations for every axis:
-	//		C[n] = (1/J[n]) * D[n]^2 * M
-	//
-	//  Also note that we already have (1/J[n]) calculated for each axis, which simplifies it further.
-	//
-	// Finally, the selected jerk term needs to be scaled by the reciprocal of the absolute value
-	// of the jerk-limit axis's unit vector term. This way when the move is finally decomposed into
-	// its constituent axes for execution the jerk for that axis will be at it's maximum value.
+	// Velocity limits are handled the same way per axis in _calc_move_times(), which scales
+	// every participating axis's length by its own velocity or feed rate maximum.
 
-	float C;					// contribution term. C = T * a
+	float C;					// contribution term. C = |U[n]| / J[n]
 	float maxC = 0;
-	float recip_L2 = 1/length_square;
 
 	for (uint8_t axis=0; axis<AXES; axis++) {
 		if (fp_NOT_ZERO(axis_length[axis])) {
 			bf->unit[axis] = axis_length[axis] / bf->length;			// compute unit vector term (zeros are already zero)
-			C = axis_square[axis] * recip_L2 * cm.a[axis].recip_jerk;	// squaring axis_length ensures it's positive
+			C = fabs(bf->unit[axis]) * cm.a[axis].recip_jerk;
 			if (C > maxC) {
 				maxC = C;
-				bf->jerk_axis = axis;									// also needed for junction vmax calculation
+				bf->jerk_axis = axis;
 			}
 		}
 	}
 	// set up and pre-compute the jerk terms needed for this round of planning
-//	bf->jerk = cm.a[bf->jerk_axis].recip_jerk * fabs(bf->unit[bf->jerk_axis]);// scale the jerk
 	bf->jerk = cm.a[bf->jerk_axis].jerk_max * JERK_MULTIPLIER / fabs(bf->unit[bf->jerk_axis]);	// scale the jerk
 
 	if (fabs(bf->jerk - mm.jerk) > JERK_MATCH_TOLERANCE) {	// specialized comparison for tolerance of delta
@@ -241,6 +220,207 @@ stat_t mp_aline(GCodeState_t *gm_in)
 	}
 	bf->cruise_vmax = bf->length / bf->gm.move_time;		// target velocity requested
 	junction_velocity = _get_junction_vmax(bf->pv->unit, bf->unit);
+	if (bf->pv->move_type == MOVE_TYPE_TRAVERSE) { junction_velocity = 0;}	// dogleg rapids end at rest
+	bf->entry_vmax = min3(bf->cruise_vmax, junction_velocity, exact_stop);
+	bf->delta_vmax = mp_get_target_velocity(0, bf->length, bf);
+	bf->exit_vmax = min3(bf->cruise_vmax, (bf->entry_vmax + bf->delta_vmax), exact_stop);
+	bf->braking_velocity = bf->delta_vmax;
+
+	// Note: these next lines must remain in exact order. Position must update before committing the buffer.
+	_plan_block_list(bf, &mr_flag);				// replan block list
+	copy_vector(mm.position, bf->gm.target);	// set the planner position
+	mp_attach_commands(bf);						// carry any waiting S words, coolant, etc.
+	mp_commit_write_buffer(MOVE_TYPE_ALINE); 	// commit current block (must follow the position update)
+	return (STAT_OK);
+}
+
+/****************************************************************************************
+ * mp_traverse() 		  - plan a non-coordinated (dogleg) rapid
+ * mp_get_traverse_time() - time and peak velocity of one axis of a dogleg rapid
+ *
+ *	A dogleg rapid is a single block that starts and ends at rest. Each axis runs its own
+ *	jerk limited S-curve to its velocity_max - or to the highest velocity it can reach in
+ *	the distance - independently of the others, so the block takes as long as the slowest
+ *	axis and the faster axes arrive early. The path is not a straight line. The block joins
+ *	neither the move before nor the one after: it is never replanned and the lines on
+ *	either side of it stop there. See mp_exec_traverse() for the runtime.
+ *
+ *	An axis that accelerates at its jerk limit J until it reaches velocity V covers
+ *	V*sqrt(V/J) and takes Ta = 2*sqrt(V/J), and decelerating mirrors it. If the axis is
+ *	shorter than twice that distance the peak is where acceleration and deceleration meet: V = (D*sqrt(J)/2)^(2/3). Either
+ *	way the axis time is Ta + D/V.
+ */
+
+stat_t mp_traverse(GCodeState_t *gm_in)
+{
+	mpBuf_t *bf;
+
+	// hold the rapid in the parse-ahead queue if the planner is full or other blocks are waiting
+	if (mp_parse_ahead_defer() == true) {
+		mpParseAheadEntry_t *e;
+		if ((e = mp_get_parse_ahead_entry()) == NULL) return (STAT_BUFFER_FULL_FATAL);
+		e->move_type = MOVE_TYPE_TRAVERSE;
+		memcpy(&e->gm, gm_in, sizeof(GCodeState_t));
+		return (STAT_OK);
+	}
+
+	float axis_length[AXES];
+	float length_square = 0;
+	float move_time = 0;
+	float velocity;
+
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		axis_length[axis] = gm_in->target[axis] - mm.position[axis];
+		length_square += square(axis_length[axis]);
+		move_time = max(move_time, mp_get_traverse_time(axis, axis_length[axis], &velocity));
+	}
+	float length = sqrt(length_square);
+
+	if (fp_ZERO(length)) {
+		sr_request_status_report(SR_REQUEST_IMMEDIATE_FULL);
+		return (STAT_MINIMUM_LENGTH_MOVE);
+	}
+	if (move_time < MIN_BLOCK_TIME) {
+		return (STAT_MINIMUM_TIME_MOVE);
+	}
+	gm_in->move_time = move_time;
+	gm_in->minimum_time = move_time;
+
+	if ((bf = mp_get_write_buffer()) == NULL) {							// never supposed to fail
+		return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));
+	}
+	bf->bf_func = mp_exec_traverse;
+	memcpy(&bf->gm, gm_in, sizeof(GCodeState_t));
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		bf->unit[axis] = axis_length[axis] / length;					// only used to wake the motors (mp_commit_write_buffer())
+	}
+	// the block is left with zero length and velocities, so the lines around it plan to a stop
+
+	copy_vector(mm.position, bf->gm.target);	// set the planner position
+	mp_attach_commands(bf);						// carry any waiting S words, coolant, etc.
+	mp_commit_write_buffer(MOVE_TYPE_TRAVERSE);	// commit current block (must follow the position update)
+	return (STAT_OK);
+}
+
+float mp_get_traverse_time(uint8_t axis, float length, float *velocity)
+{
+	float D = fabs(length);
+	if (fp_ZERO(D)) {
+		*velocity = 0;
+		return (0);
+	}
+	float J = cm.a[axis].jerk_max * JERK_MULTIPLIER;
+	float V = cm.a[axis].velocity_max;
+	if (D < 2 * V * sqrt(V / J)) {					// too short to reach velocity_max
+		V = cbrt(square(D * sqrt(J) / 2));
+	}
+	*velocity = V;
+	return (2 * sqrt(V / J) + D / V);
+}
+
+/****************************************************************************************
+ * mp_spline() - plan a G5/G5.1 spline as a single block
+ *
+ *	The curve is a cubic Bezier from the planner position through the two control points in
+ *	the gcode state to the target (see cm_spline_feed()). It is planned exactly like a line
+ *	whose length is the curve length, so the lookahead, feedholds and the S-curve profiles
+ *	all work on distance along the curve. The runtime turns that distance back into points
+ *	on the curve for each segment (see mp_exec_aline()).
+ *
+ *	The cruise velocity is also limited by the tightest bend in the curve, where R is the
+ *	smallest radius of curvature:
+ *
+ *	  - centripetal acceleration: V <= sqrt(junction_acceleration * R), the same limit
+ *		that is used for the corners between moves
+ *	  - chordal error: a segment of length L cuts the bend by L^2 / 8R, so the segments
+ *		stay within the chordal tolerance as long as V <= sqrt(8 * chordal_tolerance * R) / T
+ *		where T is the nominal segment time
+ *
+ *	The junction with the previous move uses the direction the curve starts in, and the
+ *	block's unit vector is left at the direction it ends in for the next junction. Splines
+ *	only run in XY, so the path jerk is the smaller of the X and Y jerks.
+ */
+
+stat_t mp_spline(GCodeState_t *gm_in)
+{
+	mpBuf_t *bf; 						// current move pointer
+	float exact_stop = 0;				// preset this value OFF
+	float junction_velocity;
+	uint8_t mr_flag = false;
+
+	// hold the curve in the parse-ahead queue if the planner is full or other blocks are waiting
+	if (mp_parse_ahead_defer() == true) {
+		mpParseAheadEntry_t *e;
+		if ((e = mp_get_parse_ahead_entry()) == NULL) return (STAT_BUFFER_FULL_FATAL);
+		e->move_type = MOVE_TYPE_ALINE;
+		memcpy(&e->gm, gm_in, sizeof(GCodeState_t));
+		return (STAT_OK);
+	}
+
+	float origin[2] = { mm.position[AXIS_X], mm.position[AXIS_Y] };
+	float coeff[3][2];
+	mp_spline_coefficients(origin, gm_in, coeff);
+
+	float length = 0;
+	for (uint8_t i=0; i<SPLINE_LENGTH_PIECES; i++) {
+		length += mp_spline_length(coeff, (float)i / SPLINE_LENGTH_PIECES, (float)(i+1) / SPLINE_LENGTH_PIECES);
+	}
+	if (fp_ZERO(length)) {
+		sr_request_status_report(SR_REQUEST_IMMEDIATE_FULL);
+		return (STAT_MINIMUM_LENGTH_MOVE);
+	}
+
+	// move times - see _calc_move_times() for the straight line equivalent
+	float feedrate_max = min(cm.a[AXIS_X].feedrate_max, cm.a[AXIS_Y].feedrate_max);
+	gm_in->minimum_time = length / feedrate_max;
+	if (gm_in->feed_rate_mode == INVERSE_TIME_MODE) {
+		gm_in->move_time = gm_in->feed_rate;	// NB: feed rate was un-inverted to minutes by cm_set_feed_rate()
+		gm_in->feed_rate_mode = UNITS_PER_MINUTE_MODE;
+	} else {
+		gm_in->move_time = length / gm_in->feed_rate;
+	}
+	gm_in->move_time = max3(gm_in->move_time, gm_in->minimum_time,
+		ik_joint_move_time(mm.position, gm_in->target, false));
+	if (gm_in->move_time < MIN_BLOCK_TIME) {
+		return (STAT_MINIMUM_TIME_MOVE);
+	}
+
+	// get a cleared buffer and setup move variables
+	if ((bf = mp_get_write_buffer()) == NULL) {							// never supposed to fail
+		return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));
+	}
+	bf->bf_func = mp_exec_aline;
+	bf->length = length;
+	bf->spline_origin[0] = origin[0];
+	bf->spline_origin[1] = origin[1];
+	bf->spline_start = 0;
+	bf->spline_length = length;
+	memcpy(&bf->gm, gm_in, sizeof(GCodeState_t));
+
+	bf->jerk_axis = (cm.a[AXIS_X].jerk_max <= cm.a[AXIS_Y].jerk_max) ? AXIS_X : AXIS_Y;
+	bf->jerk = cm.a[bf->jerk_axis].jerk_max * JERK_MULTIPLIER;
+	if (fabs(bf->jerk - mm.jerk) > JERK_MATCH_TOLERANCE) {
+		mm.jerk = bf->jerk;
+		mm.recip_jerk = 1/bf->jerk;
+		mm.cbrt_jerk = cbrt(bf->jerk);
+	}
+	bf->recip_jerk = mm.recip_jerk;
+	bf->cbrt_jerk = mm.cbrt_jerk;
+
+	if (cm_get_path_control(MODEL) != PATH_EXACT_STOP) {
+		bf->replannable = true;
+		exact_stop = 8675309;
+	}
+	bf->cruise_vmax = bf->length / bf->gm.move_time;
+	float curvature = _spline_curvature(coeff, length);
+	if (curvature > 0) {
+		bf->cruise_vmax = min3(bf->cruise_vmax, sqrt(cm.junction_acceleration / curvature),
+							   sqrt(8 * cm.chordal_tolerance / curvature) / NOM_SEGMENT_TIME);
+	}
+	_spline_tangent(coeff, 0, bf->unit);								// junction on the way in...
+	junction_velocity = _get_junction_vmax(bf->pv->unit, bf->unit);
+	if (bf->pv->move_type == MOVE_TYPE_TRAVERSE) { junction_velocity = 0;}
+	_spline_tangent(coeff, 1, bf->unit);								// ...and the next one on the way out
 	bf->entry_vmax = min3(bf->cruise_vmax, junction_velocity, exact_stop);
 	bf->delta_vmax = mp_get_target_velocity(0, bf->length, bf);
 	bf->exit_vmax = min3(bf->cruise_vmax, (bf->entry_vmax + bf->delta_vmax), exact_stop);
@@ -249,10 +429,81 @@ stat_t mp_aline(GCodeState_t *gm_in)
 	// Note: these next lines must remain in exact order. Position must update before committing the buffer.
 	_plan_block_list(bf, &mr_flag);				// replan block list
 	copy_vector(mm.position, bf->gm.target);	// set the planner position
+	mp_attach_commands(bf);						// carry any waiting S words, coolant, etc.
 	mp_commit_write_buffer(MOVE_TYPE_ALINE); 	// commit current block (must follow the position update)
 	return (STAT_OK);
 }
 
+/*
+ * mp_spline_coefficients() - polynomial form of a spline: B(t) = origin + c[0]*t + c[1]*t^2 + c[2]*t^3
+ * mp_spline_speed()		- |dB/dt| at t
+ * mp_spline_length()		- curve length from t0 to t1 (3 point Gauss-Legendre); negative if t1 < t0
+ * _spline_tangent()		- unit vector of the direction of travel at t
+ * _spline_curvature()		- largest curvature (1/radius) along the curve
+ */
+
+void mp_spline_coefficients(const float origin[], const GCodeState_t *gm, float coeff[][2])
+{
+	for (uint8_t i=0; i<2; i++) {
+		float p1 = gm->spline[0][i] - origin[i];				// control points relative to the start
+		float p2 = gm->spline[1][i] - origin[i];
+		float p3 = gm->target[i] - origin[i];
+		coeff[0][i] = 3 * p1;
+		coeff[1][i] = 3 * (p2 - 2*p1);
+		coeff[2][i] = p3 + 3 * (p1 - p2);
+	}
+}
+
+float mp_spline_speed(const float coeff[][2], float t)
+{
+	float dx = (3*coeff[2][0] * t + 2*coeff[1][0]) * t + coeff[0][0];
+	float dy = (3*coeff[2][1] * t + 2*coeff[1][1]) * t + coeff[0][1];
+	return (sqrt(dx*dx + dy*dy));
+}
+
+float mp_spline_length(const float coeff[][2], float t0, float t1)
+{
+	float half = (t1 - t0) / 2;
+	float mid = (t0 + t1) / 2;
+	float node = half * 0.774596669;							// sqrt(3/5)
+	return (half * ((mp_spline_speed(coeff, mid - node) + mp_spline_speed(coeff, mid + node)) * 5/9 +
+					 mp_spline_speed(coeff, mid) * 8/9));
+}
+
+static void _spline_tangent(const float coeff[][2], float t, float unit[])
+{
+	float d[2];
+	for (uint8_t i=0; i<2; i++) {
+		d[i] = (3*coeff[2][i] * t + 2*coeff[1][i]) * t + coeff[0][i];
+	}
+	if (fp_ZERO(d[0]) && fp_ZERO(d[1])) {						// a control point on the end point
+		for (uint8_t i=0; i<2; i++) {							// the curve leaves along the 2nd derivative
+			d[i] = (6*coeff[2][i] * t + 2*coeff[1][i]) * ((t > 0.5) ? -1 : 1);
+		}
+	}
+	float length = sqrt(d[0]*d[0] + d[1]*d[1]);
+	for (uint8_t axis=0; axis<AXES; axis++) { unit[axis] = 0;}
+	if (fp_ZERO(length)) return;
+	unit[AXIS_X] = d[0] / length;
+	unit[AXIS_Y] = d[1] / length;
+}
+
+static float _spline_curvature(const float coeff[][2], float length)
+{
+	float curvature = 0;
+	for (uint8_t i=0; i<=SPLINE_CURVATURE_SAMPLES; i++) {
+		float t = (float)i / SPLINE_CURVATURE_SAMPLES;
+		float dx = (3*coeff[2][0] * t + 2*coeff[1][0]) * t + coeff[0][0];
+		float dy = (3*coeff[2][1] * t + 2*coeff[1][1]) * t + coeff[0][1];
+		float ddx = 6*coeff[2][0] * t + 2*coeff[1][0];
+		float ddy = 6*coeff[2][1] * t + 2*coeff[1][1];
+		float speed = sqrt(dx*dx + dy*dy);
+		if (speed < length / 100) continue;						// skip where a control point sits on an end point
+		curvature = max(curvature, fabs(dx*ddy - dy*ddx) / (speed * speed * speed));
+	}
+	return (curvature);
+}
+
 /***** ALINE HELPERS *****
  * _calc_move_times()
  * _plan_block_list()
@@ -549,6 +800,7 @@ static float _get_junction_vmax(const float a_unit[], const float b_unit[])
 
 	if (costheta < -0.99) { return (10000000); } 		// straight line cases
 	if (costheta > 0.99)  { return (0); } 				// reversal cases
+	if (cm.junction_model == JUNCTION_MODEL_JERK) { return (_get_junction_vmax_jerk(a_unit, b_unit));}
 
 	// Fuse the junction deviations into a vector sum
 	float a_delta = square(a_unit[AXIS_X] * cm.a[AXIS_X].junction_dev);
@@ -571,6 +823,38 @@ static float _get_junction_vmax(const float a_unit[], const float b_unit[])
 	return(sqrt(radius * cm.junction_acceleration));
 }
 
+/*
+ * _get_junction_vmax_jerk() - jerk model for junction velocity
+ *
+ *	With $jmo=1 the corner speed comes from the axis jerk limits instead (jerk model).
+ *	Passing a corner at velocity V changes axis n's velocity by V * |b[n] - a[n]|. The
+ *	steppers take that change over about the junction time T ($jt). The fastest a
+ *	jerk-limited axis can change velocity in T, starting and ending at zero acceleration,
+ *	is J[n] * T^2 / 4 - jerk up to a peak acceleration for T/2, then back down. So:
+ *
+ *		V <= J[n] * T^2 / (4 * |b[n] - a[n]|)		for every axis n
+ *
+ *	The corner speed then follows the same jerk limits as the rest of the planner, and
+ *	each axis's share of the direction change is weighed by its own jerk. T plays the
+ *	part of junction deviation: longer is faster and rounds corners more. Junction
+ *	deviation and junction acceleration are not used.
+ */
+
+static float _get_junction_vmax_jerk(const float a_unit[], const float b_unit[])
+{
+	float window = cm.junction_time / 60000;				// ms to minutes
+	float factor = JERK_MULTIPLIER * window * window / 4;
+	float vmax = 10000000;
+
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		float dv = fabs(b_unit[axis] - a_unit[axis]);
+		if (dv > EPSILON) {
+			vmax = min(vmax, cm.a[axis].jerk_max * factor / dv);
+		}
+	}
+	return (vmax);
+}
+
 /*************************************************************************
  * feedholds - functions for performing holds
  *
@@ -646,6 +930,7 @@ stat_t mp_plan_hold_callback()
 
 	mpBuf_t *bp; 				// working buffer pointer
 	if ((bp = mp_get_run_buffer()) == NULL) { return (STAT_NOOP);}	// Oops! nothing's running
+	if (bp->move_type == MOVE_TYPE_TRAVERSE) { return (STAT_NOOP);}	// a dogleg rapid ramps its own rate down - see mp_exec_traverse()
 
 	uint8_t mr_flag = true;		// used to tell replan to account for mr buffer Vx
 	float mr_available_length;	// available length left in mr buffer for deceleration
@@ -654,6 +939,9 @@ stat_t mp_plan_hold_callback()
 
 	// examine and process mr buffer
 	mr_available_length = get_axis_vector_length(mr.target, mr.position);
+	if (mp_is_spline(&mr.gm)) {					// splines measure along the curve
+		mr_available_length = mr.spline_waypoint[SECTION_TAIL] - mr.spline_distance;
+	}
 /*
 	mr_available_length =
 		(sqrt(square(mr.endpoint[AXIS_X] - mr.position[AXIS_X]) +
@@ -689,6 +977,7 @@ stat_t mp_plan_hold_callback()
 
 		// re-use bp+0 to be the hold point and to run the remaining block length
 		bp->length = mr_available_length - braking_length;
+		bp->spline_start = mr.spline_distance + braking_length;	// the rest of the curve, if it's a spline
 		bp->delta_vmax = mp_get_target_velocity(0, bp->length, bp);
 		bp->entry_vmax = 0;						// set bp+0 as hold point
 		bp->move_state = MOVE_NEW;				// tell _exec to re-use the bf buffer
@@ -736,6 +1025,7 @@ stat_t mp_plan_hold_callback()
 	bp = mp_get_next_buffer(bp);				// point to the acceleration buffer
 	bp->entry_vmax = 0;
 	bp->length -= braking_length;				// the buffers were identical (and hence their lengths)
+	bp->spline_start += braking_length;			// a spline picks up the curve where the decel ends
 	bp->delta_vmax = mp_get_target_velocity(0, bp->length, bp);
 	bp->exit_vmax = bp->delta_vmax;
 
@@ -747,9 +1037,18 @@ stat_t mp_plan_hold_callback()
 
 /*
  * mp_start_hold() - called from the stepper chain when the hold takes effect
+ *
+ *	With input shaping the axes are still moving after the last segment of the decel,
+ *	so the hold doesn't take effect until the shaper has settled. Until then it waits in
+ *	FEEDHOLD_READY_TO_HOLD while mp_exec_move() runs the settling segments, and is taken
+ *	by the next move's exec or by mp_plan_hold_callback() once the steppers stop.
  */
 stat_t mp_start_hold()
 {
+	if (mr.shaper_settle_time > 0) {
+		cm.hold_state = FEEDHOLD_READY_TO_HOLD;
+		return (STAT_EAGAIN);
+	}
     cm_spindle_control_immediate(SPINDLE_PAUSED | cm.gm.spindle_mode);
     cm.hold_state = FEEDHOLD_HOLD;
     sr_request_status_report(SR_REQUEST_IMMEDIATE);
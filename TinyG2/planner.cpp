@@ -65,15 +65,21 @@
 mpBufferPool_t mb;				// move buffer queue
 mpMoveMasterSingleton_t mm;		// context for line planning
 mpMoveRuntimeSingleton_t mr;	// context for line runtime
+mpParseAheadQueue_t pa;			// parsed blocks waiting for the planner
+static mpRasterLine_t rl[RASTER_LINE_POOL_SIZE];// raster line pixels
 
 /*
  * Local Scope Data and Functions
  */
 #define _bump(a) ((a<PLANNER_BUFFER_POOL_SIZE-1)?(a+1):0) // buffer incr & wrap
+#define _pa_bump(a) ((a<PARSE_AHEAD_QUEUE_SIZE-1)?(a+1):0) // parse-ahead incr & wrap
 #define spindle_speed move_time	// local alias for spindle_speed to the time variable
 #define value_vector gm.target	// alias for vector of values
 #define flag_vector unit		// alias for vector of flags
 
+static void _queue_command(void(*cm_exec)(float[], float[]), float *value, float *flag, uint8_t attach);
+static void _flush_attached_commands(void);
+
 // execution routines (NB: These are all called from the LO interrupt)
 static stat_t _exec_dwell(mpBuf_t *bf);
 static stat_t _exec_command(mpBuf_t *bf);
@@ -93,6 +99,8 @@ void planner_init()
 	memset(&mm, 0, sizeof(mm));	// clear all values, pointers and status
 	planner_init_assertions();
 	mp_init_buffers();
+	mp_init_parse_ahead();
+	mp_init_raster_lines();
 }
 
 /*
@@ -112,11 +120,12 @@ stat_t planner_test_assertions()
 	if ((mm.magic_start  != MAGICNUM) || (mm.magic_end 	 != MAGICNUM)) return (STAT_PLANNER_ASSERTION_FAILURE);
 	if ((mb.magic_start  != MAGICNUM) || (mb.magic_end 	 != MAGICNUM)) return (STAT_PLANNER_ASSERTION_FAILURE);
 	if ((mr.magic_start  != MAGICNUM) || (mr.magic_end 	 != MAGICNUM)) return (STAT_PLANNER_ASSERTION_FAILURE);
+	if ((pa.magic_start  != MAGICNUM) || (pa.magic_end 	 != MAGICNUM)) return (STAT_PLANNER_ASSERTION_FAILURE);
 	return (STAT_OK);
 }
 
 /*
- * mp_flush_planner() - flush all moves in the planner and all arcs
+ * mp_flush_planner() - flush all moves in the planner, the parse-ahead queue, all arcs and drilling cycles
  *
  *	Does not affect the move currently running in mr.
  *	Does not affect mm or gm model positions
@@ -126,7 +135,11 @@ stat_t planner_test_assertions()
 void mp_flush_planner()
 {
 	cm_abort_arc();
+	cm_abort_drilling_cycle();
+	mm.attached_count = 0;
 	mp_init_buffers();
+	mp_init_parse_ahead();
+	mp_init_raster_lines();
 }
 
 /*
@@ -153,12 +166,40 @@ void mp_flush_planner()
  */
 
 void mp_set_planner_position(uint8_t axis, const float position) { mm.position[axis] = position; }
+
+/*
+ * mp_queue_planner_position() - set the planner position of the flagged axes in order
+ *
+ *	The planner position is what the next move is planned from, so a block that sets it
+ *	(G28.3) must not overtake blocks still waiting in the parse-ahead queue. If any are
+ *	waiting the update goes in behind them and is applied as the queue drains to it.
+ */
+
+void mp_queue_planner_position(const float position[], const float flags[])
+{
+	if ((pa.draining == false) && (pa.count > 0)) {
+		mpParseAheadEntry_t *e;
+		if ((e = mp_get_parse_ahead_entry()) == NULL) return;
+		e->move_type = MOVE_TYPE_POSITION;
+		for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+			e->gm.target[axis] = position[axis];
+			e->flags[axis] = flags[axis];
+		}
+		return;
+	}
+	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+		if (fp_TRUE(flags[axis])) { mm.position[axis] = position[axis];}
+	}
+}
 void mp_set_runtime_position(uint8_t axis, const float position) { mr.position[axis] = position; }
 
 void mp_set_steps_to_runtime_position()
 {
 	float step_position[MOTORS];
-	ik_kinematics(mr.position, step_position);				// convert lengths to steps in floating point
+	float position[AXES];									// shaped position - see mp_reset_shaper()
+	mp_reset_shaper(mr.position, position);					// keeps a settle still in progress
+	position[AXIS_Z] += cm_get_grid_offset(position);		// include probing grid Z compensation
+	ik_kinematics(position, step_position);					// convert lengths to steps in floating point
 	for (uint8_t motor = MOTOR_1; motor < MOTORS; motor++) {
 		mr.target_steps[motor] = step_position[motor];
 		mr.position_steps[motor] = step_position[motor];
@@ -171,6 +212,21 @@ void mp_set_steps_to_runtime_position()
 	}
 }
 
+/*
+ * mp_offset_motor_steps() - shift the step position of one motor without moving it
+ *
+ *	The next move then carries the motor the extra steps relative to the other motors.
+ *	Homing uses this to apply the per-motor squaring offsets of a gantry.
+ */
+
+void mp_offset_motor_steps(uint8_t motor, float steps)
+{
+	mr.target_steps[motor] += steps;
+	mr.position_steps[motor] += steps;
+	mr.commanded_steps[motor] += steps;
+	en_set_encoder_steps(motor, mr.position_steps[motor]);
+}
+
 /************************************************************************************
  * mp_queue_command() - queue a synchronous Mcode, program control, or other command
  * _exec_command() 	  - callback to execute command
@@ -193,9 +249,35 @@ void mp_set_steps_to_runtime_position()
  */
 
 void mp_queue_command(void(*cm_exec)(float[], float[]), float *value, float *flag)
+{
+	_queue_command(cm_exec, value, flag, false);
+}
+
+static void _queue_command(void(*cm_exec)(float[], float[]), float *value, float *flag, uint8_t attach)
 {
 	mpBuf_t *bf;
 
+	if (mp_parse_ahead_defer() == true) {				// hold it in order behind other parsed blocks
+		mpParseAheadEntry_t *e;
+		if ((e = mp_get_parse_ahead_entry()) == NULL) return;
+		e->move_type = MOVE_TYPE_COMMAND;
+		e->cm_func = cm_exec;
+		e->attach = attach;
+		for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+			e->gm.target[axis] = value[axis];
+			e->flags[axis] = flag[axis];
+		}
+		return;
+	}
+	if ((attach == true) && (mb.r->buffer_state != MP_BUFFER_EMPTY) &&	// only worth it if moving
+		(mm.attached_count < ATTACHED_COMMANDS_MAX)) {
+		mm.attached[mm.attached_count].func = cm_exec;
+		mm.attached[mm.attached_count].value = value[0];
+		mm.attached_count++;
+		return;
+	}
+	_flush_attached_commands();							// commands run in the order they were given
+
 	// Never supposed to fail as buffer availability was checked upstream in the controller
 	if ((bf = mp_get_write_buffer()) == NULL) {
 		cm_hard_alarm(STAT_BUFFER_FULL_FATAL);
@@ -224,6 +306,58 @@ static stat_t _exec_command(mpBuf_t *bf)
 	return (STAT_OK);
 }
 
+/*
+ * mp_queue_attached_command() - queue a command that doesn't need the machine stopped
+ * mp_attach_commands()		   - hand waiting commands to a move about to be committed
+ * mp_attached_command_callback() - queue waiting commands normally if no move is coming
+ * _flush_attached_commands()  - queue waiting commands as ordinary commands
+ *
+ *	A command queued with mp_queue_command() takes a planner buffer, and the planner treats
+ *	it as a stop - the machine decelerates to zero to run it. Commands that can safely run
+ *	at speed (spindle speed, coolant) are queued here instead. While the machine is moving
+ *	they wait in the planner until the next move is committed and are carried in that move.
+ *	The runtime stages them with the move's first segment and the stepper loader runs them
+ *	as it loads that segment, so they take effect where the move starts without breaking
+ *	the velocity profile. Only value[0] is carried to the callback.
+ *
+ *	Any ordinary command, dwell or stop queued behind them flushes them into the queue
+ *	first so ordering is kept. So does the planner running dry, which runs commands that
+ *	no move followed. With the machine idle they are queued normally.
+ */
+
+void mp_queue_attached_command(void(*cm_exec)(float[], float[]), float *value, float *flag)
+{
+	_queue_command(cm_exec, value, flag, true);
+}
+
+void mp_attach_commands(mpBuf_t *bf)
+{
+	for (uint8_t i=0; i<mm.attached_count; i++) {
+		bf->attached[i] = mm.attached[i];
+	}
+	bf->attached_count = mm.attached_count;
+	mm.attached_count = 0;
+}
+
+stat_t mp_attached_command_callback(void)
+{
+	if ((mm.attached_count == 0) || (pa.count > 0) || (mb.r->buffer_state != MP_BUFFER_EMPTY)) {
+		return (STAT_NOOP);
+	}
+	_flush_attached_commands();
+	return (STAT_OK);
+}
+
+static void _flush_attached_commands()
+{
+	uint8_t count = mm.attached_count;
+	mm.attached_count = 0;								// clear first - queueing calls back in here
+	for (uint8_t i=0; i<count; i++) {
+		float value[AXES] = { mm.attached[i].value, 0,0,0,0,0 };
+		_queue_command(mm.attached[i].func, value, value, false);
+	}
+}
+
 stat_t mp_runtime_command(mpBuf_t *bf)
 {
 	if(bf->move_type == MOVE_TYPE_COMMAND || bf->cm_func != NULL)
@@ -245,6 +379,14 @@ stat_t mp_dwell(float seconds)
 {
 	mpBuf_t *bf;
 
+	if (mp_parse_ahead_defer() == true) {				// hold it in order behind other parsed blocks
+		mpParseAheadEntry_t *e;
+		if ((e = mp_get_parse_ahead_entry()) == NULL) return (STAT_BUFFER_FULL_FATAL);
+		e->move_type = MOVE_TYPE_DWELL;
+		e->gm.move_time = seconds;
+		return (STAT_OK);
+	}
+	_flush_attached_commands();							// run them before the dwell, not after it
 	if ((bf = mp_get_write_buffer()) == NULL) {			// get write buffer or fail
 		return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));	// (not ever supposed to fail)
 	}
@@ -297,6 +439,167 @@ stat_t mp_exec_out_of_band_dwell(void)
 	return _advance_dwell(mr.out_of_band_dwell_time);
 }
 
+/**** PARSE-AHEAD QUEUE ****************************************************************
+ *
+ *	The parse-ahead queue sits between the canonical machine and the planner. When the
+ *	planner pool is full, blocks that would have gone into a planner buffer (lines, dwells
+ *	and queued commands) are captured here instead, already parsed and validated by the
+ *	canonical machine. This lets the controller keep reading and parsing input while the
+ *	planner is saturated rather than blocking in _sync_to_planner(). The queue is drained
+ *	into the planner in order by mp_parse_ahead_callback() as planner buffers free up.
+ *	Once anything is in the queue, all subsequent blocks go through it to preserve order.
+ *
+ *	Control channel commands are dispatched ahead of the callback and are not affected.
+ *	A queue flush or estop clears the queue along with the planner.
+ *
+ * mp_init_parse_ahead()			Initializes or resets the queue
+ * mp_get_parse_ahead_available()	Returns # of free entries in the queue
+ * mp_parse_ahead_defer()			Returns TRUE if a new block must go into the queue
+ * mp_get_parse_ahead_entry()		Get pointer to next free queue entry, or NULL (alarm) if full
+ * mp_parse_ahead_callback()		Moves queued blocks into the planner (main loop)
+ */
+
+void mp_init_parse_ahead(void)
+{
+	memset(&pa, 0, sizeof(pa));
+	pa.magic_start = MAGICNUM;
+	pa.magic_end = MAGICNUM;
+}
+
+uint8_t mp_get_parse_ahead_available(void) { return (PARSE_AHEAD_QUEUE_SIZE - pa.count);}
+
+uint8_t mp_parse_ahead_defer(void)
+{
+	if (pa.draining == true) return (false);
+	return ((pa.count > 0) || (mb.buffers_available == 0));
+}
+
+mpParseAheadEntry_t *mp_get_parse_ahead_entry(void)
+{
+	if (pa.count >= PARSE_AHEAD_QUEUE_SIZE) {		// never supposed to fail - checked upstream in the controller
+		cm_hard_alarm(STAT_BUFFER_FULL_FATAL);
+		return (NULL);
+	}
+	mpParseAheadEntry_t *e = &pa.blk[pa.wr];
+	memset(e, 0, sizeof(mpParseAheadEntry_t));
+	pa.wr = _pa_bump(pa.wr);
+	pa.count++;
+	return (e);
+}
+
+stat_t mp_parse_ahead_callback(void)
+{
+	if (pa.count == 0) return (STAT_NOOP);
+
+	pa.draining = true;
+	while ((pa.count > 0) && (mb.buffers_available > 0)) {
+		mpParseAheadEntry_t *e = &pa.blk[pa.rd];
+		stat_t status = STAT_OK;
+
+		switch (e->move_type) {
+			case MOVE_TYPE_ALINE: { status = (mp_is_spline(&e->gm)) ? mp_spline(&e->gm) : mp_aline(&e->gm); break; }
+			case MOVE_TYPE_TRAVERSE: { status = mp_traverse(&e->gm); break; }
+			case MOVE_TYPE_DWELL: { status = mp_dwell(e->gm.move_time); break; }
+			case MOVE_TYPE_COMMAND: { _queue_command(e->cm_func, e->gm.target, e->flags, e->attach); break; }
+			case MOVE_TYPE_POSITION: { mp_queue_planner_position(e->gm.target, e->flags); break; }
+		}
+		if ((status != STAT_OK) && (status != STAT_MINIMUM_LENGTH_MOVE)) {
+			rpt_exception(status, NULL);
+		}
+		pa.rd = _pa_bump(pa.rd);
+		pa.count--;
+	}
+	pa.draining = false;
+
+	// Canned cycles (homing, probing, jogging) sync to the runtime, so don't let them
+	// run until everything parsed ahead of them has been handed to the planner
+	if ((pa.count > 0) && (cm.cycle_state != CYCLE_OFF) && (cm.cycle_state != CYCLE_MACHINING)) {
+		return (STAT_EAGAIN);
+	}
+	return (STAT_OK);
+}
+
+/*
+ * mp_start_callback() - start motion held by mp_commit_write_buffer()
+ *
+ *	Releases the hold once the first block is no longer replannable (it's optimally
+ *	planned), the planner has filled, or no move has been committed for the holdoff
+ *	time - twice the average gap between moves, see PLANNER_START_HOLDOFF_MIN_MS.
+ */
+
+stat_t mp_start_callback(void)
+{
+	if (mb.start_held == false) return (STAT_NOOP);
+
+	uint32_t holdoff = (uint32_t)(2 * mm.commit_interval);
+	if (holdoff < PLANNER_START_HOLDOFF_MIN_MS) { holdoff = PLANNER_START_HOLDOFF_MIN_MS;}
+	if (holdoff > PLANNER_START_HOLDOFF_MAX_MS) { holdoff = PLANNER_START_HOLDOFF_MAX_MS;}
+
+	if ((mb.r->replannable == false) || (mb.buffers_available < PLANNER_BUFFER_HEADROOM) ||
+		(pa.count > 0) || ((SysTickTimer_getValue() - mm.commit_systick) >= holdoff)) {
+		mb.start_held = false;
+		if (cm.hold_state != FEEDHOLD_HOLD) {
+			st_request_exec_move();
+		}
+	}
+	return (STAT_OK);
+}
+
+/**** RASTER LINES ********************************************************************
+ *
+ *	A raster move carries its pixels in a raster line from this pool. The move's gm.raster
+ *	is the line number + 1, so the pixels follow it through the parse-ahead queue and the
+ *	planner to the runtime. The line is freed when the move's planner buffer is freed, or
+ *	when mp_aline() drops the move. Lines are claimed in the main loop and freed from
+ *	the exec, so the pixel count doubles as the in-use flag and is written last.
+ *
+ * mp_init_raster_lines()			Initializes or resets the pool
+ * mp_get_raster_lines_available()	Returns # of free lines
+ * mp_queue_raster_line()			Copies pixels to a free line, returns the gm.raster value (0 if full)
+ * mp_get_raster_line()				Returns the line for a gm.raster value, or NULL if it has no pixels
+ * mp_free_raster_line()			Frees the line for a gm.raster value (if any)
+ */
+
+void mp_init_raster_lines(void)
+{
+	for (uint8_t i=0; i<RASTER_LINE_POOL_SIZE; i++) {
+		rl[i].count = 0;
+	}
+}
+
+uint8_t mp_get_raster_lines_available(void)
+{
+	uint8_t available = 0;
+	for (uint8_t i=0; i<RASTER_LINE_POOL_SIZE; i++) {
+		if (rl[i].count == 0) { available++;}
+	}
+	return (available);
+}
+
+uint8_t mp_queue_raster_line(const uint8_t pixel[], uint8_t count, float pitch)
+{
+	for (uint8_t i=0; i<RASTER_LINE_POOL_SIZE; i++) {
+		if (rl[i].count != 0) continue;
+		memcpy(rl[i].pixel, pixel, count);
+		rl[i].pitch = pitch;
+		rl[i].count = count;
+		return (i+1);
+	}
+	return (0);
+}
+
+mpRasterLine_t *mp_get_raster_line(uint8_t raster)
+{
+	if ((raster == 0) || (raster > RASTER_LINE_POOL_SIZE)) return (NULL);
+	return (&rl[raster-1]);
+}
+
+void mp_free_raster_line(uint8_t raster)
+{
+	mpRasterLine_t *line;
+	if ((line = mp_get_raster_line(raster)) != NULL) { line->count = 0;}
+}
+
 /**** PLANNER BUFFERS *******************************************************************
  *
  *	Planner buffers are used to queue and operate on Gcode blocks. Each buffer contains
@@ -405,6 +708,28 @@ void mp_unget_write_buffer()
 
 void mp_commit_write_buffer(const uint8_t move_type)
 {
+	if (move_type == MOVE_TYPE_ALINE) {
+		uint32_t now = SysTickTimer_getValue();
+		float interval = (float)(now - mm.commit_systick);
+		mm.commit_systick = now;
+		if (interval <= PLANNER_START_HOLDOFF_MAX_MS) {			// only gaps within a stream count
+			mm.commit_interval += (interval - mm.commit_interval) / 8;
+		}
+		// hold a move that would start an idle machine (see mp_start_callback()). The caller has
+		// already run cm_cycle_start(), so a machining cycle is normal here; other cycles are never held
+		if ((mb.q == mb.r) && (mp_get_runtime_busy() == false) && (cm.motion_state == MOTION_STOP) &&
+			((cm.cycle_state == CYCLE_OFF) || (cm.cycle_state == CYCLE_MACHINING))) {
+			mb.start_held = true;								// set before the buffer is queued
+		}
+	} else {
+		mb.start_held = false;									// don't hold commands, dwells or stops
+	}
+	// wake the motors a move from idle will use while it is held or before it's loaded, so the
+	// loader doesn't have to wait for their Vref. Done here in the main loop, not in the exec,
+	// so power state only changes here, in st_motor_power_callback() and in the loader
+	if (((move_type == MOVE_TYPE_ALINE) || (move_type == MOVE_TYPE_TRAVERSE)) && (mp_get_runtime_busy() == false)) {
+		st_pre_energize_motors(mb.q->unit);
+	}
 	mb.q->move_type = move_type;
 	mb.q->move_state = MOVE_NEW;
 	mb.q->buffer_state = MP_BUFFER_QUEUED;
@@ -432,6 +757,9 @@ mpBuf_t * mp_get_run_buffer()
 
 uint8_t mp_free_run_buffer()					// EMPTY current run buf & adv to next
 {
+	if (mb.r->move_type == MOVE_TYPE_ALINE) {	// release the pixels of a raster move
+		mp_free_raster_line(mb.r->gm.raster);
+	}
 	mp_clear_buffer(mb.r);						// clear it out (& reset replannable)
 //	mb.r->buffer_state = MP_BUFFER_EMPTY;		// redundant after the clear, above
 	mb.r = mb.r->nx;							// advance to next run buffer
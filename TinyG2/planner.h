@@ -39,7 +39,10 @@ enum moveType {				// bf->move_type values
 	MOVE_TYPE_TOOL,			// T command
 	MOVE_TYPE_SPINDLE_SPEED,// S command
 	MOVE_TYPE_STOP,			// program stop
-	MOVE_TYPE_END			// program end
+	MOVE_TYPE_END,			// program end
+	MOVE_TYPE_JOG,			// velocity jog - runs until the commanded velocity is zero
+	MOVE_TYPE_TRAVERSE,		// non-coordinated (dogleg) rapid - each axis runs its own profile
+	MOVE_TYPE_POSITION		// planner position update - parse-ahead queue only, see mp_queue_planner_position()
 };
 
 enum moveState {
@@ -100,13 +103,36 @@ enum sectionState {
 
 #define MIN_SEGMENT_TIME_PLUS_MARGIN ((MIN_SEGMENT_USEC+1) / MICROSECONDS_PER_MINUTE)
 
-/* PLANNER_STARTUP_DELAY_SECONDS
- *	Used to introduce a short dwell before planning an idle machine.
- *  If you don;t do this the first block will always plan to zero as it will
- *	start executing before the next block arrives from the serial port.
- *	This causes the machine to stutter once on startup.
+/* SHAPER_HISTORY
+ *	Segment end positions kept for the input shapers. Must cover the longest shaper - one
+ *	damped period at SHAPER_FREQUENCY_MIN and SHAPER_DAMPING_MAX - in minimum time segments.
  */
-#define PLANNER_STARTUP_DELAY_SECONDS ((float)0.05)	// in seconds
+#define SHAPER_HISTORY			50
+
+/* SPLINE_LENGTH_PIECES, SPLINE_CURVATURE_SAMPLES, SPLINE_NEWTON_ITERATIONS
+ *	A spline's length is integrated over this many pieces of the curve parameter, and its
+ *	peak curvature is taken from this many samples. The runtime finds the curve parameter
+ *	for each segment end with Newton steps from the previous one - usually one or two, up
+ *	to the iteration limit where the curve slows down next to a control point.
+ */
+#define SPLINE_LENGTH_PIECES		16
+#define SPLINE_CURVATURE_SAMPLES	32
+#define SPLINE_NEWTON_ITERATIONS	8
+#define SPLINE_LENGTH_TOLERANCE		((float)0.0001)	// mm - Newton convergence and curve end snap
+
+/* PLANNER_START_HOLDOFF_MIN_MS, PLANNER_START_HOLDOFF_MAX_MS
+ *	Motion from an idle machine is held until the first block is optimally planned (more
+ *	blocks can't make it any faster), the planner fills, a non-move block is queued, or no
+ *	new block has arrived for the start holdoff. If you don't hold the first block it will
+ *	always plan to zero as it starts executing before the next block arrives from the serial
+ *	port, and the machine stutters once on startup.
+ *
+ *	The holdoff is twice the average gap between blocks arriving while streaming, kept
+ *	between these limits. A single MDI, jog or probe block only waits one short holdoff,
+ *	and slow senders still get enough time to fill the planner.
+ */
+#define PLANNER_START_HOLDOFF_MIN_MS	2
+#define PLANNER_START_HOLDOFF_MAX_MS	50
 
 /* PLANNER_BUFFER_POOL_SIZE
  *	Should be at least the number of buffers requires to support optimal
@@ -116,6 +142,21 @@ enum sectionState {
 #define PLANNER_BUFFER_POOL_SIZE 28
 #define PLANNER_BUFFER_HEADROOM 4			// buffers to reserve in planner before processing new input line
 
+/* PARSE_AHEAD_QUEUE_SIZE
+ *	Parsed and validated blocks are held in the parse-ahead queue when the planner
+ *	pool is full, so the parser can keep reading input while the planner drains.
+ *	Blocks are handed to the planner in order as planner buffers free up.
+ *	Each entry carries a full Gcode model state, so don't make this too large.
+ */
+#define PARSE_AHEAD_QUEUE_SIZE 16
+#define PARSE_AHEAD_HEADROOM 4				// entries to reserve in queue before processing new input line
+
+/* RASTER_LINE_POOL_SIZE
+ *	Raster lines keep their pixels here from the time they are queued until the runtime is
+ *	done with the move. The controller stops reading input while all of them are in use.
+ */
+#define RASTER_LINE_POOL_SIZE 12
+
 /* Some parameters for _generate_trapezoid()
  * TRAPEZOID_ITERATION_MAX	 				Max iterations for convergence in the HT asymmetric case.
  * TRAPEZOID_ITERATION_ERROR_PERCENT		Error percentage for iteration convergence. As percent - 0.01 = 1%
@@ -133,6 +174,27 @@ enum sectionState {
 
 typedef void (*cm_exec_t)(float[], float[]);	// callback to canonical_machine execution function
 
+// TRUE if the move in the gcode state is a G5 or G5.1 spline (see mp_spline())
+#define mp_is_spline(gm) (((gm)->motion_mode == MOTION_MODE_CUBIC_SPLINE) || \
+						  ((gm)->motion_mode == MOTION_MODE_QUADRATIC_SPLINE))
+
+/* ATTACHED_COMMANDS_MAX
+ *	Commands that don't need the machine stopped (S words, coolant) ride on the next move
+ *	instead of taking a planner buffer of their own. See mp_queue_attached_command().
+ */
+#define ATTACHED_COMMANDS_MAX 4
+
+typedef struct mpAttachedCommand {	// command carried by a move and run as the move starts
+	cm_exec_t func;					// callback to canonical machine execution function
+	float value;					// passed to the callback as value[0]
+} mpAttachedCommand_t;
+
+typedef struct mpRasterLine {		// pixels for a raster move - see cm_raster_line()
+	volatile uint8_t count;			// number of pixels, 0 if the line is free
+	float pitch;					// pixel pitch in mm
+	uint8_t pixel[RASTER_PIXELS_MAX];// pixel power - 0 is off, 255 is full power
+} mpRasterLine_t;
+
 /*
  *	Planner structures
  */
@@ -159,6 +221,9 @@ typedef struct mpBuffer {			// See Planning Velocity Notes for variable usage
 	uint8_t move_state;				// move state machine sequence
 	uint8_t replannable;			// TRUE if move can be re-planned
 
+	uint8_t attached_count;			// commands to run as the move starts
+	mpAttachedCommand_t attached[ATTACHED_COMMANDS_MAX];
+
 	float unit[AXES];				// unit vector for axis scaling & planning
 
 	float length;					// total length of line or helix in mm
@@ -181,6 +246,10 @@ typedef struct mpBuffer {			// See Planning Velocity Notes for variable usage
 	float recip_jerk;				// 1/Jm used for planning (computed and cached)
 	float cbrt_jerk;				// cube root of Jm used for planning (computed and cached)
 
+	float spline_origin[2];			// spline moves: start point of the curve in machine XY
+	float spline_start;				// curve length before the start of this block - non-zero after a feedhold split
+	float spline_length;			// curve length of the whole spline
+
 	GCodeState_t gm;				// Gode model state - passed from model, used by planner and runtime
 
 } mpBuf_t;
@@ -191,10 +260,29 @@ typedef struct mpBufferPool {		// ring buffer for sub-moves
 	mpBuf_t *w;						// get_write_buffer pointer
 	mpBuf_t *q;						// queue_write_buffer pointer
 	mpBuf_t *r;						// get/end_run_buffer pointer
+	volatile uint8_t start_held;	// TRUE while motion from idle waits for more blocks
 	mpBuf_t bf[PLANNER_BUFFER_POOL_SIZE];// buffer storage
 	magic_t magic_end;
 } mpBufferPool_t;
 
+typedef struct mpParseAheadEntry {	// a parsed block waiting for a planner buffer
+	uint8_t move_type;				// MOVE_TYPE_ALINE, _TRAVERSE, _DWELL, _COMMAND or _POSITION
+	cm_exec_t cm_func;				// callback for MOVE_TYPE_COMMAND
+	uint8_t attach;					// TRUE if the command is attached to the next move
+	float flags[AXES];				// flags for MOVE_TYPE_COMMAND and _POSITION (values are carried in gm.target)
+	GCodeState_t gm;				// Gcode model state captured when the block was parsed
+} mpParseAheadEntry_t;
+
+typedef struct mpParseAheadQueue {	// ring buffer of parsed blocks ahead of the planner
+	magic_t magic_start;			// magic number to test memory integrity
+	uint8_t count;					// number of entries in the queue
+	uint8_t wr;						// write index
+	uint8_t rd;						// read index
+	uint8_t draining;				// TRUE while entries are being handed to the planner
+	mpParseAheadEntry_t blk[PARSE_AHEAD_QUEUE_SIZE];// entry storage
+	magic_t magic_end;
+} mpParseAheadQueue_t;
+
 typedef struct mpMoveMasterSingleton { // common variables for planning (move master)
 	magic_t magic_start;			// magic number to test memory integrity
 	float position[AXES];			// final move position for planning purposes
@@ -203,6 +291,12 @@ typedef struct mpMoveMasterSingleton { // common variables for planning (move ma
 	float recip_jerk;
 	float cbrt_jerk;
 
+	uint8_t attached_count;			// commands waiting for the next move
+	mpAttachedCommand_t attached[ATTACHED_COMMANDS_MAX];
+
+	uint32_t commit_systick;		// time the last move was committed
+	float commit_interval;			// average gap between moves while streaming (ms)
+
 	magic_t magic_end;
 } mpMoveMasterSingleton_t;
 
@@ -238,6 +332,15 @@ typedef struct mpMoveRuntimeSingleton {	// persistent runtime variables
 	float segment_velocity;			// computed velocity for aline segment
 	float segment_time;				// actual time increment per aline segment
 	float jerk;						// max linear jerk
+	float raster_distance;			// distance from the start of the raster line to mr.position
+	float requested_velocity;		// velocity the move asked for (for dynamic spindle power)
+
+	float spline_coeff[3][2];		// spline polynomial in t, t^2 and t^3 (see mp_spline_coefficients())
+	float spline_origin[2];			// start point of the curve
+	float spline_length;			// curve length of the whole spline
+	float spline_distance;			// curve length from the start of the curve to mr.position
+	float spline_t;					// curve parameter at mr.position
+	float spline_waypoint[SECTIONS];// curve length at the head/body/tail ends
 
 	float forward_diff_1;			// forward difference level 1
 	float forward_diff_2;			// forward difference level 2
@@ -249,6 +352,27 @@ typedef struct mpMoveRuntimeSingleton {	// persistent runtime variables
     
 	float out_of_band_dwell_time;   // timer for dwells that preempt execution of planner contents
 
+	float jog_velocity[AXES];		// velocity jog axis velocities (mm/min)
+	float jog_accel[AXES];			// velocity jog axis accelerations (mm/min^2)
+
+	float traverse_start[AXES];		// dogleg rapid start position
+	float traverse_length[AXES];	// signed axis travel
+	float traverse_velocity[AXES];	// peak velocity of each axis
+	float traverse_accel_time[AXES];// time each axis takes to reach its peak velocity
+	float traverse_axis_time[AXES];	// time each axis takes for the whole move
+	float traverse_time;			// profile time reached so far
+	float traverse_move_time;		// profile time of the slowest axis
+	float traverse_rate;			// rate profile time runs at - 1 is full speed, 0 is stopped
+	float traverse_rate_start;		// rate at the start of a rate ramp...
+	float traverse_rate_target;		// ...and at its end
+	float traverse_ramp_time;		// time a rate ramp takes
+	float traverse_ramp_elapsed;	// time into the ramp
+
+	float shaper_position[SHAPER_HISTORY][AXES];// unshaped segment end positions, newest at shaper_index
+	float shaper_time[SHAPER_HISTORY];	// segment time of each of those segments
+	uint8_t shaper_index;
+	float shaper_settle_time;		// time until the shaped position catches up with the commanded one
+
 	magic_t magic_end;
 } mpMoveRuntimeSingleton_t;
 
@@ -256,6 +380,7 @@ typedef struct mpMoveRuntimeSingleton {	// persistent runtime variables
 extern mpBufferPool_t mb;				// move buffer queue
 extern mpMoveMasterSingleton_t mm;		// context for line planning
 extern mpMoveRuntimeSingleton_t mr;		// context for line runtime
+extern mpParseAheadQueue_t pa;			// parsed blocks waiting for the planner
 
 /*
  * Global Scope Functions
@@ -267,10 +392,16 @@ stat_t planner_test_assertions(void);
 
 void mp_flush_planner(void);
 void mp_set_planner_position(uint8_t axis, const float position);
+void mp_queue_planner_position(const float position[], const float flags[]);
 void mp_set_runtime_position(uint8_t axis, const float position);
 void mp_set_steps_to_runtime_position(void);
+void mp_offset_motor_steps(uint8_t motor, float steps);
+void mp_reset_shaper(const float position[], float shaped[]);
 
 void mp_queue_command(void(*cm_exec_t)(float[], float[]), float *value, float *flag);
+void mp_queue_attached_command(void(*cm_exec_t)(float[], float[]), float *value, float *flag);
+void mp_attach_commands(mpBuf_t *bf);
+stat_t mp_attached_command_callback(void);
 stat_t mp_runtime_command(mpBuf_t *bf);
 
 stat_t mp_dwell(const float seconds);
@@ -282,11 +413,32 @@ void mp_request_out_of_band_dwell(float seconds);
 stat_t mp_exec_out_of_band_dwell(void);
 
 stat_t mp_aline(GCodeState_t *gm_in);
+stat_t mp_traverse(GCodeState_t *gm_in);
+float mp_get_traverse_time(uint8_t axis, float length, float *velocity);
+stat_t mp_spline(GCodeState_t *gm_in);
+void mp_spline_coefficients(const float origin[], const GCodeState_t *gm, float coeff[][2]);
+float mp_spline_speed(const float coeff[][2], float t);
+float mp_spline_length(const float coeff[][2], float t0, float t1);
 
 stat_t mp_plan_hold_callback(void);
 stat_t mp_start_hold(void);
 stat_t mp_feed_rate_override(uint8_t flag, float parameter);
 
+// parse-ahead queue handlers
+void mp_init_parse_ahead(void);
+uint8_t mp_get_parse_ahead_available(void);
+uint8_t mp_parse_ahead_defer(void);
+mpParseAheadEntry_t *mp_get_parse_ahead_entry(void);
+stat_t mp_parse_ahead_callback(void);
+stat_t mp_start_callback(void);
+
+// raster line pixel storage
+void mp_init_raster_lines(void);
+uint8_t mp_get_raster_lines_available(void);
+uint8_t mp_queue_raster_line(const uint8_t pixel[], uint8_t count, float pitch);
+mpRasterLine_t *mp_get_raster_line(uint8_t raster);
+void mp_free_raster_line(uint8_t raster);
+
 // planner buffer handlers
 uint8_t mp_get_planner_buffers_available(void);
 void mp_init_buffers(void);
@@ -324,5 +476,7 @@ float mp_get_target_velocity(const float Vi, const float L, const mpBuf_t *bf);
 // plan_exec.c functions
 stat_t mp_exec_move(void);
 stat_t mp_exec_aline(mpBuf_t *bf);
+stat_t mp_exec_traverse(mpBuf_t *bf);
+stat_t mp_jog_velocity(void);
 
 #endif	// End of include Guard: PLANNER_H_ONCE
@@ -213,6 +213,46 @@ stat_t pwm_set_duty(uint8_t chan, float duty)
 	return (STAT_OK);
 }
 
+/*
+ * pwm_get_compare_top() - PWM channel compare value for 100% duty cycle
+ * pwm_set_compare()	 - set PWM channel duty cycle as a compare value from 0 to top
+ *
+ *	pwm_set_compare() is pwm_set_duty() without the float math or range checks, for
+ *	interrupt level callers that have scaled their duty to the top value beforehand.
+ *	Changing the frequency changes the top value.
+ */
+
+uint16_t pwm_get_compare_top(uint8_t chan)
+{
+#ifdef __AVR
+	return (pwm.p[chan].timer->PER);
+#endif // __AVR
+
+#ifdef __ARM
+	if (chan == PWM_1) {
+		return (spindle_pwm_pin.getTopValue());
+	} else if (chan == PWM_2) {
+		return (secondary_pwm_pin.getTopValue());
+	}
+	return (0);
+#endif // __ARM
+}
+
+void pwm_set_compare(uint8_t chan, uint16_t compare)
+{
+#ifdef __AVR
+	pwm.p[chan].timer->CCB = compare + 1;
+#endif // __AVR
+
+#ifdef __ARM
+	if (chan == PWM_1) {
+		spindle_pwm_pin.writeRaw(compare);
+	} else if (chan == PWM_2) {
+		secondary_pwm_pin.writeRaw(compare);
+	}
+#endif // __ARM
+}
+
 
 /***********************************************************************************
  * CONFIGURATION AND INTERFACE FUNCTIONS
@@ -239,6 +279,8 @@ static const char fmt_p1wsh[] PROGMEM = "[p1wsh] pwm ccw speed hi%15.0f RPM\n";
 static const char fmt_p1wpl[] PROGMEM = "[p1wpl] pwm ccw phase lo%15.3f [0..1]\n";
 static const char fmt_p1wph[] PROGMEM = "[p1wph] pwm ccw phase hi%15.3f [0..1]\n";
 static const char fmt_p1pof[] PROGMEM = "[p1pof] pwm phase off   %15.3f [0..1]\n";
+static const char fmt_p1dpm[] PROGMEM = "[p1dpm] pwm dynamic mode%15d [0=off,1=on]\n";
+static const char fmt_p1dpf[] PROGMEM = "[p1dpf] pwm dynamic flr %15.3f [0..1]\n";
 
 void pwm_print_p1frq(nvObj_t *nv) { text_print_flt(nv, fmt_p1frq);}
 void pwm_print_p1csl(nvObj_t *nv) { text_print_flt(nv, fmt_p1csl);}
@@ -250,5 +292,7 @@ void pwm_print_p1wsh(nvObj_t *nv) { text_print_flt(nv, fmt_p1wsh);}
 void pwm_print_p1wpl(nvObj_t *nv) { text_print_flt(nv, fmt_p1wpl);}
 void pwm_print_p1wph(nvObj_t *nv) { text_print_flt(nv, fmt_p1wph);}
 void pwm_print_p1pof(nvObj_t *nv) { text_print_flt(nv, fmt_p1pof);}
+void pwm_print_p1dpm(nvObj_t *nv) { text_print_ui8(nv, fmt_p1dpm);}
+void pwm_print_p1dpf(nvObj_t *nv) { text_print_flt(nv, fmt_p1dpf);}
 
 #endif //__TEXT_MODE
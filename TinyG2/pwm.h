@@ -39,6 +39,8 @@ typedef struct pwmConfigChannel {
 	float ccw_phase_lo;				// pwm phase at minimum CCW spindle speed, clamped [0..1]
 	float ccw_phase_hi;				// pwm phase at maximum CCW spindle speed, clamped
 	float phase_off;				// pwm phase when spindle is disabled
+	uint8_t dynamic_power;			// TRUE scales the phase with velocity every segment (laser mode)
+	float dynamic_power_floor;		// smallest fraction of full power used in dynamic power mode [0..1]
 } pwmConfigChannel_t;
 
 typedef struct pwmChannel {
@@ -60,6 +62,8 @@ extern pwmSingleton_t pwm;
 void pwm_init(void);
 stat_t pwm_set_freq(uint8_t channel, float freq);
 stat_t pwm_set_duty(uint8_t channel, float duty);
+uint16_t pwm_get_compare_top(uint8_t channel);
+void pwm_set_compare(uint8_t channel, uint16_t compare);
 
 #ifdef __TEXT_MODE
 
@@ -73,6 +77,8 @@ stat_t pwm_set_duty(uint8_t channel, float duty);
 	void pwm_print_p1wpl(nvObj_t *nv);
 	void pwm_print_p1wph(nvObj_t *nv);
 	void pwm_print_p1pof(nvObj_t *nv);
+	void pwm_print_p1dpm(nvObj_t *nv);
+	void pwm_print_p1dpf(nvObj_t *nv);
 
 #else
 
@@ -86,6 +92,8 @@ stat_t pwm_set_duty(uint8_t channel, float duty);
 	#define pwm_print_p1wpl tx_print_stub
 	#define pwm_print_p1wph tx_print_stub
 	#define pwm_print_p1pof tx_print_stub
+	#define pwm_print_p1dpm tx_print_stub
+	#define pwm_print_p1dpf tx_print_stub
 
 #endif // __TEXT_MODE
 
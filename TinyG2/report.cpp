@@ -32,6 +32,7 @@
 #include "json_parser.h"
 #include "text_parser.h"
 #include "planner.h"
+#include "persistence.h"
 #include "settings.h"
 #include "util.h"
 #include "xio.h"
@@ -94,12 +95,12 @@ stat_t rpt_er(nvObj_t *nv)
 /**** Application Messages *********************************************************
  * rpt_print_initializing_message()	   - initializing configs from hard-coded profile
  * rpt_print_loading_configs_message() - loading configs from EEPROM
- * rpt_print_system_ready_message()    - system ready message
+ * rpt_print_system_ready_message()    - system ready message, with boot times on ARM
  *
  *	These messages are always in JSON format to allow UIs to sync
  */
 
-void _startup_helper(stat_t status, const char *msg)
+void _startup_helper(stat_t status, const char *msg, bool boot_times = false)
 {
 #ifndef __SUPPRESS_STARTUP_MESSAGES
 	js.json_footer_depth = JSON_FOOTER_DEPTH;	//++++ temporary until changeover is complete
@@ -110,6 +111,14 @@ void _startup_helper(stat_t status, const char *msg)
 	nv_add_object((const char_t *)"hp");		// hardware platform
 	nv_add_object((const char_t *)"hv");		// hardware version
 	nv_add_object((const char_t *)"id");		// hardware ID
+#ifdef __ARM
+	if (boot_times) {							// boot time breakdown in ms
+		nv_add_integer((const char_t *)"btmt", nvm.boot_mount_ms);		// mount
+		nv_add_integer((const char_t *)"btvl", nvm.boot_validate_ms);	// validate
+		nv_add_integer((const char_t *)"btld", nvm.boot_load_ms);		// load
+		nv_add_integer((const char_t *)"btdf", nvm.boot_defaults_ms);	// defaults
+	}
+#endif
 	nv_add_string((const char_t *)"msg", pstr2str(msg));	// startup message
 	json_print_response(status);
 #endif
@@ -127,7 +136,7 @@ void rpt_print_loading_configs_message(void)
 
 void rpt_print_system_ready_message(void)
 {
-	_startup_helper(STAT_OK, PSTR("SYSTEM READY"));
+	_startup_helper(STAT_OK, PSTR("SYSTEM READY"), true);
 	if (cs.comm_mode == TEXT_MODE) { text_response(STAT_OK, (char_t *)"");}// prompt
 }
 
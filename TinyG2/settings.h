@@ -144,6 +144,106 @@
 #define P1_PWM_PHASE_OFF                0.1
 #endif //P1_PWM_FREQUENCY
 
+// Dynamic power (laser mode) is off unless the machine profile turns it on
+#ifndef P1_DYNAMIC_POWER
+#define P1_DYNAMIC_POWER                0					// 1 = PWM phase follows velocity
+#define P1_DYNAMIC_POWER_FLOOR          0.0					// fraction of full power at standstill [0..1]
+#endif
+
+// Corner speeds use junction deviation unless the machine profile picks the jerk model
+#ifndef JUNCTION_MODEL
+#define JUNCTION_MODEL					JUNCTION_MODEL_DEVIATION	// see cmJunctionModel
+#define JUNCTION_TIME					20.0				// ms a corner's velocity change is spread over
+#endif
+
+// Rapids are coordinated straight lines unless the machine profile allows dogleg rapids
+#ifndef TRAVERSE_MODE
+#define TRAVERSE_MODE					TRAVERSE_COORDINATED	// see cmTraverseMode
+#endif
+
+// Canned drilling cycle pecks - small enough for fine drills, raise them for long chips
+#ifndef PECK_CLEARANCE
+#define PECK_CLEARANCE					0.254				// G83 re-entry height above the last peck in mm
+#endif
+#ifndef PECK_RETRACT
+#define PECK_RETRACT					0.254				// G73 back off between pecks in mm
+#endif
+
+// Kinematics - Cartesian unless the machine profile says otherwise
+#ifndef KINEMATICS
+#define KINEMATICS						KINEMATICS_CARTESIAN	// see kinType in kinematics.h
+#endif
+#ifndef DELTA_ARM_LENGTH
+#define DELTA_ARM_LENGTH				250.0				// diagonal rod length in mm
+#define DELTA_RADIUS					125.0				// effector to carriage pivot distance in mm, less offsets
+#endif
+
+// Homing groups - axes with the same group home together, lowest group first.
+// The defaults home one axis at a time in Z,X,Y,A order
+#ifndef X_HOMING_GROUP
+#define X_HOMING_GROUP					2
+#define Y_HOMING_GROUP					3
+#define Z_HOMING_GROUP					1
+#define A_HOMING_GROUP					4
+#define B_HOMING_GROUP					5
+#define C_HOMING_GROUP					6
+#endif
+
+// Input shapers - off unless the machine profile sets them. See cm_set_axis_shaper()
+#ifndef X_SHAPER_TYPE
+#define X_SHAPER_TYPE				SHAPER_OFF
+#define X_SHAPER_FREQUENCY			40.0				// Hz
+#define X_SHAPER_DAMPING			0.1
+#define Y_SHAPER_TYPE				SHAPER_OFF
+#define Y_SHAPER_FREQUENCY			40.0				// Hz
+#define Y_SHAPER_DAMPING			0.1
+#define Z_SHAPER_TYPE				SHAPER_OFF
+#define Z_SHAPER_FREQUENCY			40.0				// Hz
+#define Z_SHAPER_DAMPING			0.1
+#define A_SHAPER_TYPE				SHAPER_OFF
+#define A_SHAPER_FREQUENCY			40.0				// Hz
+#define A_SHAPER_DAMPING			0.1
+#define B_SHAPER_TYPE				SHAPER_OFF
+#define B_SHAPER_FREQUENCY			40.0				// Hz
+#define B_SHAPER_DAMPING			0.1
+#define C_SHAPER_TYPE				SHAPER_OFF
+#define C_SHAPER_FREQUENCY			40.0				// Hz
+#define C_SHAPER_DAMPING			0.1
+#endif
+
+// Backlash compensation - off unless the machine profile sets it. See st_prep_line()
+#ifndef X_BACKLASH
+#define X_BACKLASH				0.0					// mm
+#define X_BACKLASH_RATE			100.0				// mm/min
+#define Y_BACKLASH				0.0					// mm
+#define Y_BACKLASH_RATE			100.0				// mm/min
+#define Z_BACKLASH				0.0					// mm
+#define Z_BACKLASH_RATE			100.0				// mm/min
+#define A_BACKLASH				0.0					// degrees
+#define A_BACKLASH_RATE			100.0				// degrees/min
+#define B_BACKLASH				0.0					// degrees
+#define B_BACKLASH_RATE			100.0				// degrees/min
+#define C_BACKLASH				0.0					// degrees
+#define C_BACKLASH_RATE			100.0				// degrees/min
+#endif
+
+// Gantry squaring - no motor has its own homing switch unless the profile sets one. See cycle_homing.cpp
+// Switch: 0=the axis homing switch, 1-8=Xmin,Xmax,Ymin,Ymax,Zmin,Zmax,Amin,Amax
+#ifndef M1_HOMING_SWITCH
+#define M1_HOMING_SWITCH		0
+#define M1_HOMING_OFFSET		0.0					// mm or degrees
+#define M2_HOMING_SWITCH		0
+#define M2_HOMING_OFFSET		0.0					// mm or degrees
+#define M3_HOMING_SWITCH		0
+#define M3_HOMING_OFFSET		0.0					// mm or degrees
+#define M4_HOMING_SWITCH		0
+#define M4_HOMING_OFFSET		0.0					// mm or degrees
+#define M5_HOMING_SWITCH		0
+#define M5_HOMING_OFFSET		0.0					// mm or degrees
+#define M6_HOMING_SWITCH		0
+#define M6_HOMING_OFFSET		0.0					// mm or degrees
+#endif
+
 /*** User-Defined Data Defaults ***/
 
 #define USER_DATA_A0	0
@@ -36,6 +36,10 @@
 
 static void _exec_spindle_control(float *value, float *flag);
 static void _exec_spindle_speed(float *value, float *flag);
+static void _set_spindle_pwm(uint8_t spindle_mode);
+
+static uint8_t _pwm_spindle_mode;		// spindle mode the PWM was last set for (OFF if paused)
+static float _pwm_duty;					// full power duty cycle for the current speed
 
 /*
  * cm_spindle_init()
@@ -162,7 +166,7 @@ static void _exec_spindle_control(float *value, float *flag)
 	}
 #endif // __ARM
 
-	pwm_set_duty(PWM_1, cm_get_spindle_pwm(raw_spindle_mode));
+	_set_spindle_pwm(raw_spindle_mode);
 }
 
 /*
@@ -174,7 +178,7 @@ stat_t cm_set_spindle_speed(float speed)
 {
 //	if (speed > cfg.max_spindle speed) { return (STAT_MAX_SPINDLE_SPEED_EXCEEDED);}
 	float value[AXES] = { speed, 0,0,0,0,0 };
-	mp_queue_command(_exec_spindle_speed, value, value);
+	mp_queue_attached_command(_exec_spindle_speed, value, value);	// doesn't stop the machine
 	return (STAT_OK);
 }
 
@@ -185,5 +189,69 @@ static void _exec_spindle_speed(float *value, float *flag)
 	bool paused = cm.gm.spindle_mode & SPINDLE_PAUSED;
 	if(cm.estop_state != 0 || cm.safety_state != 0 || paused)
 		spindle_mode = SPINDLE_OFF;
-	pwm_set_duty(PWM_1, cm_get_spindle_pwm(spindle_mode) ); // update spindle speed if we're running
+	_set_spindle_pwm(spindle_mode);							// update spindle speed if we're running
+}
+
+static void _set_spindle_pwm(uint8_t spindle_mode)
+{
+	_pwm_spindle_mode = spindle_mode;
+	_pwm_duty = cm_get_spindle_pwm(spindle_mode);
+	pwm_set_duty(PWM_1, _pwm_duty);
+}
+
+/*
+ * cm_spindle_dynamic_power()	   - TRUE if the spindle PWM should follow velocity (laser mode)
+ * cm_exec_spindle_dynamic_power() - scale the PWM for the segment being loaded
+ *
+ *	In dynamic power mode ({p1dpm:1}) the duty cycle set by S and M3/M4 is full power. The
+ *	runtime attaches a call to every segment with the ratio of the segment velocity to the
+ *	requested velocity in value[0], and the stepper loader runs it as the segment loads. A
+ *	laser then delivers the same energy per unit length through accelerations and corners.
+ *	The ratio is floored at p1dpf, and the duty never goes below the low phase of the speed
+ *	mapping. A spindle that is off or paused is left alone.
+ */
+
+bool cm_spindle_dynamic_power()
+{
+	return ((pwm.c[PWM_1].dynamic_power == true) &&
+			((_pwm_spindle_mode == SPINDLE_CW) || (_pwm_spindle_mode == SPINDLE_CCW)));
+}
+
+void cm_exec_spindle_dynamic_power(float *value, float *flag)
+{
+	if ((_pwm_spindle_mode != SPINDLE_CW) && (_pwm_spindle_mode != SPINDLE_CCW)) return;
+
+	float ratio = value[0];
+	if (ratio < pwm.c[PWM_1].dynamic_power_floor) { ratio = pwm.c[PWM_1].dynamic_power_floor;}
+	if (ratio > 1) { ratio = 1;}
+	float phase_lo = (_pwm_spindle_mode == SPINDLE_CW) ? pwm.c[PWM_1].cw_phase_lo : pwm.c[PWM_1].ccw_phase_lo;
+	if (_pwm_duty < phase_lo) { phase_lo = _pwm_duty;}
+	pwm_set_duty(PWM_1, phase_lo + (_pwm_duty - phase_lo) * ratio);
+}
+
+/*
+ * cm_get_spindle_raster_power() - PWM duty range for raster pixels (see cm_raster_line())
+ *
+ *	Returns false if the spindle is off or paused. Otherwise a zero pixel is the PWM off
+ *	phase, and pixels 1 - 255 run from the low phase of the speed mapping up to the duty
+ *	set by S: duty = lo + scale * pixel. In dynamic power mode the range is scaled by the
+ *	velocity ratio the same way cm_exec_spindle_dynamic_power() scales a segment.
+ */
+
+bool cm_get_spindle_raster_power(float ratio, float *off, float *lo, float *scale)
+{
+	if ((_pwm_spindle_mode != SPINDLE_CW) && (_pwm_spindle_mode != SPINDLE_CCW)) return (false);
+
+	if (pwm.c[PWM_1].dynamic_power == false) {
+		ratio = 1;
+	} else if (ratio < pwm.c[PWM_1].dynamic_power_floor) {
+		ratio = pwm.c[PWM_1].dynamic_power_floor;
+	}
+	if (ratio > 1) { ratio = 1;}
+	float phase_lo = (_pwm_spindle_mode == SPINDLE_CW) ? pwm.c[PWM_1].cw_phase_lo : pwm.c[PWM_1].ccw_phase_lo;
+	if (_pwm_duty < phase_lo) { phase_lo = _pwm_duty;}
+	*off = pwm.c[PWM_1].phase_off;
+	*lo = phase_lo;
+	*scale = (_pwm_duty - phase_lo) * ratio / 255;
+	return (true);
 }
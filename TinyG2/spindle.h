@@ -39,4 +39,8 @@ stat_t cm_set_spindle_speed(float speed);			// S parameter
 stat_t cm_spindle_control(uint8_t spindle_mode);	// M3, M4, M5 integrated spindle control
 stat_t cm_spindle_control_immediate(uint8_t spindle_mode); //like cm_spindle_control but not synchronized to planner
 
+bool cm_spindle_dynamic_power(void);				// TRUE if the PWM should follow velocity
+void cm_exec_spindle_dynamic_power(float *value, float *flag);	// scale the PWM for a segment
+bool cm_get_spindle_raster_power(float ratio, float *off, float *lo, float *scale);	// PWM range for raster pixels
+
 #endif	// End of include guard: SPINDLE_H_ONCE
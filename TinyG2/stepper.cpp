@@ -34,7 +34,11 @@
 #include "stepper.h"
 #include "encoder.h"
 #include "planner.h"
+#include "kinematics.h"
+#include "switch.h"
 #include "hardware.h"
+#include "spindle.h"
+#include "pwm.h"
 #include "text_parser.h"
 #include "util.h"
 
@@ -43,10 +47,13 @@
 stConfig_t st_cfg;
 stPrepSingleton_t st_pre;
 static stRunSingleton_t st_run;
+static stRasterSegment_t st_raster[2];		// raster segments - one running, one being prepped
 
 /**** Setup local functions ****/
 
 static void _load_move(void);
+static void _load_raster(void);
+static void _end_raster(void);
 #ifdef __ARM
 static void _set_motor_power_level(const uint8_t motor, const float power_level);
 #endif
@@ -235,6 +242,8 @@ Stepper<MOTOR_6,
 void stepper_init()
 {
 	memset(&st_run, 0, sizeof(st_run));			// clear all values, pointers and status
+	st_run.raster = &st_raster[0];
+	st_pre.raster = &st_raster[1];
 	stepper_init_assertions();
 
 #ifdef __AVR
@@ -364,10 +373,43 @@ void st_reset()
         st_pre.mot[motor].direction = STEP_INITIAL_DIRECTION;
 		st_run.mot[motor].substep_accumulator = 0;	// will become max negative during per-motor setup;
 		st_pre.mot[motor].corrected_steps = 0;		// diagnostic only - no action effect
+		st_pre.mot[motor].backlash_sign = 0;		// the next move sets the side the slack is on
+		st_pre.mot[motor].backlash_position = 0;
 	}
+	st_run.stopped_motors = 0;
 	mp_set_steps_to_runtime_position();
 }
 
+/*
+ * st_stop_motors()	   - stop stepping motors now, wherever they are in the segment
+ * st_release_motors() - let stopped motors step again
+ *
+ *	Used to square a gantry while homing: the switch pin interrupt stops each ganged motor
+ *	as its own switch changes, while the move carries on for the others. A stopped motor
+ *	ignores every segment loaded until it is released, so the runtime and step positions
+ *	no longer match it. Release it only once motion has stopped and the steps have been
+ *	set back to the runtime position (mp_set_steps_to_runtime_position()).
+ *
+ *	st_stop_motors() may be called from interrupts. The prepped increment is cleared as
+ *	well as the running one, so a segment being loaded at the same time can't restart it.
+ */
+
+void st_stop_motors(uint8_t motors)
+{
+	st_run.stopped_motors |= motors;
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		if (motors & (1 << motor)) {
+			st_run.mot[motor].substep_increment = 0;
+			st_pre.mot[motor].substep_increment = 0;
+		}
+	}
+}
+
+void st_release_motors(uint8_t motors)
+{
+	st_run.stopped_motors &= ~motors;
+}
+
 /*
  * st_clc() - clear counters
  */
@@ -387,6 +429,7 @@ stat_t st_clc(nvObj_t *nv)	// clear diagnostic counters, reset stepper prep
  *
  * st_energize_motors()		 - apply power to all motors
  * st_deenergize_motors()	 - remove power from all motors
+ * st_pre_energize_motors()	 - wake the motors an upcoming move will use
  * st_motor_power_callback() - callback to manage motor power sequencing
  */
 
@@ -490,6 +533,35 @@ void st_energize_motors(float timeout_seconds)
 #endif
 }
 
+/*
+ * st_pre_energize_motors() - wake the motors an upcoming move will use
+ *
+ *	Called from the main loop by mp_commit_write_buffer() with the unit vector of a move
+ *	queued to an idle runtime - typically while the start is held (see mp_start_callback()).
+ *	Motors on the move's axes that are off or idling are enabled and brought to full power
+ *	now, so their Vref has settled by the time the move is loaded and _load_move() doesn't
+ *	have to dwell. If the move arrives before the Vref has settled the loader only waits
+ *	out the remainder. Once a cycle runs the loader keeps these motors at full power.
+ */
+
+void st_pre_energize_motors(const float unit[])
+{
+	for (uint8_t motor = MOTOR_1; motor < MOTORS; motor++) {
+		uint8_t axis = st_cfg.mot[motor].motor_map;
+		if ((axis >= AXES) || (ik_joint_moves(unit, axis) == false)) { continue;}
+		if (st_cfg.mot[motor].power_mode == MOTOR_DISABLED) { continue;}
+		if ((st_run.mot[motor].power_state != MOTOR_OFF) && (st_run.mot[motor].power_state != MOTOR_IDLE)) {
+			continue;												// already at full power
+		}
+		_energize_motor(motor);
+		if (st_cfg.mot[motor].power_mode == MOTOR_POWER_REDUCED_WHEN_IDLE) {
+			_set_motor_power_level(motor, st_cfg.mot[motor].power_level);
+			st_run.mot[motor].vref_systick = SysTickTimer_getValue() + (uint32_t)(MOTOR_VREF_RC_TIMEOUT_SEC * 1000);
+		}
+		st_run.mot[motor].power_state = MOTOR_POWER_TIMEOUT_START;	// times out if the move never comes
+	}
+}
+
 void st_deenergize_motors()
 {
 	for (uint8_t motor = MOTOR_1; motor < MOTORS; motor++) {
@@ -646,6 +718,12 @@ MOTATE_TIMER_INTERRUPT(dda_timer_num)
 		motor_5.step.clear();
 		motor_6.step.clear();
 
+		// switch the spindle PWM at each raster pixel - see st_prep_raster()
+		if ((st_run.raster_index < st_run.raster_count) &&
+			(st_run.dda_ticks_downcount <= st_run.raster->tick[st_run.raster_index])) {
+			pwm_set_compare(PWM_1, st_run.raster->compare[st_run.raster_index++]);
+		}
+
 		if (--st_run.dda_ticks_downcount != 0) return;
 
 		// process end of segment
@@ -826,14 +904,31 @@ static void _load_move()
                st_cfg.mot[motor].power_mode != MOTOR_ALWAYS_POWERED)
 			st_run.mot[motor].power_state = MOTOR_POWER_TIMEOUT_START;	// ...start motor power timeouts
 		}
+		if (st_run.raster_count != 0) {							// stopped after a raster move - PWM off
+			st_run.raster_index = st_run.raster_count;
+			pwm_set_compare(PWM_1, st_run.raster_off);
+		}
 		return;
 	}
+	// run commands attached to this segment - see mp_queue_attached_command()
+	for (uint8_t i=0; i<st_pre.attached_count; i++) {
+		float value[AXES] = { st_pre.attached_value[i], 0,0,0,0,0 };
+		st_pre.attached_func[i](value, value);
+	}
+	st_pre.attached_count = 0;
+
+	// anything but a raster segment gives the spindle PWM back to S and M3/M4
+	if ((st_pre.move_type != MOVE_TYPE_ALINE) || (st_pre.raster->count == 0)) {
+		st_pre.raster->count = 0;
+		_end_raster();
+	}
+
 	// handle aline loads first (most common case)  NB: there are no more lines, only alines
 	if (st_pre.move_type == MOVE_TYPE_ALINE) {
 
 		//**** power management ****
 
-		bool waitForVref = false;
+		int32_t vref_wait = 0;										// ms left for a raised Vref to settle
 		for(int mot = MOTOR_1; mot < MOTORS; ++mot) {
 			if(st_pre.mot[mot].substep_increment != 0 || st_cfg.mot[mot].power_mode != MOTOR_POWERED_ONLY_WHEN_MOVING) { // We have steps to run, or need to power on for the sake of holding torque
 				// Enable the stepper and start motor power management
@@ -842,9 +937,13 @@ static void _load_move()
 						_energize_motor(mot);								// enable the motor (clear the ~Enable line)
 						if(st_cfg.mot[mot].power_mode == MOTOR_POWER_REDUCED_WHEN_IDLE) {
 							_set_motor_power_level(mot, st_cfg.mot[mot].power_level);
-							waitForVref = true;
+							st_run.mot[mot].vref_systick = SysTickTimer_getValue() + (uint32_t)(MOTOR_VREF_RC_TIMEOUT_SEC * 1000);
 						}
 					}
+					if(st_cfg.mot[mot].power_mode == MOTOR_POWER_REDUCED_WHEN_IDLE) {	// includes pre-energized motors
+						int32_t wait = (int32_t)(st_run.mot[mot].vref_systick - SysTickTimer_getValue());
+						if (wait > vref_wait) { vref_wait = wait;}
+					}
 					st_run.mot[mot].power_state = MOTOR_RUNNING;
 				}
 			} else { // No steps to run and st_cfg.mot[mot].power_mode == MOTOR_POWERED_ONLY_WHEN_MOVING
@@ -853,11 +952,13 @@ static void _load_move()
 			}
 		}
 
-		/* If we just changed VRef before a move, wait for it to stabilize by inserting a dwell...
+		/* If VRef was raised too recently, wait for it to stabilize by inserting a dwell...
+		 * Motors are normally pre-energized when a move is queued to an idle runtime (see st_pre_energize_motors()),
+		 * so this only waits out whatever settling time is left.
 		 * Since we don't actually process the exec buffer, we can just return here without calling request exec again
 		 */
-		if(waitForVref) {
-			st_run.dda_ticks_downcount = (uint32_t)(MOTOR_VREF_RC_TIMEOUT_SEC * FREQUENCY_DWELL);
+		if(vref_wait > 0) {
+			st_run.dda_ticks_downcount = (uint32_t)vref_wait * FREQUENCY_DWELL / 1000;
 			st_pre.exec_isbusy |= DDA_DWELL_BUSY_FLAG;
 			dwell_timer.start();
 			return;
@@ -867,6 +968,9 @@ static void _load_move()
 
 		st_run.dda_ticks_downcount = st_pre.dda_ticks;
 		st_run.dda_ticks_X_substeps = st_pre.dda_ticks_X_substeps;
+		if (st_pre.raster->count != 0) {
+			_load_raster();
+		}
 
 		//**** MOTOR LOAD ****
 
@@ -874,6 +978,9 @@ static void _load_move()
 		// is supposed to take < 10 uSec (Xmega). Be careful if you mess with this.
 
 		for(int mot = MOTOR_1; mot < MOTORS; ++mot) {
+			if (st_run.stopped_motors & (1 << mot)) {	// see st_stop_motors()
+				st_pre.mot[mot].substep_increment = 0;
+			}
 			// the following if() statement sets the runtime substep increment value or zeroes it
 			if ((st_run.mot[mot].substep_increment = st_pre.mot[mot].substep_increment) != 0) {
 
@@ -900,6 +1007,7 @@ static void _load_move()
 			}
 			// accumulate counted steps to the step position and zero out counted steps for the segment currently being loaded
 			ACCUMULATE_ENCODER(mot);
+			ACCUMULATE_BACKLASH(mot, st_pre.mot[mot].backlash_take_up);
 		}
 
 		//**** do this last ****
@@ -929,6 +1037,45 @@ static void _load_move()
 	st_request_exec_move();								// exec and prep next move
 }
 
+/*
+ * _load_raster() - swap the prepped raster segment in to run (runs from _load_move())
+ * _end_raster()  - return the spindle PWM to the full duty cycle for the speed
+ *
+ *	The PWM range for the pixels is taken as the segment loads, after any S word attached
+ *	to it has run. With the spindle off or paused the pixels leave the PWM alone. Each pixel
+ *	is turned into a PWM compare value here so the DDA ISR does no float math to switch it.
+ */
+
+static void _load_raster()
+{
+	stRasterSegment_t *seg = st_pre.raster;
+	st_pre.raster = st_run.raster;
+	st_pre.raster->count = 0;
+	st_run.raster = seg;
+	st_run.raster_index = 0;
+	st_run.raster_count = 0;
+
+	float off, lo, scale;
+	if (cm_get_spindle_raster_power(seg->ratio, &off, &lo, &scale)) {
+		float top = pwm_get_compare_top(PWM_1);
+		uint32_t lo_compare = lo * top;
+		uint32_t span = scale * 255 * top;			// compare counts from pixel 0 to pixel 255
+		st_run.raster_off = off * top;
+		for (uint8_t i=0; i<seg->count; i++) {
+			seg->compare[i] = (seg->pixel[i] == 0) ? st_run.raster_off : lo_compare + (span * seg->pixel[i]) / 255;
+		}
+		st_run.raster_count = seg->count;
+	}
+}
+
+static void _end_raster()
+{
+	if (st_run.raster_count == 0) return;
+	st_run.raster_count = 0;
+	float value[AXES] = { 1, 0,0,0,0,0 };
+	cm_exec_spindle_dynamic_power(value, value);
+}
+
 /***********************************************************************************
  * st_prep_line() - Prepare the next move for the loader
  *
@@ -948,6 +1095,13 @@ static void _load_move()
  *	  - segment_time - how many minutes the segment should run. If timing is not
  *		100% accurate this will affect the move velocity, but not the distance traveled.
  *
+ *	Backlash compensation: when the commanded travel of a motor reverses, the lost motion of
+ *	its axis ($xbl) is added to the motor's steps. It is spread over the following segments
+ *	at no more than the take-up rate ($xbr) instead of being sent as a burst of steps. The
+ *	reversal is taken from the commanded travel, not the motor direction, which includes any
+ *	take-up. The first move after a reset only records which side the slack is on. The
+ *	injected steps are counted by the encoder and taken back out in en_read_encoder().
+ *
  * NOTE:  Many of the expressions are sensitive to casting and execution order to avoid long-term
  *		  accuracy errors due to floating point round off. One earlier failed attempt was:
  *		    dda_ticks_X_substeps = (int32_t)((microseconds/1000000) * f_dda * dda_substeps);
@@ -975,6 +1129,29 @@ stat_t st_prep_line(float travel_steps[], float following_error[], float segment
 	float correction_steps;
 	for (uint8_t motor=0; motor<MOTORS; motor++) {	// I want to remind myself that this is motors, not axes
 
+		// Backlash compensation. The slack is centered on the commanded position, so the
+		// take-up moves the motor half the lost motion ahead in the commanded direction.
+		st_pre.mot[motor].backlash_take_up = 0;
+		uint8_t axis = st_cfg.mot[motor].motor_map;
+		if ((axis < AXES) && (cm.a[axis].backlash_rate > 0)) {
+			float half_backlash = max(cm.a[axis].backlash, 0) * kin.motor_steps_per_unit[motor] / 2;
+			if (fp_NOT_ZERO(travel_steps[motor])) {
+				int8_t sign = (travel_steps[motor] > 0) ? 1 : -1;
+				if (st_pre.mot[motor].backlash_sign == 0) {		// first move - assume the slack is taken up
+					st_pre.mot[motor].backlash_position = sign * half_backlash;
+				}
+				st_pre.mot[motor].backlash_sign = sign;
+			}
+			float take_up = st_pre.mot[motor].backlash_sign * half_backlash - st_pre.mot[motor].backlash_position;
+			if (fp_NOT_ZERO(take_up)) {
+				float take_up_max = cm.a[axis].backlash_rate * kin.motor_steps_per_unit[motor] * segment_time;
+				take_up = min(max(take_up, -take_up_max), take_up_max);
+				st_pre.mot[motor].backlash_position += take_up;
+				st_pre.mot[motor].backlash_take_up = take_up;
+				travel_steps[motor] += take_up;
+			}
+		}
+
 		// Skip this motor if there are no new steps. Leave all other values intact.
 		if (fp_ZERO(travel_steps[motor])) { st_pre.mot[motor].substep_increment = 0; continue;}
 
@@ -1052,6 +1229,46 @@ void st_prep_command(void *bf)
 	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_LOADER;	// signal that prep buffer is ready
 }
 
+/*
+ * st_prep_attached_command() - Stage a command to run when the next prepped segment loads
+ */
+
+void st_prep_attached_command(void (*func)(float[], float[]), float value)
+{
+	if (st_pre.attached_count >= PREP_ATTACHED_COMMANDS_MAX) {
+		float v[AXES] = { value, 0,0,0,0,0 };
+		func(v, v);										// never supposed to happen - run it now
+		return;
+	}
+	st_pre.attached_func[st_pre.attached_count] = func;
+	st_pre.attached_value[st_pre.attached_count] = value;
+	st_pre.attached_count++;
+}
+
+/*
+ * st_prep_raster() - Stage the spindle PWM changes for the next prepped segment
+ *
+ *	Call before st_prep_line() for the same segment. fraction[] is where each pixel starts
+ *	as a fraction of the segment, in increasing order. The DDA ISR switches the PWM as the
+ *	tick downcount passes each start, so the pixels land on position however fast the
+ *	segment runs. ratio is passed through to cm_get_spindle_raster_power() for dynamic power.
+ */
+
+void st_prep_raster(const float fraction[], const uint8_t pixel[], uint8_t count, float ratio, float segment_time)
+{
+	stRasterSegment_t *seg = st_pre.raster;
+	uint32_t dda_ticks = (uint32_t)(segment_time * 60 * FREQUENCY_DDA);	// as computed by st_prep_line()
+
+	if (count > RASTER_SEGMENT_PIXELS_MAX) { count = RASTER_SEGMENT_PIXELS_MAX;}
+	for (uint8_t i=0; i<count; i++) {
+		uint32_t tick = dda_ticks - (uint32_t)(fraction[i] * dda_ticks);
+		seg->tick[i] = (tick < 1) ? 1 : tick;
+		seg->pixel[i] = pixel[i];
+	}
+	seg->ratio = ratio;
+	seg->count = count;
+}
+
 /*
  * st_prep_dwell() 	 - Add a dwell to the move buffer
  */
@@ -1133,16 +1350,26 @@ static void _set_motor_steps_per_unit(nvObj_t *nv)
 	uint8_t m = _get_motor(nv->index);
 	st_cfg.mot[m].units_per_step = (st_cfg.mot[m].travel_rev * st_cfg.mot[m].step_angle) / (360 * st_cfg.mot[m].microsteps);
 	st_cfg.mot[m].steps_per_unit = 1 / st_cfg.mot[m].units_per_step;
+	ik_map_motors();
 }
 
 /* PER-MOTOR FUNCTIONS
+ * st_set_ma() - set motor map to axis
  * st_set_sa() - set motor step angle
  * st_set_tr() - set travel per motor revolution
  * st_set_mi() - set motor microsteps
  * st_set_pm() - set motor power mode
+ * st_set_hs() - set gantry squaring switch
  * st_set_pl() - set motor power level
  */
 
+stat_t st_set_ma(nvObj_t *nv)			// motor map to axis
+{
+	set_ui8(nv);
+	ik_map_motors();
+	return(STAT_OK);
+}
+
 stat_t st_set_sa(nvObj_t *nv)			// motor step angle
 {
 	set_flt(nv);
@@ -1192,6 +1419,13 @@ stat_t st_set_pm(nvObj_t *nv)			// motor power mode
 	return (STAT_OK);
 }
 
+stat_t st_set_hs(nvObj_t *nv)			// gantry squaring switch
+{
+	if ((nv->value < 0) || (nv->value > SW_PAIRS * SW_POSITIONS)) { return (STAT_INPUT_VALUE_RANGE_ERROR);}
+	set_ui8(nv);
+	return(STAT_OK);
+}
+
 /*
  * st_set_pl() - set motor power level
  *
@@ -1274,6 +1508,8 @@ static const char fmt_0po[] PROGMEM = "[%s%s] m%s polarity%18d [0=normal,1=rever
 static const char fmt_0pm[] PROGMEM = "[%s%s] m%s power management%10d [0=disabled,1=always on,2=in cycle,3=when moving]\n";
 static const char fmt_0pl[] PROGMEM = "[%s%s] m%s motor power level%13.3f [0.000=minimum, 1.000=maximum]\n";
 static const char fmt_0pli[] PROGMEM = "[%s%s] m%s motor idle power level%13.3f [0.000=minimum, 1.000=maximum]\n";
+static const char fmt_0hs[] PROGMEM = "[%s%s] m%s homing squaring switch%8d [0=axis switch,1=xmin,2=xmax,3=ymin...8=amax]\n";
+static const char fmt_0ho[] PROGMEM = "[%s%s] m%s homing squaring offset%9.4f%s\n";
 
 void st_print_mt(nvObj_t *nv) { text_print_flt(nv, fmt_mt);}
 void st_print_me(nvObj_t *nv) { text_print_nul(nv, fmt_me);}
@@ -1308,5 +1544,7 @@ void st_print_po(nvObj_t *nv) { _print_motor_ui8(nv, fmt_0po);}
 void st_print_pm(nvObj_t *nv) { _print_motor_ui8(nv, fmt_0pm);}
 void st_print_pl(nvObj_t *nv) { _print_motor_flt(nv, fmt_0pl);}
 void st_print_pli(nvObj_t *nv) { _print_motor_flt(nv, fmt_0pli);}
+void st_print_hs(nvObj_t *nv) { _print_motor_ui8(nv, fmt_0hs);}
+void st_print_ho(nvObj_t *nv) { _print_motor_flu_units(nv, fmt_0ho, cm_get_units_mode(MODEL));}
 
 #endif // __TEXT_MODE
@@ -350,6 +350,8 @@ typedef struct cfgMotor {				// per-motor configs
 	float travel_rev;					// mm or deg of travel per motor revolution
 	float steps_per_unit;				// microsteps per mm (or degree) of travel
 	float units_per_step;				// mm or degrees of travel per microstep
+	uint8_t homing_switch;				// gantry squaring switch, 0 for the axis homing switch
+	float homing_offset;				// squaring correction applied after homing (mm or degrees)
 } cfgMotor_t;
 
 typedef struct stConfig {				// stepper configs
@@ -364,13 +366,34 @@ typedef struct stRunMotor {				// one per controlled motor
 	int32_t substep_accumulator;		// DDA phase angle accumulator
 	uint8_t power_state;				// state machine for managing motor power
 	uint32_t power_systick;				// sys_tick for next motor power state transition
+	uint32_t vref_systick;				// sys_tick when a raised Vref has settled
 } stRunMotor_t;
 
+/* RASTER_SEGMENT_PIXELS_MAX
+ *	Most pixels one segment of a raster move can switch through. cm_raster_line() limits
+ *	the scan feed rate so a nominal segment never crosses more than this.
+ */
+#define RASTER_SEGMENT_PIXELS_MAX 32
+
+typedef struct stRasterSegment {		// spindle PWM changes for one segment of a raster move
+	uint8_t count;						// pixels in the segment (0 if not a raster segment)
+	float ratio;						// segment velocity / requested velocity for dynamic power
+	uint32_t tick[RASTER_SEGMENT_PIXELS_MAX];	// DDA downcount at which each pixel starts
+	uint8_t pixel[RASTER_SEGMENT_PIXELS_MAX];	// pixel power - 0 is off, 255 is full power
+	uint16_t compare[RASTER_SEGMENT_PIXELS_MAX];// PWM compare value for each pixel (set by _load_raster())
+} stRasterSegment_t;
+
 typedef struct stRunSingleton {			// Stepper static values and axis parameters
 	uint16_t magic_start;				// magic number to test memory integrity
 	uint32_t dda_ticks_downcount;		// tick down-counter (unscaled)
 	uint32_t dda_ticks_X_substeps;		// ticks multiplied by scaling factor
 	stRunMotor_t mot[MOTORS];			// runtime motor structures
+	volatile uint8_t stopped_motors;	// motors held still by st_stop_motors() (bitmask)
+
+	stRasterSegment_t *raster;			// raster segment being run
+	uint8_t raster_count;				// pixels to switch (0 if the raster doesn't own the PWM)
+	uint8_t raster_index;				// next pixel to switch
+	uint16_t raster_off;				// PWM compare value for a zero pixel
 	uint16_t magic_end;
 } stRunSingleton_t;
 
@@ -385,6 +408,11 @@ typedef struct stPrepMotor {
 	uint8_t prev_direction;				// travel direction from previous segment run for this motor
 	int8_t step_sign;					// set to +1 or -1 for encoders
 
+	// backlash compensation
+	int8_t backlash_sign;				// direction of the last commanded travel: +1, -1, or 0 if none yet
+	float backlash_position;			// take-up steps injected so far, relative to the commanded steps
+	float backlash_take_up;				// take-up steps injected into this segment
+
 	// following error correction
 	int32_t correction_holdoff;			// count down segments between corrections
 	float corrected_steps;				// accumulated correction steps for the cycle (for diagnostic display only)
@@ -396,6 +424,8 @@ typedef struct stPrepMotor {
 
 } stPrepMotor_t;
 
+#define PREP_ATTACHED_COMMANDS_MAX 5		// a move's attached commands plus dynamic spindle power
+
 typedef struct stPrepSingleton {
 	uint16_t magic_start;				// magic number to test memory integrity
 	volatile uint8_t buffer_state;		// prep buffer state - owned by exec or loader
@@ -407,6 +437,11 @@ typedef struct stPrepSingleton {
 	uint32_t dda_ticks_X_substeps;		// DDA ticks scaled by substep factor
 	stPrepMotor_t mot[MOTORS];			// prep time motor structs
 	volatile uint8_t exec_isbusy;       // are the stepper interrupts firing?
+
+	uint8_t attached_count;				// commands to run when the next segment loads
+	void (*attached_func[PREP_ATTACHED_COMMANDS_MAX])(float[], float[]);
+	float attached_value[PREP_ATTACHED_COMMANDS_MAX];
+	stRasterSegment_t *raster;			// raster pixels for the next segment (swapped with st_run on load)
 	uint16_t magic_end;
 } stPrepSingleton_t;
 
@@ -427,6 +462,7 @@ stat_t st_clc(nvObj_t *nv);
 void st_energize_motors(float timeout_seconds);
 void st_deenergize_motors(void);
 void st_set_motor_power(const uint8_t motor);
+void st_pre_energize_motors(const float unit[]);
 stat_t st_motor_power_callback(void);
 
 void st_request_exec_move(void);
@@ -434,13 +470,19 @@ void st_request_load_move(void);
 void st_prep_null(void);
 void st_prep_command(void *bf);		// use a void pointer since we don't know about mpBuf_t yet)
 void st_prep_dwell(float microseconds);
+void st_prep_attached_command(void (*func)(float[], float[]), float value);
+void st_prep_raster(const float fraction[], const uint8_t pixel[], uint8_t count, float ratio, float segment_time);
 stat_t st_prep_line(float travel_steps[], float following_error[], float segment_time);
+void st_stop_motors(uint8_t motors);
+void st_release_motors(uint8_t motors);
 
+stat_t st_set_ma(nvObj_t *nv);
 stat_t st_set_sa(nvObj_t *nv);
 stat_t st_set_tr(nvObj_t *nv);
 stat_t st_set_mi(nvObj_t *nv);
 stat_t st_set_pm(nvObj_t *nv);
 stat_t st_set_pl(nvObj_t *nv);
+stat_t st_set_hs(nvObj_t *nv);
 stat_t st_set_mt(nvObj_t *nv);
 stat_t st_set_md(nvObj_t *nv);
 stat_t st_set_me(nvObj_t *nv);
@@ -455,6 +497,8 @@ stat_t st_set_me(nvObj_t *nv);
 	void st_print_pm(nvObj_t *nv);
 	void st_print_pl(nvObj_t *nv);
 	void st_print_pli(nvObj_t *nv);
+	void st_print_hs(nvObj_t *nv);
+	void st_print_ho(nvObj_t *nv);
 	void st_print_mt(nvObj_t *nv);
 	void st_print_me(nvObj_t *nv);
 	void st_print_md(nvObj_t *nv);
@@ -469,6 +513,8 @@ stat_t st_set_me(nvObj_t *nv);
 	#define st_print_pm tx_print_stub
 	#define st_print_pl tx_print_stub
 	#define st_print_pli tx_print_stub
+	#define st_print_hs tx_print_stub
+	#define st_print_ho tx_print_stub
 	#define st_print_mt tx_print_stub
 	#define st_print_me tx_print_stub
 	#define st_print_md tx_print_stub
@@ -32,12 +32,9 @@
  *	  - Hitting a homing switch puts the current move into feedhold
  *	  - Hitting a limit switch causes the machine to shut down and go into lockdown until reset
  *
- * 	The normally open switch modes (NO) trigger an interrupt on the falling edge
- *	and lockout subsequent interrupts for the defined lockout period. This approach
- *	beats doing debouncing as an integration as switches fire immediately.
- *
- * 	The normally closed switch modes (NC) trigger an interrupt on the rising edge
- *	and lockout subsequent interrupts for the defined lockout period. Ditto on the method.
+ * 	The normally open switch modes (NO) close on the falling edge of the pin and the
+ *	normally closed switch modes (NC) close on the rising edge. Both are debounced
+ *	the same way - see "Switch sampling and debouncing" below.
  */
 
 #include "tinyg2.h"
@@ -46,6 +43,9 @@
 #include "switch.h"
 #include "hardware.h"
 #include "canonical_machine.h"
+#include "encoder.h"
+#include "stepper.h"
+#include "kinematics.h"
 #include "text_parser.h"
 
 #ifdef __AVR
@@ -70,6 +70,63 @@ static void _no_action(switch_t *s) { return; }
 //static void _led_off(switch_t *s) { IndicatorLed.set(); }
 
 
+/*
+ * Switch sampling and debouncing
+ *
+ *	Switches are sampled as whole PIO port words from the SysTick interrupt, once per
+ *	millisecond, so switch latency does not depend on how long the main loop takes.
+ *	Each port is debounced with a 2 bit vertical counter - one counter per pin, held
+ *	as two bit planes so all 32 pins of a port are counted in a handful of word ops.
+ *	A pin's counter runs while its sample differs from the debounced state and is
+ *	cleared as soon as they agree again. A pin changes state after SW_DEBOUNCE_SAMPLES
+ *	consecutive differing samples, which rejects contact bounce without a lockout.
+ *
+ *	Debounced edges are accumulated per port in the rising and falling masks.
+ *	poll_switches() runs from the main loop: it returns at once if nothing changed,
+ *	and otherwise maps the edge bits back to their switches and runs the callbacks
+ *	only for switches that actually changed state.
+ */
+
+#define SW_DEBOUNCE_SAMPLES 4		// consecutive samples (ms) for a change - fixed by the 2 bit counter
+
+#ifdef __ARM
+static Pio * const _switch_pio[SW_PORTS] = {	// port index 0-3 is PIOA-PIOD
+	PIOA,
+	PIOB,
+#ifdef PIOC
+	PIOC,
+#else
+	NULL,
+#endif
+#ifdef PIOD
+	PIOD,
+#else
+	NULL,
+#endif
+};
+#endif
+
+/*
+ * _bind_pin() - record the port and pin bit of a switch and add it to the port mask
+ *
+ *	Pins that are not assigned on a board have a NULL port letter and are skipped.
+ */
+
+#define _bind_switch(axis, position, pin_num) \
+	_bind_pin(&sw.s[axis][position], Pin<pin_num>::portLetter, Pin<pin_num>::mask)
+
+static void _bind_pin(switch_t *s, uint8_t port_letter, uint32_t mask)
+{
+	if ((port_letter < 'A') || (port_letter >= ('A' + SW_PORTS)) || (mask == 0)) {
+		s->port = SW_NO_PORT;
+		s->pin_mask = 0;
+		return;
+	}
+	s->port = port_letter - 'A';
+	s->pin_mask = mask;
+	sw.port[s->port].mask |= mask;
+}
+
 /*
  * switch_init() - initialize homing/limit switches
  * switch_reset() - reset homing/limit switches (no initialization)
@@ -82,115 +139,165 @@ static void _no_action(switch_t *s) { return; }
 
 void switch_init(void)
 {
+	for (uint8_t axis=0; axis<SW_PAIRS; axis++) {
+		for (uint8_t position=0; position<SW_POSITIONS; position++) {
+			sw.s[axis][position].port = SW_NO_PORT;
+		}
+	}
+	for (uint8_t i=0; i<SW_PORTS; i++) {
+		sw.port[i].mask = 0;
+	}
+	_bind_switch(AXIS_X, SW_MIN, kXAxis_MinPinNumber);
+	_bind_switch(AXIS_X, SW_MAX, kXAxis_MaxPinNumber);
+	_bind_switch(AXIS_Y, SW_MIN, kYAxis_MinPinNumber);
+	_bind_switch(AXIS_Y, SW_MAX, kYAxis_MaxPinNumber);
+	_bind_switch(AXIS_Z, SW_MIN, kZAxis_MinPinNumber);
+	_bind_switch(AXIS_Z, SW_MAX, kZAxis_MaxPinNumber);
+#ifndef __POCKETNC
+#if (HOMING_AXES >= 4)
+	_bind_switch(AXIS_A, SW_MIN, kAAxis_MinPinNumber);
+	_bind_switch(AXIS_A, SW_MAX, kAAxis_MaxPinNumber);
+#endif
+#if (HOMING_AXES >= 5)
+	_bind_switch(AXIS_B, SW_MIN, kBAxis_MinPinNumber);
+	_bind_switch(AXIS_B, SW_MAX, kBAxis_MaxPinNumber);
+#endif
+#if (HOMING_AXES >= 6)
+	_bind_switch(AXIS_C, SW_MIN, kCAxis_MinPinNumber);
+	_bind_switch(AXIS_C, SW_MAX, kCAxis_MaxPinNumber);
+#endif
+#else	// __POCKETNC
+	// Pocket NC remaps Xmin to Amax and Ymin to Bmax
+	_bind_switch(AXIS_A, SW_MIN, kAAxis_MinPinNumber);
+	_bind_switch(AXIS_A, SW_MAX, kXAxis_MinPinNumber);
+	_bind_switch(AXIS_B, SW_MIN, kBAxis_MinPinNumber);
+	_bind_switch(AXIS_B, SW_MAX, kYAxis_MinPinNumber);
+#endif
+
+#if defined(__ARM) && !defined(__POCKETNC)
+	// pin change interrupts are only used for edge capture; switch state is still sampled
+	axis_X_min_pin.setInterrupts(kPinInterruptOnChange | kPinInterruptPriorityHigh);
+	axis_X_max_pin.setInterrupts(kPinInterruptOnChange | kPinInterruptPriorityHigh);
+	axis_Y_min_pin.setInterrupts(kPinInterruptOnChange | kPinInterruptPriorityHigh);
+	axis_Y_max_pin.setInterrupts(kPinInterruptOnChange | kPinInterruptPriorityHigh);
+	axis_Z_min_pin.setInterrupts(kPinInterruptOnChange | kPinInterruptPriorityHigh);
+	axis_Z_max_pin.setInterrupts(kPinInterruptOnChange | kPinInterruptPriorityHigh);
+#if (HOMING_AXES >= 4)
+	axis_A_min_pin.setInterrupts(kPinInterruptOnChange | kPinInterruptPriorityHigh);
+	axis_A_max_pin.setInterrupts(kPinInterruptOnChange | kPinInterruptPriorityHigh);
+#endif
+#endif
 	return(switch_reset());
 }
 
+/*
+ *	switch_reset() starts every enabled switch as open, and seeds the debounced pin
+ *	levels with each switch's open level. A switch that is closed at reset is then
+ *	picked up as a leading edge once it has been sampled for the debounce period.
+ */
+
 void switch_reset(void)
 {
 	switch_t *s;	// shorthand
+	uint32_t open_levels[SW_PORTS] = {0};
+
 	for (uint8_t axis=0; axis<SW_PAIRS; axis++) {
 		for (uint8_t position=0; position<SW_POSITIONS; position++) {
 			s = &sw.s[axis][position];
-			s->state = false;
+			s->state = (s->mode == SW_MODE_DISABLED) ? SW_DISABLED : SW_OPEN;
 			s->edge = SW_NO_EDGE;
-			s->debounce_ticks = SW_LOCKOUT_TICKS;
-			s->debounce_timeout = 0;
+			if ((s->port != SW_NO_PORT) && (s->type == SW_TYPE_NORMALLY_OPEN)) {
+				open_levels[s->port] |= s->pin_mask;	// NO switches read high when open
+			}
 
 			// functions bound to each switch
-			s->when_open = _no_action;
-			s->when_closed = _no_action;
             if(s->mode & SW_LIMIT_BIT)
                 s->on_leading = _trigger_alarm;
             else
                 s->on_leading = _no_action;
 			s->on_trailing = _no_action;
+			s->capture_armed = false;
+			s->captured = false;
+			s->stop_motors = 0;
 		}
 	}
-	// bind functions to individual switches
-	// <none>
-	// sw.s[AXIS_X][SW_MIN].when_open = _led_off;
-	// sw.s[AXIS_X][SW_MIN].when_closed = _led_on;
+
+#ifdef __ARM
+	__disable_irq();							// the sampler runs from SysTick
+#endif
+	for (uint8_t i=0; i<SW_PORTS; i++) {
+		sw_port_t *p = &sw.port[i];
+		p->state = open_levels[i];
+		p->count0 = 0;
+		p->count1 = 0;
+		p->rising = 0;
+		p->falling = 0;
+	}
+	sw.edges_pending = false;
+#ifdef __ARM
+	__enable_irq();
+#endif
 }
 
 /*
- * poll_switches() - run a polling cycle on all switches
+ * _sample_switches() - sample and debounce all switch ports (called from SysTick)
+ *
+ *	Per pin, while the sample (delta) differs from the debounced state the counter
+ *	steps 0,1,2,3 and wraps to 0, and the state toggles on the wrap. count1:count0
+ *	is the 2 bit counter for each pin.
  */
-#ifndef __POCKETNC
-stat_t poll_switches()
+
+static void _sample_switches(void)
 {
-    poll_switch(&sw.s[AXIS_X][SW_MIN], (bool)axis_X_min_pin);
-    poll_switch(&sw.s[AXIS_X][SW_MAX], (bool)axis_X_max_pin);
-    poll_switch(&sw.s[AXIS_Y][SW_MIN], (bool)axis_Y_min_pin);
-    poll_switch(&sw.s[AXIS_Y][SW_MAX], (bool)axis_Y_max_pin);
-    poll_switch(&sw.s[AXIS_Z][SW_MIN], (bool)axis_Z_min_pin);
-    poll_switch(&sw.s[AXIS_Z][SW_MAX], (bool)axis_Z_max_pin);
-#if (HOMING_AXES >= 4)
-    poll_switch(&sw.s[AXIS_A][SW_MIN], (bool)axis_A_min_pin);
-    poll_switch(&sw.s[AXIS_A][SW_MAX], (bool)axis_A_max_pin);
-#endif
-#if (HOMING_AXES >= 5)
-    poll_switch(&sw.s[AXIS_B][SW_MIN], (bool)axis_B_min_pin);
-    poll_switch(&sw.s[AXIS_B][SW_MAX], (bool)axis_B_max_pin);
-#endif
-#if (HOMING_AXES >= 6)
-    poll_switch(&sw.s[AXIS_C][SW_MIN], (bool)axis_C_min_pin);
-    poll_switch(&sw.s[AXIS_C][SW_MAX], (bool)axis_C_max_pin);
+#ifdef __ARM
+	uint8_t edges = false;
+
+	for (uint8_t i=0; i<SW_PORTS; i++) {
+		sw_port_t *p = &sw.port[i];
+		if (p->mask == 0) continue;
+
+		uint32_t delta = (_switch_pio[i]->PIO_PDSR & p->mask) ^ p->state;
+		p->count1 = (p->count1 ^ p->count0) & delta;
+		p->count0 = ~p->count0 & delta;
+		uint32_t toggle = delta & ~(p->count0 | p->count1);
+		if (toggle == 0) continue;
+
+		p->state ^= toggle;
+		p->rising |= (toggle & p->state);
+		p->falling |= (toggle & ~p->state);
+		edges = true;
+	}
+	if (edges) sw.edges_pending = true;
 #endif
-    return (STAT_OK);
+}
 
-#else	// __POCKETNC
-    // Pocket NC remaps Xmin to Amax and Ymin to Bmax
-    stat_t poll_switches()
-    {
-	poll_switch(&sw.s[AXIS_X][SW_MIN], (bool)axis_X_min_pin);
-	poll_switch(&sw.s[AXIS_X][SW_MAX], (bool)axis_X_max_pin);
-	poll_switch(&sw.s[AXIS_Y][SW_MIN], (bool)axis_Y_min_pin);
-	poll_switch(&sw.s[AXIS_Y][SW_MAX], (bool)axis_Y_max_pin);
-	poll_switch(&sw.s[AXIS_Z][SW_MIN], (bool)axis_Z_min_pin);
-	poll_switch(&sw.s[AXIS_Z][SW_MAX], (bool)axis_Z_max_pin);
-	poll_switch(&sw.s[AXIS_A][SW_MIN], (bool)axis_A_min_pin);
-	poll_switch(&sw.s[AXIS_A][SW_MAX], (bool)axis_X_min_pin);
-	poll_switch(&sw.s[AXIS_B][SW_MIN], (bool)axis_B_min_pin);
-	poll_switch(&sw.s[AXIS_B][SW_MAX], (bool)axis_Y_min_pin);
-	return (STAT_OK);
+#ifdef __ARM
+namespace Motate {
+	void Timer<SysTickTimerNum>::interrupt() { _sample_switches(); }
+} // namespace Motate
 #endif
-}
 
 /*
- * poll_switch() - read switch with NO/NC, debouncing and edge detection
+ * _switch_edge() - apply a debounced pin level to a switch and run its edge callback
  *
- *	Returns true if switch state changed - e.g. leading or falling edge detected.
  *	Assumes pin_value **input** = 1 means open, 0 is closed.
  *	Pin sense is adjusted to mean:
  *
  *	  0 = open for both NO and NC switches
  *	  1 = closed for both NO and NC switches
  *	 -1 = switch disabled
- *
- *	Also sets disabled switches to switch state -1;
  */
-int8_t poll_switch(switch_t *s, uint8_t pin_value)
+
+static void _switch_edge(switch_t *s, uint8_t pin_value)
 {
-	// instant return conditions: switch disabled or in a lockout period
 	if (s->mode == SW_MODE_DISABLED) {
 		s->state = SW_DISABLED;
-		return (false);
-	}
-	if (s->debounce_timeout > SysTickTimer.getValue()) {
-		return (false);
+		return;
 	}
-	// return if no change in state
 	uint8_t pin_sense_corrected = (pin_value ^ (s->type ^ 1));	// correct for NO or NC mode
-	if ( s->state == pin_sense_corrected ) {
-		s->edge = SW_NO_EDGE;
-		if (s->state == SW_OPEN) {
-			s->when_open(s);
-		} else {
-			s->when_closed(s);
-		}
-		return (false);
+	if (s->state == pin_sense_corrected) {
+		return;
 	}
-	// the switch legitimately changed state - process edges
 	if ((s->state = pin_sense_corrected) == SW_OPEN) {
 		s->edge = SW_TRAILING;
 		s->on_trailing(s);
@@ -198,8 +305,57 @@ int8_t poll_switch(switch_t *s, uint8_t pin_value)
 		s->edge = SW_LEADING;
 		s->on_leading(s);
 	}
-	s->debounce_timeout = (SysTickTimer.getValue() + s->debounce_ticks);
-	return (true);
+}
+
+/*
+ * poll_switches() - dispatch debounced switch edges
+ *
+ *	A pin that bounced through both edges since the last pass is dispatched as both
+ *	edges, ending in its current state, so a short closure is never lost.
+ */
+
+stat_t poll_switches()
+{
+	if (sw.edges_pending == false) {
+		return (STAT_NOOP);
+	}
+
+	uint32_t rising[SW_PORTS];
+	uint32_t falling[SW_PORTS];
+	uint32_t state[SW_PORTS];
+
+#ifdef __ARM
+	__disable_irq();
+#endif
+	sw.edges_pending = false;
+	for (uint8_t i=0; i<SW_PORTS; i++) {
+		rising[i] = sw.port[i].rising;
+		falling[i] = sw.port[i].falling;
+		state[i] = sw.port[i].state;
+		sw.port[i].rising = 0;
+		sw.port[i].falling = 0;
+	}
+#ifdef __ARM
+	__enable_irq();
+#endif
+
+	for (uint8_t axis=0; axis<SW_PAIRS; axis++) {
+		for (uint8_t position=0; position<SW_POSITIONS; position++) {
+			switch_t *s = &sw.s[axis][position];
+			if (s->port == SW_NO_PORT) continue;
+
+			uint32_t mask = s->pin_mask;
+			uint8_t port = s->port;
+			if (((rising[port] | falling[port]) & mask) == 0) continue;
+
+			uint8_t pin_value = ((state[port] & mask) != 0);
+			if ((rising[port] & mask) && (falling[port] & mask)) {
+				_switch_edge(s, pin_value ^ 1);
+			}
+			_switch_edge(s, pin_value);
+		}
+	}
+	return (STAT_OK);
 }
 
 //static void _trigger_feedhold(switch_t *s)
@@ -247,6 +403,95 @@ void reset_limit_switches(void)
     }
 }
 
+/*
+ * Edge capture
+ *
+ *	Switches are only sampled once per millisecond and debounced, and the position read
+ *	after the resulting feedhold includes the deceleration distance. To get the position at
+ *	the instant a switch changed, homing and probing arm a capture on the switch. The pin
+ *	change interrupt then snapshots the motor step counts on the first edge into the armed
+ *	state. There is no debounce on the capture: the first edge is the one we want.
+ *
+ *	sw_arm_capture()	- capture on the next edge into state (SW_OPEN or SW_CLOSED)
+ *	sw_arm_motor_stop() - as sw_arm_capture(), and also stop motors on the edge (st_stop_motors())
+ *	sw_disarm_capture() - cancel a capture and forget any captured position
+ *	sw_get_capture()	- if a capture was taken, convert it to axis positions in travel[]
+ *						  and return true. Axes without a motor are left untouched.
+ *						  Z is uncompensated, like the runtime position.
+ *
+ *	Captures are only taken on ARM. Elsewhere sw_get_capture() always returns false and
+ *	callers fall back to the runtime position, and motors are never stopped.
+ */
+
+void sw_arm_capture(uint8_t axis, uint8_t position, uint8_t state)
+{
+	switch_t *s = &sw.s[axis][position];
+	s->captured = false;
+	s->capture_state = state;
+	s->stop_motors = 0;
+	s->capture_armed = true;
+}
+
+void sw_arm_motor_stop(uint8_t axis, uint8_t position, uint8_t state, uint8_t motors)
+{
+	switch_t *s = &sw.s[axis][position];
+	s->captured = false;
+	s->capture_state = state;
+	s->stop_motors = motors;
+	s->capture_armed = true;
+}
+
+void sw_disarm_capture(uint8_t axis, uint8_t position)
+{
+	sw.s[axis][position].capture_armed = false;
+	sw.s[axis][position].captured = false;
+	sw.s[axis][position].stop_motors = 0;
+}
+
+bool sw_get_capture(uint8_t axis, uint8_t position, float travel[])
+{
+	switch_t *s = &sw.s[axis][position];
+	if (s->captured == false) return (false);
+
+	float steps[MOTORS];
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		steps[motor] = (float)s->capture_steps[motor];
+	}
+	fk_kinematics(steps, travel);
+	travel[AXIS_Z] -= cm_get_grid_offset(travel);	// the steps include probing grid compensation
+	return (true);
+}
+
+#if defined(__ARM) && !defined(__POCKETNC)
+
+static void _capture_switch(switch_t *s, uint8_t pin_value)
+{
+	if (s->capture_armed == false) return;
+	if ((pin_value ^ (s->type ^ 1)) != s->capture_state) return;	// correct for NO or NC mode
+
+	if (s->stop_motors != 0) {
+		st_stop_motors(s->stop_motors);
+	}
+	en_capture_steps(s->capture_steps);
+	s->capture_armed = false;
+	s->captured = true;
+}
+
+namespace Motate {
+	void Pin<kXAxis_MinPinNumber>::interrupt() { _capture_switch(&sw.s[AXIS_X][SW_MIN], (bool)axis_X_min_pin); }
+	void Pin<kXAxis_MaxPinNumber>::interrupt() { _capture_switch(&sw.s[AXIS_X][SW_MAX], (bool)axis_X_max_pin); }
+	void Pin<kYAxis_MinPinNumber>::interrupt() { _capture_switch(&sw.s[AXIS_Y][SW_MIN], (bool)axis_Y_min_pin); }
+	void Pin<kYAxis_MaxPinNumber>::interrupt() { _capture_switch(&sw.s[AXIS_Y][SW_MAX], (bool)axis_Y_max_pin); }
+	void Pin<kZAxis_MinPinNumber>::interrupt() { _capture_switch(&sw.s[AXIS_Z][SW_MIN], (bool)axis_Z_min_pin); }
+	void Pin<kZAxis_MaxPinNumber>::interrupt() { _capture_switch(&sw.s[AXIS_Z][SW_MAX], (bool)axis_Z_max_pin); }
+#if (HOMING_AXES >= 4)
+	void Pin<kAAxis_MinPinNumber>::interrupt() { _capture_switch(&sw.s[AXIS_A][SW_MIN], (bool)axis_A_min_pin); }
+	void Pin<kAAxis_MaxPinNumber>::interrupt() { _capture_switch(&sw.s[AXIS_A][SW_MAX], (bool)axis_A_max_pin); }
+#endif
+} // namespace Motate
+
+#endif // __ARM && !__POCKETNC
+
 /*
  * get_switch_mode() - return switch mode setting
  * get_switch_type() - return switch type setting
@@ -264,7 +509,7 @@ uint8_t get_switch_type(uint8_t axis, uint8_t position)
 
 /*
  * read_switch() - read switch state from the switch structure
- *				   NOTE: This does NOT read the pin itself. See poll_switch
+ *				   NOTE: This does NOT read the pin itself. See poll_switches
  */
 int8_t read_switch(uint8_t axis, uint8_t position)
 {
@@ -81,7 +81,8 @@ enum swEdge {
 	SW_TRAILING,
 };
 
-#define SW_LOCKOUT_TICKS 50			// milliseconds to go dead after switch firing
+#define SW_PORTS 4					// PIO ports A-D that can carry switch pins
+#define SW_NO_PORT 0xFF				// switch has no pin on this board
 
 /*
  * Switch control structures
@@ -94,18 +95,34 @@ typedef struct swSwitch {						// one struct per switch
 	uint8_t limit_switch_thrown;    // if this is configured as a limit switch, 1 = limit switch has been triggered
 
 	// private
-	uint8_t edge;								// keeps a transient record of edges for immediate inquiry
-	uint16_t debounce_ticks;					// number of millisecond ticks for debounce lockout
-	uint32_t debounce_timeout;					// time to expire current debounce lockout, or 0 if no lockout
-	void (*when_open)(struct swSwitch *s);		// callback to action function when sw is open - passes *s, returns void
-	void (*when_closed)(struct swSwitch *s);	// callback to action function when closed
+	uint8_t edge;								// record of the last edge for immediate inquiry
+	uint8_t port;								// index of the PIO port the pin is on, or SW_NO_PORT
+	uint32_t pin_mask;							// pin bit in the port word
 	void (*on_leading)(struct swSwitch *s);		// callback to action function for leading edge onset
 	void (*on_trailing)(struct swSwitch *s);	// callback to action function for trailing edge
+
+	// edge capture (ARM) - see sw_arm_capture()
+	volatile uint8_t capture_armed;				// true while waiting for the capture edge
+	volatile uint8_t captured;					// true once capture_steps is valid
+	uint8_t capture_state;						// switch state to capture on: SW_OPEN or SW_CLOSED
+	int32_t capture_steps[MOTORS];				// motor step positions at the instant of the edge
+	uint8_t stop_motors;						// motors to stop on the capture edge (bitmask)
 } switch_t;
 typedef void (*sw_callback)(switch_t *s);		// typedef for switch action callback
 
+typedef struct swPort {							// one struct per PIO port, one bit per switch pin
+	uint32_t mask;								// switch pins on this port, 0 if none
+	uint32_t state;								// debounced pin levels
+	uint32_t count0;							// vertical debounce counter, low bits
+	uint32_t count1;							// vertical debounce counter, high bits
+	volatile uint32_t rising;					// debounced rising edges not yet dispatched
+	volatile uint32_t falling;					// debounced falling edges not yet dispatched
+} sw_port_t;
+
 typedef struct swSwitchArray {					// array of switches
 	switch_t s[SW_PAIRS][SW_POSITIONS];
+	sw_port_t port[SW_PORTS];
+	volatile uint8_t edges_pending;				// set by the sampler when any port has undispatched edges
 } switches_t;
 extern switches_t sw;
 
@@ -115,13 +132,17 @@ extern switches_t sw;
 void switch_init(void);
 void switch_reset(void);
 stat_t poll_switches(void);
-int8_t poll_switch(switch_t *s, uint8_t pin_value);
 uint8_t get_switch_mode(uint8_t axis, uint8_t position);
 uint8_t get_switch_type(uint8_t axis, uint8_t position);
 int8_t read_switch(uint8_t axis, uint8_t position);
 uint8_t get_limit_switch_thrown(void);
 void reset_limit_switches(void);
 
+void sw_arm_capture(uint8_t axis, uint8_t position, uint8_t state);
+void sw_arm_motor_stop(uint8_t axis, uint8_t position, uint8_t state, uint8_t motors);
+void sw_disarm_capture(uint8_t axis, uint8_t position);
+bool sw_get_capture(uint8_t axis, uint8_t position, float travel[]);
+
 /*
  * Switch config accessors and text functions
  */
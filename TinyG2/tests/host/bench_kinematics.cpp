@@ -0,0 +1,136 @@
+/*
+ * bench_kinematics.cpp - host benchmark of the kinematics transforms (kinematics.cpp)
+ * This file is part of the TinyG project
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ *	kinematics.cpp is built unchanged for the host. The few firmware functions it calls
+ *	are stubbed below. For each kinematics type the benchmark times ik_kinematics() and
+ *	fk_kinematics() over a ring of points inside the delta workspace, checks that the
+ *	forward transform gives back the point, and prints nanoseconds per call.
+ *
+ *	The host numbers are for catching regressions between builds and say nothing about
+ *	the board, which has no FPU and runs every float operation as a library call. See the
+ *	_delta_inverse() notes in kinematics.cpp for the on-target estimate.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+
+#include "tinyg2.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "stepper.h"
+#include "kinematics.h"
+
+cmSingleton_t cm;
+stConfig_t st_cfg;
+
+// firmware stubs
+void mp_set_steps_to_runtime_position() {}
+uint8_t cm_get_units_mode(GCodeState_t *gcode_state) { return (MILLIMETERS);}
+stat_t set_ui8(nvObj_t *nv) { return (STAT_OK);}		// the benchmark sets kin.type itself
+stat_t set_flu(nvObj_t *nv) { return (STAT_OK);}
+void text_print_ui8(nvObj_t *nv, const char *format) {}
+void text_print_flt_units(nvObj_t *nv, const char *format, const char *units) {}
+
+#define BENCH_POINTS 64					// points on the ring - keeps the inputs varied
+#define BENCH_PASSES 20000				// passes over the ring per transform
+
+static volatile float sink;				// keeps the optimizer from dropping the calls
+
+static void _set_kin(uint8_t type)
+{
+	nvObj_t nv;
+	nv.value = type;
+	kin.type = type;
+	kin.delta_arm_length = 250;
+	kin.delta_radius = 120;
+	ik_set_kin(&nv);
+}
+
+static double _elapsed_ns(std::chrono::steady_clock::time_point start, uint32_t calls)
+{
+	std::chrono::duration<double, std::nano> ns = std::chrono::steady_clock::now() - start;
+	return (ns.count() / calls);
+}
+
+static int _bench(const char *name, uint8_t type)
+{
+	float travel[BENCH_POINTS][AXES] = {};
+	float steps[BENCH_POINTS][MOTORS];
+	float check[AXES];
+	float error = 0;
+
+	_set_kin(type);
+	for (uint8_t i=0; i<BENCH_POINTS; i++) {
+		float angle = 2 * M_PI * i / BENCH_POINTS;
+		travel[i][AXIS_X] = 60 * cos(angle);
+		travel[i][AXIS_Y] = 60 * sin(angle);
+		travel[i][AXIS_Z] = -10 - i % 8;
+		ik_kinematics(travel[i], steps[i]);
+		memcpy(check, travel[i], sizeof(check));
+		fk_kinematics(steps[i], check);
+		for (uint8_t a=0; a<AXES; a++) {
+			error = std::max(error, (float)fabs(check[a] - travel[i][a]));
+		}
+	}
+
+	uint32_t calls = BENCH_POINTS * BENCH_PASSES;
+	float out[AXES];
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t p=0; p<BENCH_PASSES; p++) {
+		for (uint8_t i=0; i<BENCH_POINTS; i++) {
+			ik_kinematics(travel[i], out);
+			sink = out[MOTOR_1];
+		}
+	}
+	double ik_ns = _elapsed_ns(start, calls);
+
+	start = std::chrono::steady_clock::now();
+	for (uint32_t p=0; p<BENCH_PASSES; p++) {
+		for (uint8_t i=0; i<BENCH_POINTS; i++) {
+			memcpy(out, travel[i], sizeof(out));
+			fk_kinematics(steps[i], out);
+			sink = out[AXIS_X];
+		}
+	}
+	double fk_ns = _elapsed_ns(start, calls);
+
+	bool ok = (error < 0.01);
+	printf("%-10s ik_kinematics %7.1f ns   fk_kinematics %7.1f ns   round trip error %.5f mm%s\n",
+		name, ik_ns, fk_ns, error, ok ? "" : "  FAIL");
+	return (ok ? 0 : 1);
+}
+
+int main()
+{
+	for (uint8_t m=0; m<MOTORS; m++) {
+		st_cfg.mot[m].motor_map = (m < 3) ? m : AXIS_A;	// X, Y, Z and a rotary
+		st_cfg.mot[m].steps_per_unit = (m < 3) ? 80 : 8.888889;
+	}
+	for (uint8_t a=0; a<AXES; a++) {
+		cm.a[a].axis_mode = AXIS_STANDARD;
+	}
+	cm.motion_state = MOTION_STOP;
+	ik_map_motors();
+
+	int fail = 0;
+	fail += _bench("cartesian", KINEMATICS_CARTESIAN);
+	fail += _bench("corexy", KINEMATICS_COREXY);
+	fail += _bench("delta", KINEMATICS_DELTA);
+	return (fail);
+}
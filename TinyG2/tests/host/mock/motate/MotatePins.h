@@ -0,0 +1,30 @@
+/*
+ * MotatePins.h - host mock of the Motate pins used by the host tests
+ *
+ *	Only what fatfs/diskio.cpp touches: the card detect pin. Its level comes
+ *	from sim_pin_get(), which the test supplies.
+ */
+
+#ifndef MOTATEPINS_H_ONCE
+#define MOTATEPINS_H_ONCE
+
+#include <stdint.h>
+
+int sim_pin_get(int pin_number);					// supplied by the test
+
+namespace Motate {
+
+	enum PinMode {
+		kUnchanged = 0,
+		kOutput,
+		kInput
+	};
+
+	template<int pinNum>
+	struct Pin {
+		Pin(const PinMode type = kUnchanged) {};
+		int get() { return (sim_pin_get(pinNum));};
+	};
+}
+
+#endif // End of include guard: MOTATEPINS_H_ONCE
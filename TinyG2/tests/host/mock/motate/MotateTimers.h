@@ -0,0 +1,23 @@
+/*
+ * MotateTimers.h - host mock of the Motate SysTick timer used by the host tests
+ *
+ *	Time only moves when it is read: each getValue() call advances the clock by
+ *	one millisecond. Busy-wait loops with a timeout therefore always terminate,
+ *	and a timeout of N ms means N polls of the device.
+ */
+
+#ifndef MOTATETIMERS_H_ONCE
+#define MOTATETIMERS_H_ONCE
+
+#include <stdint.h>
+
+namespace Motate {
+
+	struct SysTickTimerMock {
+		uint32_t value;
+		uint32_t getValue() { return (value++);};
+	};
+	extern SysTickTimerMock SysTickTimer;				// defined by the test
+}
+
+#endif // End of include guard: MOTATETIMERS_H_ONCE
@@ -0,0 +1,70 @@
+/*
+ * SamSPI.h - host mock of the Motate SPI master used by the host tests
+ *
+ *	Models the SAM3X SPI closely enough to exercise fatfs/diskio.cpp:
+ *	  - A single receive register with a "full" flag (RDRF). Every transfer
+ *		overwrites it, so a write leaves a stale byte for the next read.
+ *	  - read() with the register empty starts a transfer and returns -1; the
+ *		byte comes back on a later call, as on the hardware.
+ *	  - lastXfer releases chip select after the byte.
+ *
+ *	Each byte is exchanged with sim_spi_exchange(), which the test supplies.
+ */
+
+#ifndef SAMSPI_H_ONCE
+#define SAMSPI_H_ONCE
+
+#include <stdint.h>
+#include "motate/MotatePins.h"
+
+uint8_t sim_spi_exchange(uint8_t mosi, bool lastXfer);	// supplied by the test
+
+namespace Motate {
+
+	struct SPIRegisterMock {
+		int16_t rdr;
+		bool rdrf;
+	};
+	extern SPIRegisterMock spi_register;				// defined by the test
+
+	template<int spiPinNumber>
+	struct SPI {
+		SPI(const uint32_t baud = 4000000, const uint16_t options = 0) { spi_register.rdrf = false;};
+
+		int16_t read(const bool lastXfer = false, uint8_t toSendAsNoop = 0) {
+			if (!spi_register.rdrf) {
+				spi_register.rdr = sim_spi_exchange(toSendAsNoop, lastXfer);
+				spi_register.rdrf = true;
+				return -1;
+			}
+			spi_register.rdrf = false;
+			return (spi_register.rdr);
+		};
+
+		int16_t read(uint8_t *buffer, const uint16_t length, bool useLastXfer = true) {
+			int16_t total_read = 0;
+			while (total_read < length) {
+				int16_t ret = read(useLastXfer && (total_read == length-1));
+				if (ret >= 0) {
+					buffer[total_read++] = ret;
+				}
+			}
+			return (total_read);
+		};
+
+		int16_t write(uint8_t data, const bool lastXfer = false) {
+			spi_register.rdr = sim_spi_exchange(data, lastXfer);	// received byte is left in the register
+			spi_register.rdrf = true;
+			return (1);
+		};
+
+		int16_t write(const uint8_t *data, const uint16_t length, bool autoFlush = true) {
+			for (uint16_t i=0; i<length; i++) {
+				write(data[i], autoFlush && (i == length-1));
+			}
+			return (length);
+		};
+	};
+}
+
+#endif // End of include guard: SAMSPI_H_ONCE
@@ -0,0 +1,465 @@
+/*
+ * test_diskio.cpp - host test of the SPI SD card driver (fatfs/diskio.cpp)
+ * This file is part of the TinyG project
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ *	diskio.cpp is built unchanged against the mock Motate headers in mock/. The mock
+ *	SPI hands every byte to sim_spi_exchange(), which runs the simulated card below.
+ *
+ *	The card speaks the SPI mode protocol: command frames and R1/R3/R7 responses,
+ *	single and multiple block reads and writes, CMD12 while streaming, data response
+ *	tokens and busy signalling. It sends 0xFE as its CRC bytes, so a driver that loses
+ *	track of the CRC takes it for the next data token. It also flags protocol abuse,
+ *	such as a data token sent while it is still busy programming.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <set>
+#include <vector>
+
+#include "diskio.h"
+#include "motate/utility/SamSPI.h"
+#include "motate/MotateTimers.h"
+
+namespace Motate {
+	SysTickTimerMock SysTickTimer;
+	SPIRegisterMock spi_register;
+}
+
+/**** Simulated SD card ****/
+
+#define SIM_SECTORS 64
+#define SIM_READ_LATENCY 8			// 0xFF bytes before each data token
+#define SIM_WRITE_BUSY 24			// busy bytes after each programmed block
+#define SIM_STOP_BUSY 4				// busy bytes after CMD12
+#define SIM_INIT_POLLS 3			// ACMD41s before the card leaves idle
+
+enum simState {
+	SIM_COMMAND = 0,				// waiting for a command frame
+	SIM_READ_STREAM,				// sending data blocks (CMD17, CMD18)
+	SIM_WRITE_TOKEN,				// waiting for a data or stop token (CMD24, CMD25)
+	SIM_WRITE_DATA					// receiving a data block
+};
+
+struct simCard {
+	// configuration
+	bool present;
+	bool sdv2;						// answers CMD8
+	bool block_addressing;			// SDHC - otherwise byte addresses
+	std::set<uint32_t> bad_sectors;	// read: error token, write: rejected
+	std::set<uint32_t> silent_sectors;	// read: no data token at all
+
+	// protocol state
+	uint8_t state;
+	bool idle;
+	bool app_command;
+	int init_polls;
+	std::deque<uint8_t> out;		// queued MISO bytes
+	int busy;						// busy (0x00) bytes still to send
+	uint8_t frame[6];
+	int frame_len;
+	bool multi;
+	uint32_t sector;
+	int blocks_sent;
+	bool stream_failed;
+	std::vector<uint8_t> block;
+
+	// observations
+	std::vector<uint8_t> storage;
+	int stops;						// CMD12s received
+	int cs_release_block;			// blocks started when CS was first released in a CMD18, -1 if not
+	int protocol_errors;			// tokens or commands sent while busy, junk where a token was due
+} card;
+
+static void sim_reset(bool sdv2, bool block_addressing)
+{
+	card.present = true;
+	card.sdv2 = sdv2;
+	card.block_addressing = block_addressing;
+	card.bad_sectors.clear();
+	card.silent_sectors.clear();
+	card.state = SIM_COMMAND;
+	card.idle = true;
+	card.app_command = false;
+	card.init_polls = 0;
+	card.out.clear();
+	card.busy = 0;
+	card.frame_len = 0;
+	card.storage.assign(SIM_SECTORS * 512, 0);
+	for (size_t i=0; i<card.storage.size(); i++) {
+		card.storage[i] = (uint8_t)(i * 7 + i / 512);	// distinct per sector
+	}
+	card.stops = 0;
+	card.cs_release_block = -1;
+	card.protocol_errors = 0;
+}
+
+static bool sim_address(uint32_t arg)
+{
+	if (card.block_addressing) {
+		card.sector = arg;
+	} else {
+		if (arg % 512) return (false);
+		card.sector = arg / 512;
+	}
+	return (card.sector < SIM_SECTORS);
+}
+
+static void sim_command()
+{
+	uint8_t cmd = card.frame[0] & 0x3F;
+	uint32_t arg = ((uint32_t)card.frame[1] << 24) | ((uint32_t)card.frame[2] << 16) |
+				   ((uint32_t)card.frame[3] << 8) | card.frame[4];
+	bool app = card.app_command;
+	card.app_command = false;
+
+	if (card.state == SIM_READ_STREAM) {				// only a stop is legal mid-stream
+		if (cmd != 12) { card.protocol_errors++; return;}
+		card.stops++;
+		card.state = SIM_COMMAND;
+		card.out.clear();
+		card.out.push_back(0xFF);						// stuff byte
+		card.out.push_back(0x00);						// R1
+		card.busy = SIM_STOP_BUSY;
+		return;
+	}
+
+	uint8_t r1 = card.idle ? 0x01 : 0x00;
+	card.out.clear();
+	card.out.push_back(0xFF);							// Ncr
+
+	if ((cmd == 0) && (card.frame[5] != 0x95)) { card.out.push_back(0x09); return;}	// CRC error
+	if ((cmd == 8) && (card.frame[5] != 0x87)) { card.out.push_back(0x09); return;}
+
+	switch (cmd) {
+		case 0: { card.idle = true; card.out.push_back(0x01); break;}
+		case 8: {
+			if (!card.sdv2) { card.out.push_back(r1 | 0x04); break;}	// illegal command
+			card.out.push_back(r1);
+			card.out.push_back(0x00); card.out.push_back(0x00);
+			card.out.push_back(arg >> 8 & 0x0F); card.out.push_back(arg & 0xFF);
+			break;
+		}
+		case 55: { card.app_command = true; card.out.push_back(r1); break;}
+		case 41: {
+			if (!app) { card.out.push_back(r1 | 0x04); break;}
+			if (++card.init_polls >= SIM_INIT_POLLS) { card.idle = false;}
+			card.out.push_back(card.idle ? 0x01 : 0x00);
+			break;
+		}
+		case 58: {
+			card.out.push_back(r1);
+			card.out.push_back(card.block_addressing ? 0xC0 : 0x80);
+			card.out.push_back(0xFF); card.out.push_back(0x80); card.out.push_back(0x00);
+			break;
+		}
+		case 16: { card.out.push_back((arg == 512) ? r1 : (r1 | 0x40)); break;}
+		case 23: { card.out.push_back(app ? r1 : (r1 | 0x04)); break;}
+		case 12: { card.out.push_back(r1); break;}
+		case 17:
+		case 18: {
+			if (card.idle) { card.out.push_back(r1 | 0x04); break;}
+			if (!sim_address(arg)) { card.out.push_back(0x20); break;}	// address error
+			card.out.push_back(0x00);
+			card.state = SIM_READ_STREAM;
+			card.multi = (cmd == 18);
+			card.blocks_sent = 0;
+			card.stream_failed = false;
+			break;
+		}
+		case 24:
+		case 25: {
+			if (card.idle) { card.out.push_back(r1 | 0x04); break;}
+			if (!sim_address(arg)) { card.out.push_back(0x20); break;}
+			card.out.push_back(0x00);
+			card.state = SIM_WRITE_TOKEN;
+			card.multi = (cmd == 25);
+			break;
+		}
+		default: card.out.push_back(r1 | 0x04);
+	}
+}
+
+static void sim_next_read_block()
+{
+	if ((!card.multi && card.blocks_sent == 1) || card.stream_failed) {
+		if (!card.multi) { card.state = SIM_COMMAND;}	// a multiple read waits for CMD12
+		return;
+	}
+	for (int i=0; i<SIM_READ_LATENCY; i++) { card.out.push_back(0xFF);}
+	if ((card.sector >= SIM_SECTORS) || card.bad_sectors.count(card.sector)) {
+		card.out.push_back(0x01);						// data error token
+		card.stream_failed = true;
+		return;
+	}
+	if (card.silent_sectors.count(card.sector)) {		// never answers
+		card.stream_failed = true;
+		return;
+	}
+	card.out.push_back(0xFE);
+	for (int i=0; i<512; i++) { card.out.push_back(card.storage[card.sector * 512 + i]);}
+	card.out.push_back(0xFE);							// CRC bytes that look like a data token
+	card.out.push_back(0xFE);
+	card.sector++;
+	card.blocks_sent++;
+}
+
+static void sim_receive(uint8_t mosi)
+{
+	switch (card.state) {
+		case SIM_WRITE_TOKEN: {
+			if (mosi == 0xFF) return;
+			if (card.busy > 0) { card.protocol_errors++;}	// host didn't wait for programming
+			if ((mosi == 0xFE && !card.multi) || (mosi == 0xFC && card.multi)) {
+				card.state = SIM_WRITE_DATA;
+				card.block.clear();
+			} else if (mosi == 0xFD && card.multi) {
+				card.state = SIM_COMMAND;
+				card.out.push_back(0xFF);				// Nbr
+				card.busy = SIM_WRITE_BUSY;
+			} else {
+				card.protocol_errors++;
+			}
+			return;
+		}
+		case SIM_WRITE_DATA: {
+			card.block.push_back(mosi);
+			if (card.block.size() < 514) return;		// data + CRC
+			if (card.bad_sectors.count(card.sector) || card.sector >= SIM_SECTORS) {
+				card.out.push_back(0xED);				// write error
+			} else {
+				memcpy(&card.storage[card.sector * 512], card.block.data(), 512);
+				card.out.push_back(0xE5);				// data accepted
+			}
+			card.sector++;
+			card.busy = SIM_WRITE_BUSY;
+			card.state = card.multi ? SIM_WRITE_TOKEN : SIM_COMMAND;
+			return;
+		}
+		default: {										// command frames, also while streaming
+			if (card.frame_len == 0) {
+				if ((mosi & 0xC0) != 0x40) return;
+				if (card.busy > 0) { card.protocol_errors++;}
+			}
+			card.frame[card.frame_len++] = mosi;
+			if (card.frame_len == 6) {
+				card.frame_len = 0;
+				sim_command();
+			}
+		}
+	}
+}
+
+uint8_t sim_spi_exchange(uint8_t mosi, bool lastXfer)
+{
+	if ((card.state == SIM_READ_STREAM) && card.out.empty()) {
+		sim_next_read_block();
+	}
+	uint8_t miso = 0xFF;
+	if (!card.out.empty()) {
+		miso = card.out.front();
+		card.out.pop_front();
+		if ((card.state == SIM_READ_STREAM) && !card.multi && (card.blocks_sent == 1) && card.out.empty()) {
+			card.state = SIM_COMMAND;					// single block read is complete
+		}
+	} else if (card.busy > 0) {
+		card.busy--;
+		miso = 0x00;
+	}
+	sim_receive(mosi);
+
+	if (lastXfer && (card.state == SIM_READ_STREAM) && card.multi && (card.cs_release_block < 0)) {
+		card.cs_release_block = card.blocks_sent;
+	}
+	return (miso);
+}
+
+int sim_pin_get(int pin_number)
+{
+	return (card.present ? 0 : 1);						// card detect is active low
+}
+
+/**** Test helpers ****/
+
+static int failures = 0;
+static int checks = 0;
+
+#define CHECK(cond) do { checks++; if (!(cond)) { failures++; \
+	printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);}} while (0)
+
+static bool card_idle()									// ready for the next command
+{
+	return ((card.state == SIM_COMMAND) && (card.busy == 0) && card.out.empty());
+}
+
+static bool matches(const uint8_t *buff, uint32_t sector, uint32_t count)
+{
+	return (memcmp(buff, &card.storage[sector * 512], count * 512) == 0);
+}
+
+static void start_card(bool sdv2, bool block_addressing)
+{
+	sim_reset(sdv2, block_addressing);
+	CHECK((disk_initialize(0) & STA_NOINIT) == 0);
+}
+
+/**** Tests ****/
+
+static void test_initialize()
+{
+	BYTE type = 0;
+	start_card(true, true);
+	CHECK(disk_ioctl(0, MMC_GET_TYPE, &type) == RES_OK);
+	CHECK(type == 0x0C);								// CT_SD2 | CT_BLOCK
+
+	start_card(false, false);
+	CHECK(disk_ioctl(0, MMC_GET_TYPE, &type) == RES_OK);
+	CHECK(type == 0x02);								// CT_SD1
+}
+
+static void test_single_block()
+{
+	uint8_t buff[512];
+	start_card(true, true);
+	CHECK(disk_read(0, buff, 5, 1) == RES_OK);
+	CHECK(matches(buff, 5, 1));
+	CHECK(card_idle());
+
+	memset(buff, 0xA5, sizeof(buff));
+	CHECK(disk_write(0, buff, 6, 1) == RES_OK);
+	CHECK(matches(buff, 6, 1));
+	CHECK(card.protocol_errors == 0);
+}
+
+static void test_multiple_block_read()
+{
+	uint8_t buff[4*512];
+	start_card(true, true);
+	CHECK(disk_read(0, buff, 10, 4) == RES_OK);
+	CHECK(matches(buff, 10, 4));						// no CRC taken for a data token
+	CHECK(card.stops == 1);
+	CHECK(card.cs_release_block >= 4);					// CS held until the last block
+	CHECK(card_idle());									// CMD12 busy waited out
+
+	CHECK(disk_read(0, buff, 20, 2) == RES_OK);			// and the card is usable afterwards
+	CHECK(matches(buff, 20, 2));
+	CHECK(disk_read(0, buff, 3, 1) == RES_OK);
+	CHECK(matches(buff, 3, 1));
+	CHECK(card.protocol_errors == 0);
+}
+
+static void test_multiple_block_write()
+{
+	uint8_t buff[4*512];
+	for (size_t i=0; i<sizeof(buff); i++) { buff[i] = (uint8_t)(i ^ (i >> 9));}
+	start_card(true, true);
+	CHECK(disk_write(0, buff, 30, 4) == RES_OK);
+	CHECK(matches(buff, 30, 4));
+	CHECK(card.protocol_errors == 0);					// never sent a token while busy
+	CHECK(card_idle());									// last block programmed before returning
+
+	uint8_t check[4*512];
+	CHECK(disk_read(0, check, 30, 4) == RES_OK);
+	CHECK(memcmp(check, buff, sizeof(buff)) == 0);
+}
+
+static void test_byte_addressing()
+{
+	uint8_t buff[2*512];
+	start_card(false, false);							// SDv1: sector numbers become byte addresses
+	CHECK(disk_read(0, buff, 7, 2) == RES_OK);
+	CHECK(matches(buff, 7, 2));
+	memset(buff, 0x3C, sizeof(buff));
+	CHECK(disk_write(0, buff, 40, 2) == RES_OK);
+	CHECK(matches(buff, 40, 2));
+	CHECK(card.protocol_errors == 0);
+}
+
+static void test_read_errors()
+{
+	uint8_t buff[4*512];
+	start_card(true, true);
+	card.bad_sectors.insert(12);						// error token in the middle of a CMD18
+	CHECK(disk_read(0, buff, 10, 4) == RES_ERROR);
+	CHECK(card.stops == 1);								// still stopped
+	CHECK(card_idle());
+	CHECK(disk_read(0, buff, 20, 2) == RES_OK);
+	CHECK(matches(buff, 20, 2));
+
+	card.silent_sectors.insert(25);						// no data token at all - times out
+	CHECK(disk_read(0, buff, 25, 1) == RES_ERROR);
+	card.state = SIM_COMMAND;							// nothing stops a CMD17 - let the card give up
+	int stops = card.stops;
+	CHECK(disk_read(0, buff, 24, 2) == RES_ERROR);
+	CHECK(card.stops == stops + 1);
+	CHECK(card_idle());
+	card.silent_sectors.clear();
+	CHECK(disk_read(0, buff, 25, 1) == RES_OK);
+	CHECK(matches(buff, 25, 1));
+}
+
+static void test_write_errors()
+{
+	uint8_t buff[4*512];
+	memset(buff, 0x5A, sizeof(buff));
+	start_card(true, true);
+	card.bad_sectors.insert(51);						// rejected block in a CMD25
+	CHECK(disk_write(0, buff, 50, 4) == RES_ERROR);
+	CHECK(matches(buff, 50, 1));						// blocks before it were written
+	CHECK(card_idle());									// stop token sent and waited out
+	CHECK(card.protocol_errors == 0);
+
+	CHECK(disk_write(0, buff, 51, 1) == RES_ERROR);
+	card.bad_sectors.clear();
+	CHECK(disk_write(0, buff, 52, 2) == RES_OK);
+	CHECK(matches(buff, 52, 2));
+}
+
+static void test_not_ready()
+{
+	uint8_t buff[512];
+	start_card(true, true);
+	CHECK(disk_read(0, buff, 0, 0) == RES_PARERR);
+	CHECK(disk_read(1, buff, 0, 1) == RES_PARERR);
+	CHECK(disk_write(0, buff, 0, 0) == RES_PARERR);
+
+	card.present = false;
+	CHECK(disk_status(0) & STA_NODISK);
+	CHECK(disk_read(0, buff, 0, 1) == RES_NOTRDY);
+	CHECK(disk_write(0, buff, 0, 1) == RES_NOTRDY);
+	CHECK(disk_initialize(0) & STA_NOINIT);
+
+	card.present = true;								// reinserted - needs initializing again
+	CHECK(disk_read(0, buff, 0, 1) == RES_NOTRDY);
+	CHECK((disk_initialize(0) & STA_NOINIT) == 0);
+	CHECK(disk_read(0, buff, 0, 1) == RES_OK);
+}
+
+int main()
+{
+	test_initialize();
+	test_single_block();
+	test_multiple_block_read();
+	test_multiple_block_write();
+	test_byte_addressing();
+	test_read_errors();
+	test_write_errors();
+	test_not_ready();
+
+	printf("test_diskio: %d checks, %d failures\n", checks, failures);
+	return (failures ? 1 : 0);
+}
@@ -99,6 +99,7 @@ stat_t text_parser(char_t *str)
 static stat_t _text_parser_kernal(char_t *str, nvObj_t *nv)
 {
 	char_t *rd, *wr;								// read and write pointers
+	char_t *string_value = NULL;					// non-numeric value, if there is one
 //	char_t separators[] = {"="};					// STRICT: only separator allowed is = sign
 	char_t separators[] = {" =:|\t"};				// RELAXED: any separator someone might use
 
@@ -123,6 +124,8 @@ static stat_t _text_parser_kernal(char_t *str, nvObj_t *nv)
 		nv->value = strtof(str, &rd);				// rd used as end pointer
 		if (rd != str) {
 			nv->valuetype = TYPE_FLOAT;
+		} else if (*str != NUL) {
+			string_value = str;
 		}
 	}
 
@@ -132,6 +135,15 @@ static stat_t _text_parser_kernal(char_t *str, nvObj_t *nv)
 	}
 	strcpy_P(nv->group, cfgArray[nv->index].group);	// capture the group string if there is one
 
+	// a non-numeric value is only taken as a string by string settings (e.g. $run=job.nc)
+	if (string_value != NULL) {
+		if ((GET_TABLE_BYTE(flags) & F_STRING) == 0) {
+			return (STAT_BAD_NUMBER_FORMAT);
+		}
+		ritorno(nv_copy_string(nv, string_value));
+		nv->valuetype = TYPE_STRING;
+	}
+
 	// see if you need to strip the token
 	if (nv->group[0] != NUL) {
 		wr = nv->token;
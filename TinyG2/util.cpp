@@ -359,6 +359,39 @@ uint32_t crc32(uint32_t crc, const void *buf, size_t size)
 	return crc ^ ~0U;
 }
 
+/*
+ * base64_decode() - decode a base64 string (RFC 4648, '=' padding optional)
+ *
+ *	Decodes src into at most size bytes of dst. Returns the number of bytes decoded,
+ *	or -1 if the string has an invalid character or doesn't fit.
+ */
+
+int16_t base64_decode(const char_t *src, uint8_t *dst, uint16_t size)
+{
+	uint32_t bits = 0;
+	uint8_t bit_count = 0;
+	uint16_t len = 0;
+
+	for (; (*src != 0) && (*src != '='); src++) {
+		uint8_t c = *src;
+		uint8_t v;
+		if ((c >= 'A') && (c <= 'Z')) { v = c - 'A';} else
+		if ((c >= 'a') && (c <= 'z')) { v = c - 'a' + 26;} else
+		if ((c >= '0') && (c <= '9')) { v = c - '0' + 52;} else
+		if (c == '+') { v = 62;} else
+		if (c == '/') { v = 63;}
+		else { return (-1);}
+
+		bits = (bits << 6) | v;
+		if ((bit_count += 6) >= 8) {
+			bit_count -= 8;
+			if (len >= size) { return (-1);}
+			dst[len++] = (uint8_t)(bits >> bit_count);
+		}
+	}
+	return (len);
+}
+
 /*
  * SysTickTimer_getValue() - this is a hack to get around some compatibility problems
  */
@@ -78,6 +78,7 @@ char_t *pstr2str(const char *pgm_string);
 char_t fntoa(char_t *str, float n, uint8_t precision);
 uint16_t compute_checksum(char_t const *string, const uint16_t length);
 uint32_t crc32(uint32_t crc, const void *buf, size_t size);
+int16_t base64_decode(const char_t *src, uint8_t *dst, uint16_t size);
 
 //*** other utilities ***
 
@@ -40,6 +40,7 @@
 #include "canonical_machine.h"
 #include "xio.h"
 #include "report.h"
+#include "fatfs/ff.h"
 
 /**** Structures ****/
 
@@ -106,11 +107,39 @@ struct xioDeviceWrapper : xioDeviceWrapperBase {	// describes a device for readi
     }
 };
 
+// Job file device. Reads a G-code file from the SD card through two sector-sized buffers.
+// The line reader consumes one buffer while xio_callback() refills the other, so the card
+// is read in whole sectors from the main loop and never from inside a line read.
+// While a job is running the file is the only DATA channel; USB stays bound as CTRL.
+
+struct xioFileDevice {
+	FIL file;								// FatFs file object for the running job
+	bool open;								// a job file is open and bound as the DATA channel
+	bool eof;								// the last block has been read from the card
+	uint8_t last_char;						// last char handed out (to terminate a final unterminated line)
+	uint8_t rd_buf;							// buffer currently being consumed
+	uint16_t rd_pos;						// read position in the current buffer
+	uint16_t len[2];						// valid bytes in each buffer (0 = empty, needs refill)
+	uint8_t buf[2][XIO_FILE_BUFFER_SIZE];	// double buffered read-ahead
+	uint32_t byte_offset;					// bytes handed to the line reader (progress)
+	uint32_t line_number;					// lines handed to the line reader (progress)
+	devflags_t saved_data[DEV_MAX];			// DATA bindings suspended while the job runs
+	char_t filename[XIO_FILENAME_LEN+1];
+
+	int16_t readByte();
+	void flushRead();
+	int16_t write(uint8_t *buffer, int16_t len) { return (-1); }	// read only
+	void fill();
+	void close();
+};
+
 // ALLOCATIONS
-// Declare a device wrapper class for USB0 and USB1 and put pointer in an array as elements 0 and 1
+// Declare a device wrapper class for USB0, USB1 and the job file, and put pointers in an array as elements 0, 1 and 2
+xioFileDevice xioFile;
 xioDeviceWrapper<decltype(&SerialUSB)> serialUSB0Wrapper {&SerialUSB};
 xioDeviceWrapper<decltype(&SerialUSB1)> serialUSB1Wrapper {&SerialUSB1};
-xioDeviceWrapperBase* DeviceWrappers[] {&serialUSB0Wrapper, &serialUSB1Wrapper};
+xioDeviceWrapper<decltype(&xioFile)> file0Wrapper {&xioFile};
+xioDeviceWrapperBase* DeviceWrappers[] {&serialUSB0Wrapper, &serialUSB1Wrapper, &file0Wrapper};
 
 xioDevice_t _ds[DEV_MAX];			// allocate device structures
 
@@ -128,6 +157,7 @@ xioSingleton_t xio;
 // convenience macros
 #define USB0 xio.d[DEV_USB0]				// pointer to device structure for USB0 serial
 #define USB1 xio.d[DEV_USB1]				// pointer to device structure for USB1 serial
+#define FILE0 xio.d[DEV_FILE0]				// pointer to device structure for the SD job file
 
 /**** CODE ****/
 
@@ -165,6 +195,10 @@ void xio_init()
 	});
 	USB1->read_buf_size = USB_LINE_BUFFER_SIZE;
 	USB1->caps = (DEV_CAN_READ | DEV_CAN_WRITE | DEV_CAN_BE_CTRL | DEV_CAN_BE_DATA);
+
+	// setup for SD job file (bound as DATA only while a job is running)
+	FILE0->read_buf_size = USB_LINE_BUFFER_SIZE;
+	FILE0->caps = (DEV_CAN_READ | DEV_CAN_BE_DATA);
 }
 
 /*
@@ -220,12 +254,13 @@ stat_t xio_callback()
     devflags_t usb0state = USB0->getNextFlags(), usb1state = USB1->getNextFlags();
     _xio_callback_helper(usb0state, USB0, DeviceWrappers[DEV_USB0]);
     _xio_callback_helper(usb1state, USB1, DeviceWrappers[DEV_USB1]);
+    if (xioFile.open) xioFile.fill();		// keep the job file read-ahead topped up
     return STAT_OK;
 }
 
 bool _others_connected(xioDevice_t *dev) {
     for(int8_t i = 0; i < DEV_MAX; ++i)
-        if(xio.d[i] != dev && xio.d[i]->isConnected() && xio.d[i]->isActive())
+        if(xio.d[i] != dev && i != DEV_FILE0 && xio.d[i]->isConnected() && xio.d[i]->isActive())
             return true;
     return false;
 }
@@ -325,6 +360,8 @@ int read_char (uint8_t dev)
 {
 	int c = DeviceWrappers[dev]->readchar();
 
+	if (dev == DEV_FILE0) return (c);		// signal chars are only honored from a live channel
+
 	if (c == (int)CHAR_RESET) {	 			// trap kill character
 		hw_request_hard_reset();
 		return (_FDEV_OOB);
@@ -503,6 +540,75 @@ stat_t read_line (uint8_t *buffer, uint16_t *index, size_t size)
 	return (STAT_BUFFER_FULL);
 }
 
+/***********************************************************************************
+ * SD JOB FILE DEVICE
+ *
+ *	readByte()	- return next char from the read-ahead buffers, or _FDEV_ERR if none is ready.
+ *				  Swaps buffers when the current one is used up and releases it for refill.
+ *				  Closes the job after the last char (adding a LF if the file didn't end in one).
+ *	fill()		- refill empty buffers from the card, oldest (current) buffer first. Main loop only.
+ *	flushRead()	- abandon the job. Called by queue flush and estop via xio_flush_device().
+ *	close()		- close the file and hand the DATA channel back to USB
+ ***********************************************************************************/
+
+int16_t xioFileDevice::readByte()
+{
+	if (!open) return (_FDEV_ERR);
+
+	if ((rd_pos >= len[rd_buf]) && (len[rd_buf] != 0)) {	// current buffer used up
+		len[rd_buf] = 0;									// release it for refill
+		rd_buf ^= 1;
+		rd_pos = 0;
+	}
+	if (len[rd_buf] == 0) {									// read-ahead hasn't caught up or we're done
+		if (!eof) return (_FDEV_ERR);
+		if ((last_char != LF) && (last_char != CR) && (byte_offset != 0)) {
+			last_char = LF;									// terminate a final unterminated line
+			return (LF);
+		}
+		close();
+		return (_FDEV_ERR);
+	}
+	last_char = buf[rd_buf][rd_pos++];
+	byte_offset++;
+	if (last_char == LF) line_number++;
+	return (last_char);
+}
+
+void xioFileDevice::fill()
+{
+	for (uint8_t i=0; i<2; i++) {
+		uint8_t b = rd_buf ^ i;
+		if ((len[b] != 0) || eof) continue;
+		UINT br = 0;
+		if (f_read(&file, buf[b], XIO_FILE_BUFFER_SIZE, &br) != FR_OK) {
+			rpt_exception(STAT_FILE_NOT_OPEN, NULL);
+			close();
+			return;
+		}
+		len[b] = br;
+		if (br < XIO_FILE_BUFFER_SIZE) eof = true;
+	}
+}
+
+void xioFileDevice::flushRead()
+{
+	if (open) close();
+}
+
+void xioFileDevice::close()
+{
+	f_close(&file);
+	open = false;
+	len[0] = len[1] = 0;
+	FILE0->flags = DEV_FLAGS_CLEAR;
+	FILE0->read_index = 0;
+	for (uint8_t dev=0; dev < DEV_MAX; dev++) {			// give DATA back to channels that are still active
+		if (xio.d[dev]->isActive()) xio.d[dev]->flags |= saved_data[dev];
+	}
+	sr_request_status_report(SR_REQUEST_IMMEDIATE);		// report final progress
+}
+
 /***********************************************************************************
  * CONFIGURATION AND INTERFACE FUNCTIONS
  * Functions to get and set variables from the cfgArray table
@@ -530,6 +636,66 @@ stat_t xio_set_spi(nvObj_t *nv)
 	return (STAT_OK);
 }
 
+/*
+ * xio_set_run()  - run a G-code job file from the SD card, e.g. $run=job.nc or {"run":"job.nc"}
+ * xio_get_run()  - return name of running job file, or empty string if none
+ * xio_get_runb() - return job progress as bytes read from the file
+ * xio_get_runl() - return job progress as lines read from the file
+ *
+ *	The job file replaces USB as the DATA channel until EOF or a queue flush. USB remains
+ *	the CTRL channel, so feedhold (!), cycle start (~), queue flush (%) and JSON commands
+ *	work as usual. A queue flush abandons the job.
+ */
+stat_t xio_set_run(nvObj_t *nv)
+{
+	if ((nv->valuetype != TYPE_STRING) || (nv->stringp == NULL)) return (STAT_INPUT_VALUE_UNSUPPORTED);
+	if ((xioFile.open) || (cm.cycle_state != CYCLE_OFF)) return (STAT_COMMAND_NOT_ACCEPTED);
+
+	strncpy((char *)xioFile.filename, (char *)*nv->stringp, XIO_FILENAME_LEN);
+	xioFile.filename[XIO_FILENAME_LEN] = NUL;
+	if (f_open(&xioFile.file, (const char *)xioFile.filename, FA_READ | FA_OPEN_EXISTING) != FR_OK) {
+		return (STAT_FILE_NOT_OPEN);
+	}
+	xioFile.open = true;
+	xioFile.eof = false;
+	xioFile.last_char = NUL;
+	xioFile.rd_buf = 0;
+	xioFile.rd_pos = 0;
+	xioFile.len[0] = xioFile.len[1] = 0;
+	xioFile.byte_offset = 0;
+	xioFile.line_number = 0;
+	for (uint8_t dev=0; dev < DEV_MAX; dev++) {			// take over the DATA channel
+		xioFile.saved_data[dev] = xio.d[dev]->flags & DEV_IS_DATA;
+		xio.d[dev]->flags &= ~DEV_IS_DATA;
+	}
+	FILE0->read_index = 0;
+	FILE0->flags = (DEV_IS_DATA | DEV_IS_CONNECTED | DEV_IS_READY | DEV_IS_ACTIVE);
+	xioFile.fill();										// prime both buffers
+	if (!xioFile.open) return (STAT_FILE_NOT_OPEN);		// read failed (channels already restored)
+	return (STAT_OK);
+}
+
+stat_t xio_get_run(nvObj_t *nv)
+{
+	ritorno(nv_copy_string(nv, xioFile.open ? xioFile.filename : (char_t *)""));
+	nv->valuetype = TYPE_STRING;
+	return (STAT_OK);
+}
+
+stat_t xio_get_runb(nvObj_t *nv)
+{
+	nv->value = (float)xioFile.byte_offset;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t xio_get_runl(nvObj_t *nv)
+{
+	nv->value = (float)xioFile.line_number;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
 /***********************************************************************************
  * TEXT MODE SUPPORT
  * Functions to print variables from the cfgArray table
@@ -540,4 +706,11 @@ stat_t xio_set_spi(nvObj_t *nv)
 static const char fmt_spi[] PROGMEM = "[spi] SPI state%20d [0=disabled,1=enabled]\n";
 void xio_print_spi(nvObj_t *nv) { text_print_ui8(nv, fmt_spi);}
 
+static const char fmt_run[] PROGMEM = "[run] SD job file%16s\n";
+static const char fmt_runb[] PROGMEM = "[runb] SD job bytes read%12lu\n";
+static const char fmt_runl[] PROGMEM = "[runl] SD job lines read%12lu\n";
+void xio_print_run(nvObj_t *nv) { text_print_str(nv, fmt_run);}
+void xio_print_runb(nvObj_t *nv) { text_print_int(nv, fmt_runb);}
+void xio_print_runl(nvObj_t *nv) { text_print_int(nv, fmt_runl);}
+
 #endif // __TEXT_MODE
@@ -83,6 +83,8 @@
 #define _FDEV_OOB -3
 
 #define USB_LINE_BUFFER_SIZE	255			// text buffer size
+#define XIO_FILE_BUFFER_SIZE	512			// size of each of the 2 read-ahead buffers for job files (one sector)
+#define XIO_FILENAME_LEN		12			// 8.3 filename, no path
 
 //*** Device flags ***
 typedef uint16_t devflags_t;				// might need to bump to 32 be 16 or 32
@@ -116,6 +118,7 @@ enum xioDeviceEnum {						// reconfigure this enum as you add more physical devi
 	DEV_NONE=-1,							// no device is bound
 	DEV_USB0=0,								// must be 0
 	DEV_USB1,								// must be 1
+	DEV_FILE0,								// SD card job file (see $run)
 	DEV_SPI0,
 	DEV_MAX
 };
@@ -148,6 +151,10 @@ size_t writeline(uint8_t *buffer, size_t size);
 stat_t read_line (uint8_t *buffer, uint16_t *index, size_t size);
 
 stat_t xio_set_spi(nvObj_t *nv);
+stat_t xio_get_run(nvObj_t *nv);
+stat_t xio_set_run(nvObj_t *nv);
+stat_t xio_get_runb(nvObj_t *nv);
+stat_t xio_get_runl(nvObj_t *nv);
 
 /* Some useful ASCII definitions */
 
@@ -182,10 +189,16 @@ stat_t xio_set_spi(nvObj_t *nv);
 #ifdef __TEXT_MODE
 
 	void xio_print_spi(nvObj_t *nv);
+	void xio_print_run(nvObj_t *nv);
+	void xio_print_runb(nvObj_t *nv);
+	void xio_print_runl(nvObj_t *nv);
 
 #else
 
 	#define xio_print_spi tx_print_stub
+	#define xio_print_run tx_print_stub
+	#define xio_print_runb tx_print_stub
+	#define xio_print_runl tx_print_stub
 
 #endif // __TEXT_MODE
 